@@ -0,0 +1,760 @@
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <cstring>
+#include <cstdio>
+#include <cstdarg>
+#include <errno.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <new>
+#include <stdexcept>
+
+#include "tool_counters.h"
+#include "frame_times.h"
+#include "timer_events.h"
+#include "timer_rendezvous.h"
+#include "amnesia_timer.h"
+
+struct AmnesiaTimer
+{
+    int fd = -1;
+    void* mmapAddress = MAP_FAILED;
+    size_t sharedMemorySize = 0; // the whole shared memory is mapped because the timer event ring is at the end of it
+    bool mlockSucceeded = false;
+    TimerSharedHeader* header = nullptr;
+    uint32_t eventCursor = 0; // the sequence of the last event returned
+    pid_t pid = 0;
+    int pidfd = -1;
+    int notifyFd = -1; // the game's eventfd, copied with pidfd_getfd
+};
+
+static const char* gameNames[4] = {
+    "/Amnesia_NOSTEAM.bin.x86_64",
+    "/Amnesia.bin.x86_64",
+    "/Amnesia_NOSTEAM.bin.x86",
+    "/Amnesia.bin.x86"
+};
+
+static thread_local char lastError[256] = "";
+
+static void setLastError(const char* format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(lastError, sizeof(lastError), format, arguments);
+    va_end(arguments);
+}
+
+// finds up to maxPids games, in /proc order
+static bool findPids(std::vector<pid_t>& pids, const size_t maxPids)
+{
+    size_t howManyGameNames = sizeof(gameNames) / sizeof(char*);
+    char pathBuffer[64]{};
+    char fileTextBuffer[256]{};
+    FILE* f = nullptr;
+
+    struct dirent *directoryEntry;
+    DIR* procDirectory = opendir("/proc"); // make sure this gets closed
+    if (procDirectory == nullptr)
+    {
+        setLastError("error opening proc directory: %d", errno);
+        return false;
+    }
+
+    while ((directoryEntry = readdir(procDirectory)) && pids.size() < maxPids)
+    {
+        size_t truncationCheck = snprintf(pathBuffer, sizeof(pathBuffer), "/proc/%s/cmdline", directoryEntry->d_name);
+        if (truncationCheck >= sizeof(pathBuffer))
+        {
+            continue;
+        }
+
+        f = fopen(pathBuffer, "r"); // make sure this also gets closed
+        if (!f)
+        {
+            errno = 0;
+            continue;
+        }
+
+        size_t bytesRead = fread(fileTextBuffer, sizeof(char), sizeof(fileTextBuffer), f);
+        size_t filenameIndex = 0;
+        size_t lastSlashIndex = 0;
+        for (; fileTextBuffer[filenameIndex] != '\0' && filenameIndex < bytesRead; filenameIndex++)
+        {
+            if (fileTextBuffer[filenameIndex] == '/')
+            {
+                lastSlashIndex = filenameIndex;
+            }
+        }
+        if (filenameIndex != bytesRead && lastSlashIndex != 0)
+        {
+            for (size_t i = 0; i < howManyGameNames; i++)
+            {
+                if (strcmp(gameNames[i], fileTextBuffer + lastSlashIndex) == 0)
+                {
+                    pids.push_back(stol(std::string(directoryEntry->d_name)));
+                    break;
+                }
+            }
+        }
+
+        fclose(f); // file closed here
+    }
+
+    closedir(procDirectory); // directory closed here
+
+    return true;
+}
+
+// sharedMemoryName is read from shared_memory_name.txt if it's nullptr
+static bool getMemfdName(const char* sharedMemoryName, char* memfdName, const size_t memfdNameBufferSize, size_t& linkFirstPartSize)
+{
+    const size_t memfdNameMaxSize = 249; // "The limit is 249 bytes, excluding the terminating null byte."
+    const char fileWithMemfdName[] = "shared_memory_name.txt";
+
+    if (sharedMemoryName != nullptr)
+    {
+        size_t nameSize = strlen(sharedMemoryName);
+        if (nameSize >= memfdNameBufferSize)
+        {
+            setLastError("shared memory name should be shorter than %zu bytes", memfdNameBufferSize);
+            return false;
+        }
+        memcpy(memfdName, sharedMemoryName, nameSize + 1);
+    }
+    else
+    {
+        FILE* f = fopen(fileWithMemfdName, "rb"); // make sure this gets closed
+        if (!f)
+        {
+            setLastError("fopen error when opening %s: %d", fileWithMemfdName, errno);
+            return false;
+        }
+
+        size_t charactersRead = fread(&memfdName[0], 1, memfdNameBufferSize, f);
+        fclose(f); // file closed here
+        f = nullptr;
+        if (charactersRead == memfdNameBufferSize)
+        {
+            setLastError("%s should be shorter than %zu bytes", fileWithMemfdName, memfdNameBufferSize);
+            return false;
+        }
+        memfdName[charactersRead] = '\0';
+    }
+
+    // removing non-alphanumeric characters and characters which aren't dashes or underscores, the same way the tool does
+    size_t write_idx = 0;
+    for (size_t i = 0; memfdName[i] != '\0'; i++)
+    {
+        memfdName[write_idx] = memfdName[i];
+        write_idx += (
+            (memfdName[i] >= '0' && memfdName[i] <= '9')
+            || (memfdName[i] >= 'a' && memfdName[i] <= 'z')
+            || (memfdName[i] >= 'A' && memfdName[i] <= 'Z')
+            || memfdName[i] == '-'
+            || memfdName[i] == '_'
+        );
+    }
+    memfdName[write_idx] = '\0';
+    linkFirstPartSize = write_idx + 7; // + 7 for "/memfd:" start text
+    if (write_idx == 0)
+    {
+        setLastError("empty shared memory name");
+        return false;
+    }
+    else if (write_idx > memfdNameMaxSize)
+    {
+        setLastError("shared memory name needs to be %zu characters or less", memfdNameMaxSize);
+        return false;
+    }
+
+    return true;
+}
+
+// linkFirstPart is "/memfd:" followed by the shared memory name
+static bool findMemFile(std::string& pathString, const char* linkFirstPart, const size_t linkFirstPartSize)
+{
+    char linkSecondPart[] = " (deleted)";
+
+    std::string pathStringCopy = pathString;
+    char symlinkBuffer[7 + 249 + 10 + 1]{}; // "/memfd:" + maximum allowed memfd name size + " (deleted)" + null terminator
+    size_t pathStringOriginalSize = pathString.size();
+
+    struct dirent *directoryEntry;
+    DIR* fhDirectory = opendir(pathString.c_str()); // make sure this gets closed
+    if (fhDirectory == nullptr)
+    {
+        setLastError("error opening proc directory: %d", errno);
+        return false;
+    }
+
+    size_t foundfhCount = 0;
+    while ((directoryEntry = readdir(fhDirectory)))
+    {
+        pathStringCopy += directoryEntry->d_name;
+        ssize_t readlinkBytesRead = readlink(pathStringCopy.c_str(), symlinkBuffer, sizeof(symlinkBuffer));
+        if (readlinkBytesRead == sizeof(symlinkBuffer))
+        {
+            pathStringCopy.resize(pathStringOriginalSize);
+            continue;
+        }
+        else if (readlinkBytesRead == -1)
+        {
+            errno = 0;
+            pathStringCopy.resize(pathStringOriginalSize);
+            continue;
+        }
+        symlinkBuffer[readlinkBytesRead] = '\0';
+
+        if (
+            (strncmp(linkFirstPart, symlinkBuffer, linkFirstPartSize) == 0)
+            && (
+                symlinkBuffer[linkFirstPartSize] == '\0'
+                || strcmp(linkSecondPart, &symlinkBuffer[linkFirstPartSize]) == 0
+            )
+        )
+        {
+            pathString = pathStringCopy;
+            foundfhCount += 1;
+        }
+
+        pathStringCopy.resize(pathStringOriginalSize);
+    }
+
+    closedir(fhDirectory); // directory closed here
+
+    if (foundfhCount == 0)
+    {
+        setLastError("Couldn't find memfd_create file handle");
+        return false;
+    }
+    else if (foundfhCount > 1)
+    {
+        setLastError("memfd_create file name already being used by the process. Choose a different name and retry");
+        return false;
+    }
+
+    return true;
+}
+
+// copies the shared memory's file descriptor from the game with the pid and number the tool saved when the game started,
+// and searches /proc for the game and the file descriptor if that doesn't work.
+// onlyPid is the game to open it from, or 0 for the first game found
+static bool openMemFile(const char* sharedMemoryName, const pid_t onlyPid, int& fd, pid_t& pid)
+{
+    size_t linkFirstPartSize = 0;
+    char linkFirstPart[327] = "/memfd:"; // 320, plus 7 for "/memfd:" start text
+    if (!getMemfdName(sharedMemoryName, &linkFirstPart[7], sizeof(linkFirstPart) - 7, linkFirstPartSize)) // starting at index 7, ahead of "/memfd:" start text
+    {
+        return false;
+    }
+
+    TimerRendezvousRecord record{};
+    if (readTimerRendezvous(&linkFirstPart[7], record) && (onlyPid == 0 || record.pid == onlyPid))
+    {
+        fd = openTimerRendezvousMemfd(record);
+        if (fd != -1)
+        {
+            pid = record.pid;
+            return true;
+        }
+    }
+
+    // the rendezvous file only has the last game which started with this name, so other games are always searched for
+    pid = onlyPid;
+    if (pid == 0)
+    {
+        std::vector<pid_t> pids;
+        if (!findPids(pids, 1))
+        {
+            return false;
+        }
+        if (pids.empty())
+        {
+            setLastError("Couldn't find game PID");
+            return false;
+        }
+        pid = pids[0];
+    }
+
+    std::string pathString = "/proc/";
+    pathString += std::to_string(pid);
+    pathString += "/fd/";
+
+    if (!findMemFile(pathString, linkFirstPart, linkFirstPartSize))
+    {
+        return false;
+    }
+
+    fd = open(pathString.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        setLastError("open failure: %d", errno);
+        return false;
+    }
+
+    return true;
+}
+
+// the eventfd number in the header is copied from the game, and it's checked that the copy really is an eventfd,
+// in case the game closed and the pid was reused before pidfd_open
+static void getNotifyFd(AmnesiaTimer& timer)
+{
+    int eventfdNumber = std::atomic_ref<int32_t>(timer.header->eventfdNumber).load(std::memory_order_relaxed);
+    if (timer.pidfd == -1 || eventfdNumber < 0 || std::atomic_ref<int32_t>(timer.header->toolPid).load(std::memory_order_relaxed) != timer.pid)
+    {
+        return;
+    }
+
+    int fd = syscall(SYS_pidfd_getfd, timer.pidfd, eventfdNumber, 0); // pidfd_getfd sets O_CLOEXEC on the copy
+    if (fd == -1)
+    {
+        return;
+    }
+
+    char procPath[64]{};
+    char linkBuffer[32]{};
+    const char eventfdLink[] = "anon_inode:[eventfd]";
+    snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", fd);
+    ssize_t linkSize = readlink(procPath, linkBuffer, sizeof(linkBuffer) - 1);
+    if (linkSize != sizeof(eventfdLink) - 1 || memcmp(linkBuffer, eventfdLink, linkSize) != 0)
+    {
+        close(fd);
+        return;
+    }
+    timer.notifyFd = fd;
+}
+
+// onlyPid is 0 for the first game found
+static bool getResources(AmnesiaTimer& timer, const char* sharedMemoryName, const pid_t onlyPid)
+{
+    try
+    {
+        if (!openMemFile(sharedMemoryName, onlyPid, timer.fd, timer.pid))
+        {
+            return false;
+        }
+
+        struct stat fileStatus{};
+        if (fstat(timer.fd, &fileStatus) == -1)
+        {
+            setLastError("fstat failure: %d", errno);
+            return false;
+        }
+        if ((size_t)fileStatus.st_size < sizeof(TimerSharedHeader))
+        {
+            setLastError("the shared memory is too small, the game might still be starting");
+            return false;
+        }
+        timer.sharedMemorySize = fileStatus.st_size;
+
+        timer.mmapAddress = mmap(nullptr, timer.sharedMemorySize, PROT_READ, MAP_SHARED, timer.fd, 0);
+        if (timer.mmapAddress == MAP_FAILED)
+        {
+            setLastError("mmap failure: %d", errno);
+            return false;
+        }
+        timer.header = (TimerSharedHeader*)timer.mmapAddress;
+
+        uint32_t ringOffset = timer.header->eventRingOffset;
+        uint32_t ringCapacity = timer.header->eventRingCapacity;
+        if (ringCapacity == 0 || (ringCapacity & (ringCapacity - 1)) != 0 || ringOffset < sizeof(TimerSharedHeader)
+            || ringOffset > timer.sharedMemorySize || (timer.sharedMemorySize - ringOffset) / sizeof(TimerEventRecord) < ringCapacity)
+        {
+            setLastError("the shared memory doesn't have a timer event ring, the tool might be an older version");
+            return false;
+        }
+
+        // so the first event after sleeping doesn't have to wait for a page fault. it still works without this.
+        timer.mlockSucceeded = mlock(timer.mmapAddress, timer.sharedMemorySize) == 0;
+
+        // both of these are only needed for watching several games with epoll, so they're allowed to fail
+        timer.pidfd = syscall(SYS_pidfd_open, timer.pid, 0);
+        getNotifyFd(timer);
+    }
+    catch (const std::exception& e)
+    {
+        setLastError("unexpected error: %s", e.what());
+
+        return false;
+    }
+
+    return true;
+}
+
+static void freeResources(AmnesiaTimer& timer)
+{
+    if (timer.notifyFd != -1)
+    {
+        close(timer.notifyFd);
+        timer.notifyFd = -1;
+    }
+    if (timer.pidfd != -1)
+    {
+        close(timer.pidfd);
+        timer.pidfd = -1;
+    }
+    if (timer.fd != -1)
+    {
+        close(timer.fd);
+        timer.fd = -1;
+    }
+    if (timer.mlockSucceeded)
+    {
+        munlock(timer.mmapAddress, timer.sharedMemorySize);
+        timer.mlockSucceeded = false;
+    }
+    if (timer.mmapAddress != MAP_FAILED)
+    {
+        munmap(timer.mmapAddress, timer.sharedMemorySize);
+        timer.mmapAddress = MAP_FAILED;
+        timer.header = nullptr;
+    }
+}
+
+static uint32_t loadEventSequence(const AmnesiaTimer& timer)
+{
+    return std::atomic_ref<uint32_t>(timer.header->eventSequence).load(std::memory_order_acquire);
+}
+
+static int takeNextEvent(AmnesiaTimer& timer, AmnesiaTimerEvent& event)
+{
+    uint32_t missedEvents = 0;
+    uint32_t eventSequence = loadEventSequence(timer);
+
+    while (timer.eventCursor != eventSequence)
+    {
+        TimerEventRecord record{};
+        TimerEventReadResult result = readTimerEvent(timer.header, timer.eventCursor + 1, record);
+        if (result == TimerEventReadResult::Ready)
+        {
+            timer.eventCursor += 1;
+            event.sequence = record.sequence;
+            event.eventCode = record.eventCode;
+            event.monotonicNanoseconds = record.monotonicNanoseconds;
+            event.missedEvents = missedEvents;
+            return amnesiaTimerGotEvent;
+        }
+        else if (result == TimerEventReadResult::Overwritten)
+        {
+            // the oldest event still in the ring is capacity events before the newest one
+            eventSequence = loadEventSequence(timer);
+            uint32_t oldestEvent = eventSequence - timer.header->eventRingCapacity + 1;
+            if ((int32_t)(oldestEvent - (timer.eventCursor + 1)) > 0)
+            {
+                missedEvents += oldestEvent - (timer.eventCursor + 1);
+                timer.eventCursor = oldestEvent - 1;
+            }
+            else
+            {
+                // the writer is in the middle of reusing the record for the next event, so this one is gone either way.
+                // it's skipped instead of waiting for the writer, which might never finish if the game died while writing it
+                missedEvents += 1;
+                timer.eventCursor += 1;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return std::atomic_ref<unsigned char>(timer.header->timerByte).load() == amnesiaTimerGameClosed ? amnesiaTimerFinished : amnesiaTimerNoEvent;
+}
+
+static AmnesiaTimer* attach(const char* sharedMemoryName, const pid_t onlyPid)
+{
+    AmnesiaTimer* timer = new (std::nothrow) AmnesiaTimer;
+    if (timer == nullptr)
+    {
+        setLastError("out of memory");
+        return nullptr;
+    }
+
+    if (!getResources(*timer, sharedMemoryName, onlyPid)) // remember to release resources from this function
+    {
+        freeResources(*timer);
+        delete timer;
+        return nullptr;
+    }
+    timer->eventCursor = loadEventSequence(*timer); // events from before attaching are skipped
+
+    return timer;
+}
+
+extern "C" AmnesiaTimer* amnesiaTimerAttach(const char* sharedMemoryName)
+{
+    return attach(sharedMemoryName, 0);
+}
+
+extern "C" AmnesiaTimer* amnesiaTimerAttachPid(int pid, const char* sharedMemoryName)
+{
+    if (pid <= 0)
+    {
+        setLastError("invalid pid %d", pid);
+        return nullptr;
+    }
+
+    return attach(sharedMemoryName, pid);
+}
+
+extern "C" int amnesiaTimerFindGames(int* pids, int maxPids)
+{
+    if (pids == nullptr || maxPids <= 0)
+    {
+        return -1;
+    }
+
+    try
+    {
+        std::vector<pid_t> foundPids;
+        if (!findPids(foundPids, maxPids))
+        {
+            return -1;
+        }
+        for (size_t i = 0; i < foundPids.size(); i++)
+        {
+            pids[i] = foundPids[i];
+        }
+
+        return foundPids.size();
+    }
+    catch (const std::exception& e)
+    {
+        setLastError("unexpected error: %s", e.what());
+
+        return -1;
+    }
+}
+
+extern "C" int amnesiaTimerWait(AmnesiaTimer* timer, AmnesiaTimerEvent* event, int64_t timeoutNanoseconds)
+{
+    if (timer == nullptr || event == nullptr)
+    {
+        return amnesiaTimerError;
+    }
+
+    struct timespec deadline{};
+    if (timeoutNanoseconds >= 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        int64_t deadlineNanoseconds = ((int64_t)deadline.tv_sec * 1000000000) + deadline.tv_nsec + timeoutNanoseconds;
+        deadline.tv_sec = deadlineNanoseconds / 1000000000;
+        deadline.tv_nsec = deadlineNanoseconds % 1000000000;
+    }
+
+    while (true)
+    {
+        // the sequence is read before checking for events, so if an event is written after checking, FUTEX_WAIT returns right away instead of sleeping
+        uint32_t eventSequence = loadEventSequence(*timer);
+        int result = takeNextEvent(*timer, *event);
+        if (result != amnesiaTimerNoEvent)
+        {
+            return result;
+        }
+
+        struct timespec timeout{};
+        if (timeoutNanoseconds >= 0)
+        {
+            struct timespec now{};
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            int64_t remainingNanoseconds = ((int64_t)(deadline.tv_sec - now.tv_sec) * 1000000000) + (deadline.tv_nsec - now.tv_nsec);
+            if (remainingNanoseconds <= 0)
+            {
+                return amnesiaTimerTimedOut;
+            }
+            timeout.tv_sec = remainingNanoseconds / 1000000000;
+            timeout.tv_nsec = remainingNanoseconds % 1000000000;
+        }
+
+        // sleeps without using the CPU until the tool writes another event
+        if (syscall(SYS_futex, &timer->header->eventSequence, FUTEX_WAIT, eventSequence, timeoutNanoseconds >= 0 ? &timeout : nullptr, nullptr, 0) == -1
+            && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT)
+        {
+            return amnesiaTimerError;
+        }
+    }
+}
+
+extern "C" int amnesiaTimerPoll(AmnesiaTimer* timer, AmnesiaTimerEvent* event)
+{
+    if (timer == nullptr || event == nullptr)
+    {
+        return amnesiaTimerError;
+    }
+
+    return takeNextEvent(*timer, *event);
+}
+
+extern "C" int amnesiaTimerState(const AmnesiaTimer* timer)
+{
+    if (timer == nullptr)
+    {
+        return amnesiaTimerError;
+    }
+
+    return std::atomic_ref<unsigned char>(timer->header->timerByte).load();
+}
+
+extern "C" int amnesiaTimerTotals(const AmnesiaTimer* timer, AmnesiaTimerTotals* totals)
+{
+    if (timer == nullptr || totals == nullptr)
+    {
+        return amnesiaTimerError;
+    }
+
+    TimerTotals timerTotals{};
+    readTimerTotals(timer->header, timerTotals);
+    totals->elapsedNanoseconds = timerTotals.elapsedNanoseconds;
+    totals->pausedNanoseconds = timerTotals.pausedNanoseconds;
+    totals->loadRemovedNanoseconds = timerTotals.elapsedNanoseconds - timerTotals.pausedNanoseconds;
+    totals->monotonicNanoseconds = timerTotals.readNanoseconds;
+    totals->paused = timerTotals.paused;
+
+    return 0;
+}
+
+extern "C" int amnesiaTimerCounters(const AmnesiaTimer* timer, AmnesiaTimerCounters* counters)
+{
+    if (timer == nullptr || counters == nullptr)
+    {
+        return amnesiaTimerError;
+    }
+
+    uint32_t countersOffset = timer->header->countersOffset;
+    if (countersOffset < sizeof(TimerSharedHeader) || countersOffset > timer->sharedMemorySize
+        || timer->sharedMemorySize - countersOffset < sizeof(ToolCounters))
+    {
+        return amnesiaTimerError;
+    }
+
+    const ToolCounters& toolCounters = *(const ToolCounters*)((const unsigned char*)timer->mmapAddress + countersOffset);
+    counters->fopenCalls = readCounter(toolCounters.fopenCalls);
+    counters->freopenCalls = readCounter(toolCounters.freopenCalls);
+    counters->fopen64Calls = readCounter(toolCounters.fopen64Calls);
+    counters->freopen64Calls = readCounter(toolCounters.freopen64Calls);
+    counters->delayedFiles = readCounter(toolCounters.delayedFiles);
+    counters->delayNanoseconds = (int64_t)readCounter(toolCounters.delayNanoseconds);
+    counters->longestDelayNanoseconds = (int64_t)readCounter(toolCounters.longestDelayNanoseconds);
+    counters->flashbackSkips = readCounter(toolCounters.flashbackSkips);
+    counters->flashbackWaits = readCounter(toolCounters.flashbackWaits);
+    for (size_t i = 0; i < 4; i++)
+    {
+        counters->eventCounts[i] = readCounter(toolCounters.eventCounts[i]);
+    }
+
+    return 0;
+}
+
+static const FrameTimes* getFrameTimes(const AmnesiaTimer* timer)
+{
+    uint32_t countersOffset = timer->header->countersOffset;
+    if (countersOffset < sizeof(TimerSharedHeader) || countersOffset > timer->sharedMemorySize
+        || timer->sharedMemorySize - countersOffset < sizeof(ToolCounters))
+    {
+        return nullptr;
+    }
+    const ToolCounters& toolCounters = *(const ToolCounters*)((const unsigned char*)timer->mmapAddress + countersOffset);
+    uint32_t frameTimesOffset = toolCounters.frameTimesOffset;
+    if (frameTimesOffset < sizeof(TimerSharedHeader) || frameTimesOffset > timer->sharedMemorySize
+        || timer->sharedMemorySize - frameTimesOffset < sizeof(FrameTimes))
+    {
+        return nullptr;
+    }
+    return (const FrameTimes*)((const unsigned char*)timer->mmapAddress + frameTimesOffset);
+}
+
+extern "C" int amnesiaTimerFrameTimes(const AmnesiaTimer* timer, int frameState, AmnesiaTimerFrameTimes* frameTimes)
+{
+    if (timer == nullptr || frameTimes == nullptr || frameState < 0 || frameState >= (int)frameLoadStateCount)
+    {
+        return amnesiaTimerError;
+    }
+    const FrameTimes* times = getFrameTimes(timer);
+    if (times == nullptr)
+    {
+        return amnesiaTimerError;
+    }
+
+    const FrameTimeHistogram& histogram = times->histograms[frameState];
+    frameTimes->frames = readCounter(histogram.frames);
+    frameTimes->totalNanoseconds = (int64_t)readCounter(histogram.totalNanoseconds);
+    frameTimes->longestNanoseconds = (int64_t)readCounter(histogram.longestNanoseconds);
+    frameTimes->p50Nanoseconds = frameTimePercentile(histogram, 0.5);
+    frameTimes->p99Nanoseconds = frameTimePercentile(histogram, 0.99);
+    frameTimes->hookedOpens = readCounter(histogram.hookedOpens);
+    frameTimes->delayNanoseconds = (int64_t)readCounter(histogram.delayNanoseconds);
+
+    return 0;
+}
+
+extern "C" int amnesiaTimerRecentFrames(const AmnesiaTimer* timer, AmnesiaTimerRenderedFrame* frames, int maxFrames)
+{
+    if (timer == nullptr || frames == nullptr || maxFrames < 0)
+    {
+        return amnesiaTimerError;
+    }
+    const FrameTimes* times = getFrameTimes(timer);
+    if (times == nullptr)
+    {
+        return amnesiaTimerError;
+    }
+
+    uint32_t lastSequence = std::atomic_ref<uint32_t>(const_cast<uint32_t&>(times->frameSequence)).load(std::memory_order_acquire);
+    uint32_t count = lastSequence < (uint32_t)maxFrames ? lastSequence : (uint32_t)maxFrames;
+    count = count < frameTimeRingCapacity ? count : frameTimeRingCapacity;
+    int written = 0;
+    for (uint32_t sequence = lastSequence - count + 1; sequence <= lastSequence; sequence++)
+    {
+        FrameTimeRecord record{};
+        if (!readFrameTime(times, sequence, record)) // overwritten by a newer frame while these were being read
+        {
+            continue;
+        }
+        AmnesiaTimerRenderedFrame& frame = frames[written++];
+        frame.sequence = record.sequence;
+        frame.frameState = record.loadState;
+        frame.swapNanoseconds = record.swapNanoseconds;
+        frame.frameNanoseconds = record.frameNanoseconds;
+        frame.delayNanoseconds = record.delayNanoseconds;
+        frame.hookedOpens = record.hookedOpens;
+    }
+
+    return written;
+}
+
+extern "C" int amnesiaTimerPid(const AmnesiaTimer* timer)
+{
+    return timer == nullptr ? -1 : timer->pid;
+}
+
+extern "C" int amnesiaTimerExitFd(const AmnesiaTimer* timer)
+{
+    return timer == nullptr ? -1 : timer->pidfd;
+}
+
+extern "C" int amnesiaTimerNotifyFd(const AmnesiaTimer* timer)
+{
+    return timer == nullptr ? -1 : timer->notifyFd;
+}
+
+extern "C" void amnesiaTimerDetach(AmnesiaTimer* timer)
+{
+    if (timer == nullptr)
+    {
+        return;
+    }
+
+    freeResources(*timer); // resources from getResources released here
+    delete timer;
+}
+
+extern "C" const char* amnesiaTimerLastError(void)
+{
+    return lastError;
+}
@@ -0,0 +1,193 @@
+
+#ifndef AMNESIA_TIMER_H
+#define AMNESIA_TIMER_H
+
+// C API for programs which watch the tool's load detection, like autosplitters and overlays.
+// Build it as a shared or static library from amnesia_timer.cpp (the commands are in readme.md).
+//
+// Events can be waited for, which sleeps in the kernel until the tool writes one, or polled for, which never blocks.
+// Every event the tool writes is returned once and in order, unless the program falls more than a whole ring of events behind,
+// in which case missedEvents says how many were skipped.
+// An AmnesiaTimer can only be used by one thread at a time.
+//
+// To watch several games from one thread, attach to each pid from amnesiaTimerFindGames and add their exit and notify file descriptors
+// to one epoll, then poll a game's events when its notify file descriptor is ready. Games without a notify file descriptor have to be
+// polled with a timeout instead.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct AmnesiaTimer AmnesiaTimer;
+
+// the same values as the timer byte
+enum AmnesiaTimerEventCode
+{
+    amnesiaTimerResume = 0,
+    amnesiaTimerPause = 1,
+    amnesiaTimerPauseAndSplit = 2,
+    amnesiaTimerGameClosed = 255
+};
+
+enum AmnesiaTimerResult
+{
+    amnesiaTimerError = -1,
+    amnesiaTimerGotEvent = 0,
+    amnesiaTimerNoEvent = 1, // amnesiaTimerPoll only
+    amnesiaTimerTimedOut = 2, // amnesiaTimerWait only
+    amnesiaTimerFinished = 3 // the game closed and every event before that was already returned
+};
+
+typedef struct AmnesiaTimerEvent
+{
+    uint32_t sequence; // 1 for the first event after the game started
+    uint32_t eventCode; // an AmnesiaTimerEventCode
+    int64_t monotonicNanoseconds; // CLOCK_MONOTONIC, when the timer byte changed
+    uint32_t missedEvents; // how many events before this one were overwritten before they could be returned
+} AmnesiaTimerEvent;
+
+// counted by the tool since the game started, so they're exact even if the program attached late or checked rarely
+typedef struct AmnesiaTimerTotals
+{
+    int64_t elapsedNanoseconds; // real time
+    int64_t pausedNanoseconds; // time spent loading
+    int64_t loadRemovedNanoseconds; // elapsed minus paused
+    int64_t monotonicNanoseconds; // CLOCK_MONOTONIC, when these were read
+    int32_t paused; // 1 if the timer is paused right now
+} AmnesiaTimerTotals;
+
+// what the tool has done since the game started, counted by the tool itself
+typedef struct AmnesiaTimerCounters
+{
+    uint64_t fopenCalls; // every call to the tool's stdio hooks, whether or not any file settings are on
+    uint64_t freopenCalls;
+    uint64_t fopen64Calls;
+    uint64_t freopen64Calls;
+    uint64_t delayedFiles; // opens of files in files_and_delays.txt, including ones with a 0 ms delay
+    int64_t delayNanoseconds; // how long the tool slept for file delays altogether
+    int64_t longestDelayNanoseconds;
+    uint64_t flashbackSkips; // how many times the flashback lines were stopped before a map changed
+    uint64_t flashbackWaits; // how many 1 ms waits there were for flashback lines to finish
+    uint64_t eventCounts[4]; // how many resume, pause, pause and split, and game closed events there were
+} AmnesiaTimerCounters;
+
+// the tool measures the game's frames from its buffer swaps, and counts each one in the state the game was in when the frame ended.
+// these are rendered frames, not AmnesiaTimerFrames
+enum AmnesiaTimerFrameState
+{
+    amnesiaTimerFramePlaying = 0,
+    amnesiaTimerFrameLoading = 1, // the timer was paused
+    amnesiaTimerFrameAfterLoad = 2 // less than 2 seconds after the timer resumed, when the game is often still catching up
+};
+
+// every frame since the game started in one AmnesiaTimerFrameState. the percentiles are rounded up to the next 0.25 ms,
+// and frames of 64 ms or longer are all counted as 64 ms in them
+typedef struct AmnesiaTimerFrameTimes
+{
+    uint64_t frames;
+    int64_t totalNanoseconds;
+    int64_t longestNanoseconds;
+    int64_t p50Nanoseconds;
+    int64_t p99Nanoseconds;
+    uint64_t hookedOpens; // files the game opened through the tool's stdio hooks during these frames
+    int64_t delayNanoseconds; // how long the tool slept for file delays during these frames
+} AmnesiaTimerFrameTimes;
+
+// one of the game's last frames
+typedef struct AmnesiaTimerRenderedFrame
+{
+    uint32_t sequence; // 1 for the first frame after the game started
+    uint32_t frameState; // an AmnesiaTimerFrameState
+    int64_t swapNanoseconds; // CLOCK_MONOTONIC, when the swap that ended the frame returned
+    int64_t frameNanoseconds; // since the swap before it
+    int64_t delayNanoseconds;
+    uint32_t hookedOpens; // up to 65535
+} AmnesiaTimerRenderedFrame;
+
+// timer_byte_test --serve pushes every game's events to programs connected to these abstract unix sockets,
+// so they don't need to attach to the games themselves. Nothing is sent to the server.
+// The binary socket sends one AmnesiaTimerFrame per update, in native byte order.
+// The text socket sends one line per update: type pid sequence eventCode monotonicNanoseconds elapsedNanoseconds loadRemovedNanoseconds missedEvents
+// where type is attached, event or closed, and eventCode is resume, pause, split or finished.
+#define AMNESIA_TIMER_SOCKET_NAME "amnesia_timer_events"
+#define AMNESIA_TIMER_TEXT_SOCKET_NAME "amnesia_timer_events_text"
+
+enum AmnesiaTimerFrameType
+{
+    amnesiaTimerFrameAttached = 0, // sent for every game already being watched when a program connects, and when a new game is found
+    amnesiaTimerFrameEvent = 1,
+    amnesiaTimerFrameClosed = 2 // the game closed or exited and isn't being watched anymore
+};
+
+typedef struct AmnesiaTimerFrame
+{
+    uint16_t frameSize; // sizeof(AmnesiaTimerFrame), so fields can be added to the end
+    uint8_t version; // 1
+    uint8_t frameType; // an AmnesiaTimerFrameType
+    int32_t pid;
+    uint32_t sequence; // 0 unless it's an event
+    uint32_t eventCode; // the event, or the timer byte when the frame was sent
+    uint32_t missedEvents;
+    uint32_t padding;
+    int64_t monotonicNanoseconds; // when the event happened, or when the frame was sent
+    int64_t elapsedNanoseconds; // the game's totals when the frame was sent
+    int64_t loadRemovedNanoseconds;
+} AmnesiaTimerFrame;
+
+// sharedMemoryName is the name in shared_memory_name.txt. if it's NULL, shared_memory_name.txt is read from the current directory.
+// the first event returned is the first one after attaching. returns NULL on failure, and amnesiaTimerLastError says why.
+AmnesiaTimer* amnesiaTimerAttach(const char* sharedMemoryName);
+
+// like amnesiaTimerAttach, but for the game with this pid instead of the first one found
+AmnesiaTimer* amnesiaTimerAttachPid(int pid, const char* sharedMemoryName);
+
+// writes the pids of up to maxPids running games. returns how many were written, or -1 on failure.
+// the tool might not be ready in a game yet, so attaching can still fail.
+int amnesiaTimerFindGames(int* pids, int maxPids);
+
+// waits until there's an event or timeoutNanoseconds passes. a negative timeout waits until there's an event.
+int amnesiaTimerWait(AmnesiaTimer* timer, AmnesiaTimerEvent* event, int64_t timeoutNanoseconds);
+
+// returns the next event if there is one, without waiting
+int amnesiaTimerPoll(AmnesiaTimer* timer, AmnesiaTimerEvent* event);
+
+// the timer byte right now, an AmnesiaTimerEventCode
+int amnesiaTimerState(const AmnesiaTimer* timer);
+
+// the real, paused, and load removed time right now. after the game closes the load removed time stops increasing.
+// returns 0, or amnesiaTimerError if an argument is NULL
+int amnesiaTimerTotals(const AmnesiaTimer* timer, AmnesiaTimerTotals* totals);
+
+// returns 0, or amnesiaTimerError if an argument is NULL or the tool is too old to have counters.
+// each counter is read on its own, so they can be from slightly different times
+int amnesiaTimerCounters(const AmnesiaTimer* timer, AmnesiaTimerCounters* counters);
+
+// returns 0, or amnesiaTimerError if an argument is NULL, frameState isn't an AmnesiaTimerFrameState or the tool is too old to measure frames
+int amnesiaTimerFrameTimes(const AmnesiaTimer* timer, int frameState, AmnesiaTimerFrameTimes* frameTimes);
+
+// writes up to maxFrames of the game's last frames, oldest first, and returns how many were written, or amnesiaTimerError.
+// only the last 4096 frames are kept
+int amnesiaTimerRecentFrames(const AmnesiaTimer* timer, AmnesiaTimerRenderedFrame* frames, int maxFrames);
+
+int amnesiaTimerPid(const AmnesiaTimer* timer);
+
+// a pidfd which is readable (EPOLLIN) after the game exits, or -1 if pidfd_open isn't supported. closed by amnesiaTimerDetach
+int amnesiaTimerExitFd(const AmnesiaTimer* timer);
+
+// becomes readable after the tool writes an event, or -1 if it couldn't be copied from the game (pidfd_getfd needs the same permission as ptrace).
+// it's shared with every other program watching the game, so add it with EPOLLIN | EPOLLET and never read from it.
+// closed by amnesiaTimerDetach
+int amnesiaTimerNotifyFd(const AmnesiaTimer* timer);
+
+void amnesiaTimerDetach(AmnesiaTimer* timer);
+
+// what the last amnesiaTimerAttach failure on this thread was
+const char* amnesiaTimerLastError(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
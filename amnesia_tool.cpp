@@ -7,25 +7,45 @@
 #include <atomic> // atomic_ref is used in the __attribute__((destructor)) function. It makes the compiler use an xchg instruction.
 
 #include "non_std_functions.h"
+#include "fnv1a_hash.h"
+#include "config_cache.h"
+#include "tool_counters.h"
+#include "frame_times.h"
+#include "timer_events.h"
+#include "timer_rendezvous.h"
+#include "startup_profiler.h"
+#include "map_prefetcher.h"
+#include "page_cache_warmer.h"
+#include "mmap_file_streams.h"
+#include "load_history.h"
+#include "file_open_trace.h"
+#include "function_probes.h"
+#include "load_sampler.h"
 #include "load_extender.h"
+#include "swap_hooks.h"
 
 #if __x86_64__ || __ppc64__
 using uint_t = uint64_t;
 static const uint_t UINTT_MAX = UINT64_MAX;
-static const uint_t loadDetectionInstructionsSize = 128;
-static const uint_t flashbackSkipInstructionsSize = 128;
-static const uint_t flashbackWaitInstructionsSize = 192;
+static const uint_t loadDetectionInstructionsSize = 320;
+static const uint_t flashbackSkipInstructionsSize = 192;
+static const uint_t flashbackWaitInstructionsSize = 256;
 #else
 using uint_t = uint32_t;
 static const uint_t UINTT_MAX = UINT32_MAX;
-static const uint_t loadDetectionInstructionsSize = 64;
-static const uint_t flashbackSkipInstructionsSize = 64;
+static const uint_t loadDetectionInstructionsSize = 192;
+static const uint_t flashbackSkipInstructionsSize = 128;
 static const uint_t flashbackWaitInstructionsSize = 128;
 #endif
 
+static const size_t flashbackNamesInitialSpace = 4096;
+
 static int memfd = -1;
 static void* mmapAddress = MAP_FAILED;
 static size_t extraMemorySize = 0;
+static uint_t timerEventRingOffset = 0;
+static uint_t toolCountersOffset = 0;
+static uint_t frameTimesOffset = 0;
 
 #if __x86_64__ || __ppc64__
 struct SavedInstructions
@@ -68,6 +88,14 @@ struct SavedInstructions
 };
 #endif
 
+// where setupMemory put the flashback line names, so they can be copied into the config cache
+struct FlashbackNameArea
+{
+    uint_t howManyNames = 0;
+    uint_t spacePerName = 0;
+    uint_t nameAreaOffset = 0;
+};
+
 // copy line if it might say the location of the game's memory or the mmap memory
 static bool getPotentialLine(FileHelper& fh, char* mapLine, const size_t maxLineSize, size_t& filenameStart)
 {
@@ -271,44 +299,7 @@ static bool findExecutableMemory(uint_t& gameStartAddress, uint_t& gameEndAddres
     return false;
 }
 
-// this needs to be done to find how much memory to allocate for the virtual pages
-static void preprocessFlashbackNames(FileHelper& fh, uint_t& howManyNames, uint_t& longestName)
-{
-    char ch = '\0';
-
-    uint_t currentNameLength = 0;
-
-    while (fh.getCharacter(ch))
-    {
-        if (ch == '\r') // windows puts this at the end of lines
-        {
-            continue;
-        }
-        else if (ch == '\n')
-        {
-            if (currentNameLength > longestName)
-            {
-                longestName = currentNameLength;
-            }
-            howManyNames += currentNameLength > 0;
-            currentNameLength = 0;
-        }
-        else
-        {
-            currentNameLength++;
-        }
-    }
-
-    if (currentNameLength > longestName) // last line
-    {
-        longestName = currentNameLength;
-    }
-    howManyNames += currentNameLength > 0;
-
-    fh.resetFile();
-}
-
-static bool setupMemfdPages(const char* memfdName, const size_t extraMemorySize)
+static bool createMemfdPages(const char* memfdName, const size_t size)
 {
     memfd = memfd_create(memfdName, MFD_ALLOW_SEALING);
     if (memfd == -1)
@@ -318,20 +309,56 @@ static bool setupMemfdPages(const char* memfdName, const size_t extraMemorySize)
         return false;
     }
     
-    if (ftruncate(memfd, extraMemorySize) == -1)
+    if (ftruncate(memfd, size) == -1)
     {
         printCstr("ftruncate error: "); printInt(errno); printCstr("\n");
         // printf("ftruncate error: %d\n", errno);
         return false;
     }
     
-    mmapAddress = mmap(nullptr, extraMemorySize, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_SHARED, memfd, 0);
+    mmapAddress = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_SHARED, memfd, 0);
     if (mmapAddress == MAP_FAILED)
     {
         printCstr("mmap error: "); printInt(errno); printCstr("\n");
         // printf("mmap error: %d\n", errno);
         return false;
     }
+    extraMemorySize = size;
+    
+    return true;
+}
+
+// this can only be used before sealMemfdPages, and mmapAddress can change
+static bool resizeMemfdPages(const size_t newSize)
+{
+    if (ftruncate(memfd, newSize) == -1)
+    {
+        printCstr("ftruncate error when resizing: "); printInt(errno); printCstr("\n");
+        return false;
+    }
+    
+    void* newAddress = mremap(mmapAddress, extraMemorySize, newSize, MREMAP_MAYMOVE);
+    if (newAddress == MAP_FAILED)
+    {
+        printCstr("mremap error: "); printInt(errno); printCstr("\n");
+        return false;
+    }
+    mmapAddress = newAddress;
+    extraMemorySize = newSize;
+    
+    return true;
+}
+
+static bool sealMemfdPages()
+{
+    // the timer event ring, the counters and the frame times go after everything else, so adding them doesn't move anything the instructions point to
+    timerEventRingOffset = (extraMemorySize + 63) & ~(uint_t)63;
+    toolCountersOffset = timerEventRingOffset + timerEventRingSize;
+    frameTimesOffset = toolCountersOffset + sizeof(ToolCounters);
+    if (!resizeMemfdPages(frameTimesOffset + sizeof(FrameTimes)))
+    {
+        return false;
+    }
     
     if (fcntl(memfd, F_ADD_SEALS, F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE) == -1)
     {
@@ -343,52 +370,138 @@ static bool setupMemfdPages(const char* memfdName, const size_t extraMemorySize)
     return true;
 }
 
-static bool setFlashbackNames(unsigned char* extraMemory, FileHelper& fh, const uint_t startOffset, const uint_t spacePerName, const uint_t extraMemorySize)
+static bool setupMemfdPages(const char* memfdName, const size_t size)
+{
+    return createMemfdPages(memfdName, size) && sealMemfdPages();
+}
+
+// + 1 for null terminator, names are stored as string objects
+static uint_t getSpacePerName(const uint_t longestName)
+{
+    const uint_t stringDataSize = sizeof(uint_t) * 3;
+    return (((longestName + stringDataSize + 1) / 64) + (((longestName + stringDataSize + 1) % 64) != 0)) * 64;
+}
+
+// name can be inside extraMemory at or before slotOffset
+static void writeFlashbackNameSlot(unsigned char* extraMemory, const uint_t slotOffset, const unsigned char* name, const uint_t nameSize, const uint_t spacePerName)
 {
     const uint_t stringDataSize = sizeof(uint_t) * 3;
     const uint_t stringCapacity = spacePerName - stringDataSize - 1; // - 1 for null terminator
-    char ch = '\0';
-    uint_t writeOffset = startOffset;
-    uint_t nameSize = 0;
+    const uint_t stringReferenceCount = 0;
+    
+    memmove(&extraMemory[slotOffset + stringDataSize], name, nameSize);
+    memset(&extraMemory[slotOffset + stringDataSize + nameSize], 0, spacePerName - stringDataSize - nameSize);
+    memcpy(&extraMemory[slotOffset], &nameSize, sizeof(nameSize));
+    memcpy(&extraMemory[slotOffset + sizeof(nameSize)], &stringCapacity, sizeof(stringCapacity));
+    memcpy(&extraMemory[slotOffset + (sizeof(nameSize) * 2)], &stringReferenceCount, sizeof(stringReferenceCount));
+}
 
-    while (fh.getCharacter(ch))
+// The names are read in one pass. Each one is appended to the memfd pages as it's read, followed by its length, and the pages are grown when they're full.
+// The injected instructions step through the names with a constant stride, so once the longest name is known,
+// the names are moved into spacePerName sized string objects, starting from the last one so none are overwritten before they're moved.
+// Returns false if the memfd pages couldn't be resized. howManyNames is 0 if there weren't any names.
+static bool loadFlashbackNames(MappedFileLines& lines, const uint_t nameAreaOffset, uint_t& howManyNames, uint_t& spacePerName)
+{
+    const char* line = nullptr;
+    size_t lineSize = 0;
+    uint_t writeOffset = nameAreaOffset;
+    uint_t longestName = 0;
+
+    while (lines.nextLine(line, lineSize))
     {
-        if (ch == '\n')
+        if (lineSize > 0 && line[lineSize - 1] == '\r') // windows puts this at the end of lines
         {
-            if (nameSize > 0)
-            {
-                memcpy(&extraMemory[writeOffset], &nameSize, sizeof(nameSize));
-                memcpy(&extraMemory[writeOffset + sizeof(nameSize)], &stringCapacity, sizeof(stringCapacity));
-                writeOffset += spacePerName;
-                nameSize = 0;
-            }
+            lineSize--;
         }
-        else
+        
+        if (lineSize == 0)
         {
-            if (nameSize == spacePerName - stringDataSize - 1) // this shouldn't ever happen, flashback line names shouldn't need to be long enough to cause this
-            {
-                printCstr("ERROR: a flashback line name was longer than expected, possibly because of integer overflow\n");
-                return false;
-            }
-            else if (writeOffset + stringDataSize + nameSize >= extraMemorySize) // this also shouldn't ever happen, there shouldn't need to be enough to cause this
+            continue;
+        }
+        
+        uint_t nameSize = (uint_t)lineSize;
+        if (lineSize > UINTT_MAX - sizeof(nameSize) - writeOffset) // this shouldn't ever happen, flashback line names shouldn't need to be long enough to cause this
+        {
+            printCstr("ERROR: flashback line names were longer than expected, possibly because of integer overflow\n");
+            howManyNames = 0;
+            return true;
+        }
+        
+        if (writeOffset + nameSize + sizeof(nameSize) > extraMemorySize)
+        {
+            size_t newSize = extraMemorySize * 2 > writeOffset + nameSize + sizeof(nameSize) ? extraMemorySize * 2 : writeOffset + nameSize + sizeof(nameSize);
+            if (!resizeMemfdPages(newSize))
             {
-                printCstr("ERROR: there were more flashback line names than expected, possibly because of integer overflow\n");
                 return false;
             }
-
-            extraMemory[writeOffset + stringDataSize + nameSize] = (unsigned char)ch;
-            nameSize += 1;
         }
+        
+        unsigned char* extraMemory = (unsigned char*)mmapAddress;
+        memcpy(&extraMemory[writeOffset], line, nameSize);
+        memcpy(&extraMemory[writeOffset + nameSize], &nameSize, sizeof(nameSize));
+        writeOffset += nameSize + sizeof(nameSize);
+        
+        if (nameSize > longestName)
+        {
+            longestName = nameSize;
+        }
+        howManyNames += 1;
     }
-    if (nameSize > 0) // last name
+    
+    if (howManyNames == 0)
     {
-        memcpy(&extraMemory[writeOffset], &nameSize, sizeof(nameSize));
-        memcpy(&extraMemory[writeOffset + sizeof(nameSize)], &stringCapacity, sizeof(stringCapacity));
+        return resizeMemfdPages(nameAreaOffset);
+    }
+    
+    spacePerName = getSpacePerName(longestName);
+    if (!resizeMemfdPages(nameAreaOffset + (spacePerName * howManyNames)))
+    {
+        return false;
+    }
+    
+    // every name's slot starts at or after where the name was appended, because a slot is bigger than a name plus its length
+    unsigned char* extraMemory = (unsigned char*)mmapAddress;
+    for (uint_t nameIdx = howManyNames; nameIdx > 0; nameIdx--)
+    {
+        uint_t nameSize = 0;
+        writeOffset -= sizeof(nameSize);
+        memcpy(&nameSize, &extraMemory[writeOffset], sizeof(nameSize));
+        writeOffset -= nameSize;
+        
+        writeFlashbackNameSlot(extraMemory, nameAreaOffset + ((nameIdx - 1) * spacePerName), &extraMemory[writeOffset], nameSize, spacePerName);
     }
 
     return true;
 }
 
+// copies the names from the config cache's name table into the string objects, the memfd pages are made with the exact size they need
+static bool loadCachedFlashbackNames(const unsigned char* nameTable, const char* memfdName, const uint_t nameAreaOffset, uint_t& howManyNames, uint_t& spacePerName)
+{
+    FlatNameTableHeader nameTableHeader{};
+    memcpy(&nameTableHeader, nameTable, sizeof(nameTableHeader));
+    howManyNames = nameTableHeader.nameCount;
+    spacePerName = getSpacePerName(nameTableHeader.longestName);
+    
+    if (!createMemfdPages(memfdName, nameAreaOffset + (spacePerName * howManyNames)))
+    {
+        return false;
+    }
+    
+    unsigned char* extraMemory = (unsigned char*)mmapAddress;
+    size_t readOffset = sizeof(nameTableHeader);
+    for (uint_t nameIdx = 0; nameIdx < howManyNames; nameIdx++)
+    {
+        uint32_t nameSize = 0;
+        memcpy(&nameSize, &nameTable[readOffset], sizeof(nameSize));
+        readOffset += sizeof(nameSize);
+        
+        writeFlashbackNameSlot(extraMemory, nameAreaOffset + (nameIdx * spacePerName), &nameTable[readOffset], nameSize, spacePerName);
+        readOffset += ((nameSize + 3) / 4) * 4;
+    }
+    
+    return true;
+}
+
 static void copyGameBytesAndLocation(unsigned char*& gamePtr, const size_t moveForwardBy, unsigned char* copyTo, const size_t copySize, uint_t& copyAddressTo)
 {
     gamePtr += moveForwardBy;
@@ -505,47 +618,101 @@ static void injectLoadDetectionInstructions(SavedInstructions& si, unsigned char
     unsigned char loadDetectionInstructions[loadDetectionInstructionsSize] = {
         // start of mmap memory
         0x00,                                                           // 0000 // pause/split timer byte
+        0x00, 0x00, 0x00,                                               // 0001 // padding
+        0x00, 0x00, 0x00, 0x00,                                         // 0004 // event sequence // futex word
+        0x00, 0x00, 0x00, 0x00,                                         // 0008 // event ring offset // written by initTimerEvents
+        0x00, 0x00, 0x00, 0x00,                                         // 0012 // event ring capacity // written by initTimerEvents
+        0x00, 0x00, 0x00, 0x00,                                         // 0016 // tool pid // written by initTimerEvents
+        0x00, 0x00, 0x00, 0x00,                                         // 0020 // memfd number // written by initTimerEvents
+        0x00, 0x00, 0x00, 0x00,                                         // 0024 // eventfd number // written by initTimerEvents
+        0x00, 0x00, 0x00, 0x00,                                         // 0028 // time totals sequence // seqlock
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,                 // 0032 // elapsed nanoseconds until the last event
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,                 // 0040 // paused nanoseconds until the last event
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,                 // 0048 // last event time // written by initTimerEvents
+        0x00, 0x00, 0x00, 0x00,                                         // 0056 // paused after the last event // written by initTimerEvents
+        0x00, 0x00, 0x00, 0x00,                                         // 0060 // counters offset // written by initTimerEvents
         
         // start of load finished instructions:
         // byte update instructions (plus dummy push)
-        0x51,                                                           // 0001 // push rcx // dummy push so stack is aligned by 16 for function call
-        0xb1, 0x00,                                                     // 0002 // mov cl, 0x00
-        0x86, 0x0d, 0xf6, 0xff, 0xff, 0xff,                             // 0004 // xchg byte ptr [rip - 10], cl
+        0x51,                                                           // 0064 // push rcx // dummy push so stack is aligned by 16 for function call
+        0xb1, 0x00,                                                     // 0065 // mov cl, 0x00
+        0x86, 0x0d, 0xb7, 0xff, 0xff, 0xff,                             // 0067 // xchg byte ptr [rip - 73], cl
+        0xe8, 0x82, 0x00, 0x00, 0x00,                                   // 0073 // call +130 // timer event instructions
         // original instructions
-        0x48, 0x8b, 0xbb, 0xd8, 0x00, 0x00, 0x00,                       // 0010 // mov rdi, qword ptr [rbx + 0xd8] // COPY THIS
-        0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0017 // mov rcx, isQuitMessagePosted address
-        0xff, 0xd1,                                                     // 0027 // call rcx
-        0x84, 0xc0,                                                     // 0029 // test al, al // COPY THIS
+        0x48, 0x8b, 0xbb, 0xd8, 0x00, 0x00, 0x00,                       // 0078 // mov rdi, qword ptr [rbx + 0xd8] // COPY THIS
+        0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0085 // mov rcx, isQuitMessagePosted address
+        0xff, 0xd1,                                                     // 0095 // call rcx
+        0x84, 0xc0,                                                     // 0097 // test al, al // COPY THIS
         // jump back instructions (plus pop to undo dummy push)
-        0x59,                                                           // 0031 // pop rcx // undoing dummy push
-        0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0032 // mov rcx, address of pop rcx instruction
-        0xff, 0xe1,                                                     // 0042 // jmp rcx
-        0x90, 0x90, 0x90, 0x90,                                         // 0044 // nops so menu load instructions start on byte 48
+        0x59,                                                           // 0099 // pop rcx // undoing dummy push
+        0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0100 // mov rcx, address of pop rcx instruction
+        0xff, 0xe1,                                                     // 0110 // jmp rcx
         
         // start of menu load instructions:
         // byte update instructions
-        0xb1, 0x01,                                                     // 0048 // mov cl, 0x01
-        0x86, 0x0d, 0xc8, 0xff, 0xff, 0xff,                             // 0050 // xchg byte ptr [rip - 56], cl
+        0xb1, 0x01,                                                     // 0112 // mov cl, 0x01
+        0x86, 0x0d, 0x88, 0xff, 0xff, 0xff,                             // 0114 // xchg byte ptr [rip - 120], cl
+        0xe8, 0x53, 0x00, 0x00, 0x00,                                   // 0120 // call +83 // timer event instructions
         // original instructions with corrected rsp offsets
-        0x48, 0x8d, 0xac, 0x24, 0xb8, 0x00, 0x00, 0x00,                 // 0056 // lea rbp, [rsp + 0xb8] // COPY THIS after correcting the rsp offset
-        0x48, 0x8d, 0x94, 0x24, 0xf5, 0x00, 0x00, 0x00,                 // 0064 // lea rdx, [rsp + 0xf5] // COPY THIS after correcting the rsp offset
+        0x48, 0x8d, 0xac, 0x24, 0xb8, 0x00, 0x00, 0x00,                 // 0125 // lea rbp, [rsp + 0xb8] // COPY THIS after correcting the rsp offset
+        0x48, 0x8d, 0x94, 0x24, 0xf5, 0x00, 0x00, 0x00,                 // 0133 // lea rdx, [rsp + 0xf5] // COPY THIS after correcting the rsp offset
         // jump back instructions
-        0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0072 // mov rcx, address of pop rcx instruction
-        0xff, 0xe1,                                                     // 0082 // jmp rcx
-        0x90,                                                           // 0084 // nop
+        0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0141 // mov rcx, address of pop rcx instruction
+        0xff, 0xe1,                                                     // 0151 // jmp rcx
+        0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,                       // 0153 // nops so map load instructions start on byte 160
         
         // start of map load instructions:
         // byte update instructions
-        0xb1, 0x02,                                                     // 0085 // mov cl, 0x02
-        0x86, 0x0d, 0xa3, 0xff, 0xff, 0xff,                             // 0087 // xchg byte ptr [rip - 93], cl
+        0xb1, 0x02,                                                     // 0160 // mov cl, 0x02
+        0x86, 0x0d, 0x58, 0xff, 0xff, 0xff,                             // 0162 // xchg byte ptr [rip - 168], cl
+        0xe8, 0x23, 0x00, 0x00, 0x00,                                   // 0168 // call +35 // timer event instructions
         // original instructions
-        0x48, 0xa1, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0093 // mov rax, qword ptr [gpBase address]
-        0x48, 0x8b, 0xb8, 0x38, 0x01, 0x00, 0x00,                       // 0103 // mov rdi, qword ptr [rax + 0x138] // COPY THIS
+        0x48, 0xa1, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0173 // mov rax, qword ptr [gpBase address]
+        0x48, 0x8b, 0xb8, 0x38, 0x01, 0x00, 0x00,                       // 0183 // mov rdi, qword ptr [rax + 0x138] // COPY THIS
         // jump back instructions
-        0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0110 // mov rcx, address of pop rcx instruction
-        0xff, 0xe1,                                                     // 0120 // jmp rcx
-        0x90,                                                           // 0122 // nop
-        0xcc, 0xcc, 0xcc, 0xcc, 0xcc                                    // 0123 // INT3 filler
+        0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0190 // mov rcx, address of pop rcx instruction
+        0xff, 0xe1,                                                     // 0200 // jmp rcx
+        0x90, 0x90, 0x90, 0x90, 0x90, 0x90,                             // 0202 // nops so timer event instructions start on byte 208
+        
+        // start of timer event instructions:
+        // every register the game could be using is saved, because this is called from places where the game's registers are still in use
+        0x9c,                                                           // 0208 // pushfq
+        0x50,                                                           // 0209 // push rax
+        0x51,                                                           // 0210 // push rcx
+        0x52,                                                           // 0211 // push rdx
+        0x56,                                                           // 0212 // push rsi
+        0x57,                                                           // 0213 // push rdi
+        0x41, 0x50,                                                     // 0214 // push r8
+        0x41, 0x51,                                                     // 0216 // push r9
+        0x41, 0x52,                                                     // 0218 // push r10
+        0x41, 0x53,                                                     // 0220 // push r11
+        0x55,                                                           // 0222 // push rbp
+        0x48, 0x89, 0xe5,                                               // 0223 // mov rbp, rsp
+        0x48, 0x83, 0xe4, 0xf0,                                         // 0226 // and rsp, -16 // stack is aligned by 16 for function call
+        0x48, 0x81, 0xec, 0x00, 0x02, 0x00, 0x00,                       // 0230 // sub rsp, 512
+        0x0f, 0xae, 0x04, 0x24,                                         // 0237 // fxsave [rsp] // xmm registers
+        0xfc,                                                           // 0241 // cld
+        0x0f, 0xb6, 0x3d, 0x07, 0xff, 0xff, 0xff,                       // 0242 // movzx edi, byte ptr [rip - 249] // timer byte
+        0x48, 0xb8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0249 // mov rax, recordTimerEvent address
+        0xff, 0xd0,                                                     // 0259 // call rax
+        0x0f, 0xae, 0x0c, 0x24,                                         // 0261 // fxrstor [rsp]
+        0x48, 0x89, 0xec,                                               // 0265 // mov rsp, rbp
+        0x5d,                                                           // 0268 // pop rbp
+        0x41, 0x5b,                                                     // 0269 // pop r11
+        0x41, 0x5a,                                                     // 0271 // pop r10
+        0x41, 0x59,                                                     // 0273 // pop r9
+        0x41, 0x58,                                                     // 0275 // pop r8
+        0x5f,                                                           // 0277 // pop rdi
+        0x5e,                                                           // 0278 // pop rsi
+        0x5a,                                                           // 0279 // pop rdx
+        0x59,                                                           // 0280 // pop rcx
+        0x58,                                                           // 0281 // pop rax
+        0x9d,                                                           // 0282 // popfq
+        0xc3,                                                           // 0283 // ret
+        
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0284 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0296 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0308 // INT3 filler
     };
     
     unsigned char jmpToMmap[] = {
@@ -557,38 +724,42 @@ static void injectLoadDetectionInstructions(SavedInstructions& si, unsigned char
     
     uint_t poprcxAddress = 0;
     uint_t mmapJumpAddress = 0;
+    uint_t recordTimerEventAddress = (uint_t)&recordTimerEvent;
     
     // writing to mmap memory
-    memcpy(&loadDetectionInstructions[10], si.loadEndBytes, 7); // the instruction after this one needs to be corrected for rip offset
-    memcpy(&loadDetectionInstructions[19], &si.isQuitMessagePostedAddress, sizeof(si.isQuitMessagePostedAddress));
-    memcpy(&loadDetectionInstructions[29], &si.loadEndBytes[12], 2);
+    memcpy(&loadDetectionInstructions[78], si.loadEndBytes, 7); // the instruction after this one needs to be corrected for rip offset
+    memcpy(&loadDetectionInstructions[87], &si.isQuitMessagePostedAddress, sizeof(si.isQuitMessagePostedAddress));
+    memcpy(&loadDetectionInstructions[97], &si.loadEndBytes[12], 2);
     poprcxAddress = si.loadEndAddress + 13;
-    memcpy(&loadDetectionInstructions[34], &poprcxAddress, sizeof(poprcxAddress));
+    memcpy(&loadDetectionInstructions[102], &poprcxAddress, sizeof(poprcxAddress));
     
-    memcpy(&loadDetectionInstructions[56], si.menuLoadBytes, sizeof(si.menuLoadBytes));
+    memcpy(&loadDetectionInstructions[125], si.menuLoadBytes, sizeof(si.menuLoadBytes));
     poprcxAddress = si.menuLoadAddress + 15;
-    memcpy(&loadDetectionInstructions[74], &poprcxAddress, sizeof(poprcxAddress));
+    memcpy(&loadDetectionInstructions[143], &poprcxAddress, sizeof(poprcxAddress));
     
-    memcpy(&loadDetectionInstructions[95], &si.gpBaseAddress, sizeof(si.gpBaseAddress));
-    memcpy(&loadDetectionInstructions[103], si.mapLoadBytes, sizeof(si.mapLoadBytes));
+    memcpy(&loadDetectionInstructions[175], &si.gpBaseAddress, sizeof(si.gpBaseAddress));
+    memcpy(&loadDetectionInstructions[183], si.mapLoadBytes, sizeof(si.mapLoadBytes));
     poprcxAddress = si.mapLoadAddress + 13;
-    memcpy(&loadDetectionInstructions[112], &poprcxAddress, sizeof(poprcxAddress));
+    memcpy(&loadDetectionInstructions[192], &poprcxAddress, sizeof(poprcxAddress));
+    
+    memcpy(&loadDetectionInstructions[251], &recordTimerEventAddress, sizeof(recordTimerEventAddress));
     
     memcpy(extraMemory, loadDetectionInstructions, sizeof(loadDetectionInstructions));
+    initTimerEvents(extraMemory, timerEventRingOffset, toolCountersOffset, frameTimesOffset, memfd);
     
     // writing to game executable memory
-    mmapJumpAddress = (uint_t)extraMemory + 1;
+    mmapJumpAddress = (uint_t)extraMemory + 64;
     memcpy(&jmpToMmap[3], &mmapJumpAddress, sizeof(mmapJumpAddress));
     memcpy((unsigned char*)si.loadEndAddress, jmpToMmap, sizeof(jmpToMmap));
     
-    mmapJumpAddress = (uint_t)extraMemory + 48;
+    mmapJumpAddress = (uint_t)extraMemory + 112;
     memcpy(&jmpToMmap[3], &mmapJumpAddress, sizeof(mmapJumpAddress));
     memcpy((unsigned char*)si.menuLoadAddress, jmpToMmap, sizeof(jmpToMmap) - 1);
     *((unsigned char*)(si.menuLoadAddress + 13)) = 0x90; // nop
     *((unsigned char*)(si.menuLoadAddress + 14)) = 0x90; // nop
     *((unsigned char*)(si.menuLoadAddress + 15)) = 0x59; // pop rcx
     
-    mmapJumpAddress = (uint_t)extraMemory + 85;
+    mmapJumpAddress = (uint_t)extraMemory + 160;
     memcpy(&jmpToMmap[3], &mmapJumpAddress, sizeof(mmapJumpAddress));
     memcpy((unsigned char*)si.mapLoadAddress, jmpToMmap, sizeof(jmpToMmap));
 }
@@ -632,11 +803,18 @@ static void injectSkipInstructions(SavedInstructions& si, unsigned char* extraMe
         0x41, 0x5e,                                                     // 0104 // pop r14 // stack depth +24
         0x41, 0x5d,                                                     // 0106 // pop r13 // stack depth +16
         0x41, 0x5c,                                                     // 0108 // pop r12 // stack depth +8
-        0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0110 // mov rcx, address of pop rcx instruction
-        0xff, 0xe1,                                                     // 0120 // jmp rcx
-        0x90,                                                           // 0122 // nop
+        0xf0, 0x48, 0xff, 0x05, 0x00, 0x00, 0x00, 0x00,                 // 0110 // lock inc qword ptr [rip + flashback skips counter offset]
+        0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0118 // mov rcx, address of pop rcx instruction
+        0xff, 0xe1,                                                     // 0128 // jmp rcx
+        0x90,                                                           // 0130 // nop
         
-        0xcc, 0xcc, 0xcc, 0xcc, 0xcc,                                   // 0123 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0131 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0141 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0151 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0161 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0171 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0181 // INT3 filler
+        0xcc                                                            // 0191 // INT3 filler
     };
     
     unsigned char jmpToMmap[] = {
@@ -659,8 +837,11 @@ static void injectSkipInstructions(SavedInstructions& si, unsigned char* extraMe
     memcpy(&flashbackSkipInstructions[37], &loopStopAddress, sizeof(loopStopAddress));
     memcpy(&flashbackSkipInstructions[47], &si.stopAddress, sizeof(si.stopAddress));
     memcpy(&flashbackSkipInstructions[81], &spacePerName, sizeof(spacePerName));
+    // the counters are in the same shared memory, so they're always close enough for a 32-bit offset
+    int32_t counterOffset = (int32_t)((toolCountersOffset + offsetof(ToolCounters, flashbackSkips)) - (loadDetectionInstructionsSize + 118));
+    memcpy(&flashbackSkipInstructions[114], &counterOffset, sizeof(counterOffset));
     poprcxAddress = si.beforeFadeOutAddress + 13;
-    memcpy(&flashbackSkipInstructions[112], &poprcxAddress, sizeof(poprcxAddress));
+    memcpy(&flashbackSkipInstructions[120], &poprcxAddress, sizeof(poprcxAddress));
     memcpy((unsigned char*)stringObjectAddress, &firstStringDataAddress, sizeof(firstStringDataAddress));
     
     memcpy(extraMemory + loadDetectionInstructionsSize, flashbackSkipInstructions, sizeof(flashbackSkipInstructions));
@@ -702,33 +883,41 @@ static void injectWaitInstructions(SavedInstructions& si, unsigned char* extraMe
         0x4d, 0x39, 0xec,                                               // 0104 // cmp r12, r13
         0x75, 0xe3,                                                     // 0107 // jnz, -29
         0x83, 0xfb, 0x00,                                               // 0109 // cmp ebx, 0
-        0x74, 0x19,                                                     // 0112 // jz 25
-        0xbf, 0xe8, 0x03, 0x00, 0x00,                                   // 0114 // mov edi, 1000 // 1000 microseconds (1 millisecond)
-        0x41, 0xff, 0xd7,                                               // 0119 // call r15 // FLwait
-        0x4c, 0x8b, 0x24, 0x24,                                         // 0122 // mov r12, qword ptr [rsp] // stringObjectAddress
-        0x49, 0x83, 0xc4, 0x58,                                         // 0126 // add r12, 88
-        0x4d, 0x89, 0x64, 0x24, 0xa8,                                   // 0130 // mov qword ptr [r12 - 88], r12 // resetting string object
-        0x31, 0xdb,                                                     // 0135 // xor ebx, ebx
-        0xeb, 0xc5,                                                     // 0137 // jmp -59
+        0x74, 0x21,                                                     // 0112 // jz 33
+        0xf0, 0x48, 0xff, 0x05, 0x00, 0x00, 0x00, 0x00,                 // 0114 // lock inc qword ptr [rip + flashback waits counter offset]
+        0xbf, 0xe8, 0x03, 0x00, 0x00,                                   // 0122 // mov edi, 1000 // 1000 microseconds (1 millisecond)
+        0x41, 0xff, 0xd7,                                               // 0127 // call r15 // FLwait
+        0x4c, 0x8b, 0x24, 0x24,                                         // 0130 // mov r12, qword ptr [rsp] // stringObjectAddress
+        0x49, 0x83, 0xc4, 0x58,                                         // 0134 // add r12, 88
+        0x4d, 0x89, 0x64, 0x24, 0xa8,                                   // 0138 // mov qword ptr [r12 - 88], r12 // resetting string object
+        0x31, 0xdb,                                                     // 0143 // xor ebx, ebx
+        0xeb, 0xbd,                                                     // 0145 // jmp -67
         // end of loop
         
-        0x5e,                                                           // 0139 // pop rsi // stack depth +56 // stringObjectAddress
-        0x48, 0x89, 0x36,                                               // 0140 // mov qword ptr [rsi], rsi
-        0x48, 0x83, 0x06, 0x58,                                         // 0143 // add qword ptr [rsi], 88 // resetting string object
-        0x5f,                                                           // 0147 // pop rdi // stack depth +48
-        0x5b,                                                           // 0148 // pop rbx // stack depth +40
-        0x41, 0x5f,                                                     // 0149 // pop r15 // stack depth +32
-        0x41, 0x5e,                                                     // 0151 // pop r14 // stack depth +24
-        0x41, 0x5d,                                                     // 0153 // pop r13 // stack depth +16
-        0x48, 0x8b, 0x7b, 0x28,                                         // 0155 // mov rdi, qword ptr [rbx + 0x28] // COPY THIS
-        0x48, 0x8b, 0x07,                                               // 0159 // mov rax, qword ptr [rdi] // COPY THIS
-        0xff, 0x50, 0x18,                                               // 0162 // call qword ptr [rax + 0x18] // COPY THIS
-        0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0165 // mov rcx, getApplicationTimeAddress
-        0xff, 0xd1,                                                     // 0175 // call rcx
-        0x41, 0x5c,                                                     // 0177 // pop r12 // stack depth +8
-        0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0179 // mov rcx, address of pop rcx instruction
-        0xff, 0xe1,                                                     // 0189 // jmp rcx
-        0x90                                                            // 0191 // nop
+        0x5e,                                                           // 0147 // pop rsi // stack depth +56 // stringObjectAddress
+        0x48, 0x89, 0x36,                                               // 0148 // mov qword ptr [rsi], rsi
+        0x48, 0x83, 0x06, 0x58,                                         // 0151 // add qword ptr [rsi], 88 // resetting string object
+        0x5f,                                                           // 0155 // pop rdi // stack depth +48
+        0x5b,                                                           // 0156 // pop rbx // stack depth +40
+        0x41, 0x5f,                                                     // 0157 // pop r15 // stack depth +32
+        0x41, 0x5e,                                                     // 0159 // pop r14 // stack depth +24
+        0x41, 0x5d,                                                     // 0161 // pop r13 // stack depth +16
+        0x48, 0x8b, 0x7b, 0x28,                                         // 0163 // mov rdi, qword ptr [rbx + 0x28] // COPY THIS
+        0x48, 0x8b, 0x07,                                               // 0167 // mov rax, qword ptr [rdi] // COPY THIS
+        0xff, 0x50, 0x18,                                               // 0170 // call qword ptr [rax + 0x18] // COPY THIS
+        0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0173 // mov rcx, getApplicationTimeAddress
+        0xff, 0xd1,                                                     // 0183 // call rcx
+        0x41, 0x5c,                                                     // 0185 // pop r12 // stack depth +8
+        0x48, 0xb9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0187 // mov rcx, address of pop rcx instruction
+        0xff, 0xe1,                                                     // 0197 // jmp rcx
+        0x90,                                                           // 0199 // nop
+        
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0200 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0210 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0220 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0230 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0240 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc                              // 0250 // INT3 filler
     };
     
     unsigned char jmpToMmap[] = {
@@ -753,10 +942,13 @@ static void injectWaitInstructions(SavedInstructions& si, unsigned char* extraMe
     memcpy(&flashbackWaitInstructions[58], &si.isPlayingAddress, sizeof(si.isPlayingAddress));
     memcpy(&flashbackWaitInstructions[68], &si.flWaitAddress, sizeof(si.flWaitAddress));
     memcpy(&flashbackWaitInstructions[100], &spacePerName, sizeof(spacePerName));
-    memcpy(&flashbackWaitInstructions[155], si.mapLoadEndBytes, sizeof(si.mapLoadEndBytes));
-    memcpy(&flashbackWaitInstructions[167], &si.getApplicationTimeAddress, sizeof(si.getApplicationTimeAddress));
+    // the counters are in the same shared memory, so they're always close enough for a 32-bit offset
+    int32_t counterOffset = (int32_t)((toolCountersOffset + offsetof(ToolCounters, flashbackWaits)) - (loadDetectionInstructionsSize + 122));
+    memcpy(&flashbackWaitInstructions[118], &counterOffset, sizeof(counterOffset));
+    memcpy(&flashbackWaitInstructions[163], si.mapLoadEndBytes, sizeof(si.mapLoadEndBytes));
+    memcpy(&flashbackWaitInstructions[175], &si.getApplicationTimeAddress, sizeof(si.getApplicationTimeAddress));
     poprcxAddress = si.mapLoadEndAddress + 14;
-    memcpy(&flashbackWaitInstructions[181], &poprcxAddress, sizeof(poprcxAddress));
+    memcpy(&flashbackWaitInstructions[189], &poprcxAddress, sizeof(poprcxAddress));
     memcpy((unsigned char*)stringObjectAddress, &firstStringDataAddress, sizeof(firstStringDataAddress));
     
     memcpy(extraMemory + loadDetectionInstructionsSize, flashbackWaitInstructions, sizeof(flashbackWaitInstructions));
@@ -851,40 +1043,75 @@ static void injectLoadDetectionInstructions(SavedInstructions& si, unsigned char
     unsigned char loadDetectionInstructions[loadDetectionInstructionsSize] = {
         // start of mmap memory
         0x00,                                                           // 0000 // pause/split timer byte
+        0x00, 0x00, 0x00,                                               // 0001 // padding
+        0x00, 0x00, 0x00, 0x00,                                         // 0004 // event sequence // futex word
+        0x00, 0x00, 0x00, 0x00,                                         // 0008 // event ring offset // written by initTimerEvents
+        0x00, 0x00, 0x00, 0x00,                                         // 0012 // event ring capacity // written by initTimerEvents
+        0x00, 0x00, 0x00, 0x00,                                         // 0016 // tool pid // written by initTimerEvents
+        0x00, 0x00, 0x00, 0x00,                                         // 0020 // memfd number // written by initTimerEvents
+        0x00, 0x00, 0x00, 0x00,                                         // 0024 // eventfd number // written by initTimerEvents
+        0x00, 0x00, 0x00, 0x00,                                         // 0028 // time totals sequence // seqlock
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,                 // 0032 // elapsed nanoseconds until the last event
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,                 // 0040 // paused nanoseconds until the last event
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,                 // 0048 // last event time // written by initTimerEvents
+        0x00, 0x00, 0x00, 0x00,                                         // 0056 // paused after the last event // written by initTimerEvents
+        0x00, 0x00, 0x00, 0x00,                                         // 0060 // counters offset // written by initTimerEvents
         
         // start of load finished instructions:
         // byte update instructions
-        0xb0, 0x00,                                                     // 0001 // mov al, 0x00
-        0x86, 0x05, 0x00, 0x00, 0x00, 0x00,                             // 0003 // xchg byte ptr [timer_byte_address], al
+        0xb0, 0x00,                                                     // 0064 // mov al, 0x00
+        0x86, 0x05, 0x00, 0x00, 0x00, 0x00,                             // 0066 // xchg byte ptr [timer_byte_address], al
+        0xe8, 0x3d, 0x00, 0x00, 0x00,                                   // 0072 // call +61 // timer event instructions
         // original instructions
-        0x8b, 0x43, 0x74,                                               // 0009 // mov eax, dword ptr [ebx + 0x74] // COPY THIS
-        0x89, 0x04, 0x24,                                               // 0012 // mov dword ptr [esp], eax // COPY THIS
+        0x8b, 0x43, 0x74,                                               // 0077 // mov eax, dword ptr [ebx + 0x74] // COPY THIS
+        0x89, 0x04, 0x24,                                               // 0080 // mov dword ptr [esp], eax // COPY THIS
         // jump back to game executable memory
-        0xe9, 0x00, 0x00, 0x00, 0x00,                                   // 0015 // jmp address of next instruction
-        0x90,                                                           // 0020 // nop
+        0xe9, 0x00, 0x00, 0x00, 0x00,                                   // 0083 // jmp address of next instruction
+        0x90,                                                           // 0088 // nop
         
         // start of menu load instructions:
         // byte update instructions
-        0xb0, 0x01,                                                     // 0021 // mov al, 0x01
-        0x86, 0x05, 0x00, 0x00, 0x00, 0x00,                             // 0023 // xchg byte ptr [timer_byte_address], al
+        0xb0, 0x01,                                                     // 0089 // mov al, 0x01
+        0x86, 0x05, 0x00, 0x00, 0x00, 0x00,                             // 0091 // xchg byte ptr [timer_byte_address], al
+        0xe8, 0x24, 0x00, 0x00, 0x00,                                   // 0097 // call +36 // timer event instructions
         // original instructions
-        0x8d, 0x45, 0xe5,                                               // 0029 // lea eax, [ebp + -0x1b] // COPY THIS
-        0x8d, 0x75, 0xd0,                                               // 0032 // lea esi, [ebp + -0x30] // COPY THIS
+        0x8d, 0x45, 0xe5,                                               // 0102 // lea eax, [ebp + -0x1b] // COPY THIS
+        0x8d, 0x75, 0xd0,                                               // 0105 // lea esi, [ebp + -0x30] // COPY THIS
         // jump back to game executable memory
-        0xe9, 0x00, 0x00, 0x00, 0x00,                                   // 0035 // jmp address of next instruction
-        0x90,                                                           // 0040 // nop
+        0xe9, 0x00, 0x00, 0x00, 0x00,                                   // 0108 // jmp address of next instruction
+        0x90,                                                           // 0113 // nop
         
         // start of map load instructions:
         // byte update instructions
-        0xb0, 0x02,                                                     // 0041 // mov al, 0x02
-        0x86, 0x05, 0x00, 0x00, 0x00, 0x00,                             // 0043 // xchg byte ptr [timer_byte_address], al
+        0xb0, 0x02,                                                     // 0114 // mov al, 0x02
+        0x86, 0x05, 0x00, 0x00, 0x00, 0x00,                             // 0116 // xchg byte ptr [timer_byte_address], al
+        0xe8, 0x0b, 0x00, 0x00, 0x00,                                   // 0122 // call +11 // timer event instructions
         // original instructions
-        0xa1, 0xf8, 0x87, 0xf1, 0x08,                                   // 0049 // mov eax, [0x08f187f8] // COPY THIS
+        0xa1, 0xf8, 0x87, 0xf1, 0x08,                                   // 0127 // mov eax, [0x08f187f8] // COPY THIS
         // jump back to game executable memory
-        0xe9, 0x00, 0x00, 0x00, 0x00,                                   // 0054 // jmp address of next instruction
-        0x90,                                                           // 0059 // nop
+        0xe9, 0x00, 0x00, 0x00, 0x00,                                   // 0132 // jmp address of next instruction
+        0x90,                                                           // 0137 // nop
+        
+        // start of timer event instructions:
+        // every register the game could be using is saved, because this is called from places where the game's registers are still in use
+        0x9c,                                                           // 0138 // pushfd
+        0x60,                                                           // 0139 // pushad
+        0x89, 0xe5,                                                     // 0140 // mov ebp, esp
+        0x83, 0xe4, 0xf0,                                               // 0142 // and esp, -16 // stack is aligned by 16 for function call
+        0x81, 0xec, 0x00, 0x02, 0x00, 0x00,                             // 0145 // sub esp, 512
+        0x0f, 0xae, 0x04, 0x24,                                         // 0151 // fxsave [esp] // xmm and x87 registers
+        0xfc,                                                           // 0155 // cld
+        0x0f, 0xb6, 0x05, 0x00, 0x00, 0x00, 0x00,                       // 0156 // movzx eax, byte ptr [timer_byte_address]
+        0x83, 0xec, 0x0c,                                               // 0163 // sub esp, 12 // stack stays aligned by 16 after the push
+        0x50,                                                           // 0166 // push eax
+        0xe8, 0x00, 0x00, 0x00, 0x00,                                   // 0167 // call recordTimerEvent
+        0x0f, 0xae, 0x4c, 0x24, 0x10,                                   // 0172 // fxrstor [esp + 16]
+        0x89, 0xec,                                                     // 0177 // mov esp, ebp
+        0x61,                                                           // 0179 // popad
+        0x9d,                                                           // 0180 // popfd
+        0xc3,                                                           // 0181 // ret
         
-        0xcc, 0xcc, 0xcc, 0xcc,                                         // 0060 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0182 // INT3 filler
     };
     
     unsigned char jmpToMmap[] = {0xe9, 0x00, 0x00, 0x00, 0x00, 0x90}; // nop because si.loadEndBytes and si.menuLoadBytes are six bytes
@@ -893,33 +1120,38 @@ static void injectLoadDetectionInstructions(SavedInstructions& si, unsigned char
     uint_t jumpOffset = 0;
     
     // writing to mmap memory
-    memcpy(&loadDetectionInstructions[5], &timerByteAddress, sizeof(timerByteAddress));
-    memcpy(&loadDetectionInstructions[9], si.loadEndBytes, sizeof(si.loadEndBytes));
-    jumpOffset = (si.loadEndAddress + sizeof(si.loadEndBytes)) - (timerByteAddress + 20);
-    memcpy(&loadDetectionInstructions[16], &jumpOffset, sizeof(jumpOffset));
+    memcpy(&loadDetectionInstructions[68], &timerByteAddress, sizeof(timerByteAddress));
+    memcpy(&loadDetectionInstructions[77], si.loadEndBytes, sizeof(si.loadEndBytes));
+    jumpOffset = (si.loadEndAddress + sizeof(si.loadEndBytes)) - (timerByteAddress + 88);
+    memcpy(&loadDetectionInstructions[84], &jumpOffset, sizeof(jumpOffset));
     
-    memcpy(&loadDetectionInstructions[25], &timerByteAddress, sizeof(timerByteAddress));
-    memcpy(&loadDetectionInstructions[29], si.menuLoadBytes, sizeof(si.menuLoadBytes));
-    jumpOffset = (si.menuLoadAddress + sizeof(si.menuLoadBytes)) - (timerByteAddress + 40);
-    memcpy(&loadDetectionInstructions[36], &jumpOffset, sizeof(jumpOffset));
+    memcpy(&loadDetectionInstructions[93], &timerByteAddress, sizeof(timerByteAddress));
+    memcpy(&loadDetectionInstructions[102], si.menuLoadBytes, sizeof(si.menuLoadBytes));
+    jumpOffset = (si.menuLoadAddress + sizeof(si.menuLoadBytes)) - (timerByteAddress + 113);
+    memcpy(&loadDetectionInstructions[109], &jumpOffset, sizeof(jumpOffset));
     
-    memcpy(&loadDetectionInstructions[45], &timerByteAddress, sizeof(timerByteAddress));
-    memcpy(&loadDetectionInstructions[49], si.mapLoadBytes, sizeof(si.mapLoadBytes));
-    jumpOffset = (si.mapLoadAddress + sizeof(si.mapLoadBytes)) - (timerByteAddress + 59);
-    memcpy(&loadDetectionInstructions[55], &jumpOffset, sizeof(jumpOffset));
+    memcpy(&loadDetectionInstructions[118], &timerByteAddress, sizeof(timerByteAddress));
+    memcpy(&loadDetectionInstructions[127], si.mapLoadBytes, sizeof(si.mapLoadBytes));
+    jumpOffset = (si.mapLoadAddress + sizeof(si.mapLoadBytes)) - (timerByteAddress + 137);
+    memcpy(&loadDetectionInstructions[133], &jumpOffset, sizeof(jumpOffset));
+    
+    memcpy(&loadDetectionInstructions[159], &timerByteAddress, sizeof(timerByteAddress));
+    jumpOffset = (uint_t)&recordTimerEvent - (timerByteAddress + 172);
+    memcpy(&loadDetectionInstructions[168], &jumpOffset, sizeof(jumpOffset));
     
     memcpy(extraMemory, loadDetectionInstructions, sizeof(loadDetectionInstructions));
+    initTimerEvents(extraMemory, timerEventRingOffset, toolCountersOffset, frameTimesOffset, memfd);
     
     // writing to game executable memory
-    jumpOffset = (timerByteAddress + 1) - (si.loadEndAddress + 5);
+    jumpOffset = (timerByteAddress + 64) - (si.loadEndAddress + 5);
     memcpy(&jmpToMmap[1], &jumpOffset, sizeof(jumpOffset));
     memcpy((unsigned char*)si.loadEndAddress, jmpToMmap, sizeof(si.loadEndBytes));
     
-    jumpOffset = (timerByteAddress + 21) - (si.menuLoadAddress + 5);
+    jumpOffset = (timerByteAddress + 89) - (si.menuLoadAddress + 5);
     memcpy(&jmpToMmap[1], &jumpOffset, sizeof(jumpOffset));
     memcpy((unsigned char*)si.menuLoadAddress, jmpToMmap, sizeof(si.menuLoadBytes));
     
-    jumpOffset = (timerByteAddress + 41) - (si.mapLoadAddress + 5);
+    jumpOffset = (timerByteAddress + 114) - (si.mapLoadAddress + 5);
     memcpy(&jmpToMmap[1], &jumpOffset, sizeof(jumpOffset));
     memcpy((unsigned char*)si.mapLoadAddress, jmpToMmap, sizeof(si.mapLoadBytes));
 }
@@ -946,10 +1178,18 @@ static void injectSkipInstructions(SavedInstructions& si, unsigned char* extraMe
         0x5b,                                               // 0042 // pop ebx // stack depth +8
         0x5b,                                               // 0043 // pop ebx // stack depth +4
         0x5b,                                               // 0044 // pop ebx // stack depth +0
-        0xc7, 0x44, 0x24, 0x0c, 0x01, 0x00, 0x00, 0x00,     // 0045 // mov dword ptr [esp + 12], 1 // COPY THIS
-        0xe9, 0x00, 0x00, 0x00, 0x00,                       // 0053 // jmp address of next instruction
-        0x90,                                               // 0058 // nop
-        0xcc, 0xcc, 0xcc, 0xcc, 0xcc                        // 0059 // INT3 filler
+        0xf0, 0xff, 0x05, 0x00, 0x00, 0x00, 0x00,           // 0045 // lock inc dword ptr [flashback skips counter address]
+        0xc7, 0x44, 0x24, 0x0c, 0x01, 0x00, 0x00, 0x00,     // 0052 // mov dword ptr [esp + 12], 1 // COPY THIS
+        0xe9, 0x00, 0x00, 0x00, 0x00,                       // 0060 // jmp address of next instruction
+        0x90,                                               // 0065 // nop
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0066 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0074 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0082 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0090 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0098 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0106 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0114 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc                  // 0122 // INT3 filler
     };
     
     unsigned char jmpToMmap[] = {0xe9, 0x00, 0x00, 0x00, 0x00, 0x90, 0x90, 0x90}; // nops because the first instruction in si.beforeFadeOutBytes is 8 bytes
@@ -969,9 +1209,11 @@ static void injectSkipInstructions(SavedInstructions& si, unsigned char* extraMe
     memcpy(&flashbackSkipInstructions[23], &jumpOffset, sizeof(si.stopAddress));
     memcpy(&flashbackSkipInstructions[29], &spacePerName, sizeof(spacePerName));
     memcpy(&flashbackSkipInstructions[35], &loopStopAddress, sizeof(loopStopAddress));
-    memcpy(&flashbackSkipInstructions[45], si.beforeFadeOutBytes, sizeof(jmpToMmap));
-    jumpOffset = (si.beforeFadeOutAddress + sizeof(si.gettingSoundHandler) + sizeof(jmpToMmap)) - (mmapJumpAddress + 58);
-    memcpy(&flashbackSkipInstructions[54], &jumpOffset, sizeof(jumpOffset));
+    uint_t counterAddress = (uint_t)extraMemory + toolCountersOffset + offsetof(ToolCounters, flashbackSkips);
+    memcpy(&flashbackSkipInstructions[48], &counterAddress, sizeof(counterAddress));
+    memcpy(&flashbackSkipInstructions[52], si.beforeFadeOutBytes, sizeof(jmpToMmap));
+    jumpOffset = (si.beforeFadeOutAddress + sizeof(si.gettingSoundHandler) + sizeof(jmpToMmap)) - (mmapJumpAddress + 65);
+    memcpy(&flashbackSkipInstructions[61], &jumpOffset, sizeof(jumpOffset));
     
     memcpy(extraMemory + loadDetectionInstructionsSize, flashbackSkipInstructions, sizeof(flashbackSkipInstructions));
     
@@ -1005,28 +1247,28 @@ static void injectWaitInstructions(SavedInstructions& si, unsigned char* extraMe
         0x81, 0xfb, 0x00, 0x00, 0x00, 0x00,                 // 0051 // cmp ebx, loopStopAddress
         0x75, 0xe5,                                         // 0057 // jnz -27
         0x83, 0xfe, 0x00,                                   // 0059 // cmp esi, 0
-        0x74, 0x1a,                                         // 0062 // jz 26
-        0x8b, 0x1c, 0x24,                                   // 0064 // mov ebx, dword ptr [esp] // cSoundHandler object
-        0xc1, 0xe6, 0x0a,                                   // 0067 // shl esi, 10 // changing esi from 1 to 1024 for approximately one millisecond
-        0x89, 0x34, 0x24,                                   // 0070 // mov dword ptr [esp], esi
-        0xe8, 0x00, 0x00, 0x00, 0x00,                       // 0073 // call FLwait
-        0x89, 0x1c, 0x24,                                   // 0078 // mov dword ptr [esp], ebx // cSoundHandler object
-        0xbb, 0x00, 0x00, 0x00, 0x00,                       // 0081 // mov ebx, firstStringDataAddress
-        0x31, 0xf6,                                         // 0086 // xor esi, esi
-        0xeb, 0xc6,                                         // 0088 // jmp -58
+        0x74, 0x21,                                         // 0062 // jz 33
+        0xf0, 0xff, 0x05, 0x00, 0x00, 0x00, 0x00,           // 0064 // lock inc dword ptr [flashback waits counter address]
+        0x8b, 0x1c, 0x24,                                   // 0071 // mov ebx, dword ptr [esp] // cSoundHandler object
+        0xc1, 0xe6, 0x0a,                                   // 0074 // shl esi, 10 // changing esi from 1 to 1024 for approximately one millisecond
+        0x89, 0x34, 0x24,                                   // 0077 // mov dword ptr [esp], esi
+        0xe8, 0x00, 0x00, 0x00, 0x00,                       // 0080 // call FLwait
+        0x89, 0x1c, 0x24,                                   // 0085 // mov dword ptr [esp], ebx // cSoundHandler object
+        0xbb, 0x00, 0x00, 0x00, 0x00,                       // 0088 // mov ebx, firstStringDataAddress
+        0x31, 0xf6,                                         // 0093 // xor esi, esi
+        0xeb, 0xbf,                                         // 0095 // jmp -65
         // end of loop
         
-        0x5e,                                               // 0090 // pop esi // stack depth +12
-        0x5e,                                               // 0091 // pop esi // stack depth +8
-        0x5e,                                               // 0092 // pop esi // stack depth +4
-        0x5b,                                               // 0093 // pop ebx // stack depth +0
-        0x8b, 0x43, 0x14,                                   // 0094 // mov eax, dword ptr [ebx + 0x14] // COPY THIS
-        0x8b, 0x10,                                         // 0097 // edx, dword ptr [eax] // COPY THIS
-        0xe9, 0x00, 0x00, 0x00, 0x00,                       // 0099 // jmp address of next instruction
-        0x90,                                               // 0104 // nop
-        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0105 // INT3 filler
-        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0113 // INT3 filler
-        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc            // 0121 // INT3 filler
+        0x5e,                                               // 0097 // pop esi // stack depth +12
+        0x5e,                                               // 0098 // pop esi // stack depth +8
+        0x5e,                                               // 0099 // pop esi // stack depth +4
+        0x5b,                                               // 0100 // pop ebx // stack depth +0
+        0x8b, 0x43, 0x14,                                   // 0101 // mov eax, dword ptr [ebx + 0x14] // COPY THIS
+        0x8b, 0x10,                                         // 0104 // edx, dword ptr [eax] // COPY THIS
+        0xe9, 0x00, 0x00, 0x00, 0x00,                       // 0106 // jmp address of next instruction
+        0x90,                                               // 0111 // nop
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,     // 0112 // INT3 filler
+        0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc      // 0120 // INT3 filler
     };
     
     unsigned char jmpToMmap[] = {0xe9, 0x00, 0x00, 0x00, 0x00};
@@ -1047,12 +1289,14 @@ static void injectWaitInstructions(SavedInstructions& si, unsigned char* extraMe
     memcpy(&flashbackWaitInstructions[39], &jumpOffset, sizeof(jumpOffset));
     memcpy(&flashbackWaitInstructions[47], &spacePerName, sizeof(spacePerName));
     memcpy(&flashbackWaitInstructions[53], &loopStopAddress, sizeof(loopStopAddress));
-    jumpOffset = si.flWaitAddress - (mmapJumpAddress + 78);
-    memcpy(&flashbackWaitInstructions[74], &jumpOffset, sizeof(jumpOffset));
-    memcpy(&flashbackWaitInstructions[82], &firstStringDataAddress, sizeof(firstStringDataAddress));
-    memcpy(&flashbackWaitInstructions[94], si.mapLoadEndBytes, sizeof(si.mapLoadEndBytes));
-    jumpOffset = (si.mapLoadEndAddress + sizeof(si.mapLoadEndBytes)) - (mmapJumpAddress + 104);
-    memcpy(&flashbackWaitInstructions[100], &jumpOffset, sizeof(jumpOffset));
+    uint_t counterAddress = (uint_t)extraMemory + toolCountersOffset + offsetof(ToolCounters, flashbackWaits);
+    memcpy(&flashbackWaitInstructions[67], &counterAddress, sizeof(counterAddress));
+    jumpOffset = si.flWaitAddress - (mmapJumpAddress + 85);
+    memcpy(&flashbackWaitInstructions[81], &jumpOffset, sizeof(jumpOffset));
+    memcpy(&flashbackWaitInstructions[89], &firstStringDataAddress, sizeof(firstStringDataAddress));
+    memcpy(&flashbackWaitInstructions[101], si.mapLoadEndBytes, sizeof(si.mapLoadEndBytes));
+    jumpOffset = (si.mapLoadEndAddress + sizeof(si.mapLoadEndBytes)) - (mmapJumpAddress + 111);
+    memcpy(&flashbackWaitInstructions[107], &jumpOffset, sizeof(jumpOffset));
     
     memcpy(extraMemory + loadDetectionInstructionsSize, flashbackWaitInstructions, sizeof(flashbackWaitInstructions));
     
@@ -1117,7 +1361,7 @@ static bool getMemfdName(char* memfdName, const size_t memfdNameBufferSize)
     return true;
 }
 
-static bool setupMemory(const bool skipFlashbacks, const bool delayFlashbacks)
+static bool setupMemory(const bool skipFlashbacks, const bool delayFlashbacks, const bool profileFunctions, FlashbackNameArea& nameArea)
 {
     char memfdName[320]{};
     
@@ -1125,6 +1369,7 @@ static bool setupMemory(const bool skipFlashbacks, const bool delayFlashbacks)
     {
         return false;
     }
+    startupProfiler.endPhase(StartupPhase::MemfdName);
     
     uint_t gameStartAddress = 0;
     uint_t gameEndAddress = 0;
@@ -1140,63 +1385,68 @@ static bool setupMemory(const bool skipFlashbacks, const bool delayFlashbacks)
     {
         return false;
     }
+    startupProfiler.endPhase(StartupPhase::Maps);
     
     size_t gameSize = gameEndAddress - gameStartAddress;
     
-    uint_t howManyNames = 0;
-    uint_t longestName = 0;
-    uint_t spacePerName = 0;
-    uint_t nameAreaOffset = 0;
+    uint_t& howManyNames = nameArea.howManyNames;
+    uint_t& spacePerName = nameArea.spacePerName;
+    uint_t& nameAreaOffset = nameArea.nameAreaOffset;
     // also extraMemorySize, which is global so the __attribute__((destructor)) function can access it
     
     SavedInstructions si;
     
     if (skipFlashbacks || delayFlashbacks)
     {
-        const uint_t stringDataSize = sizeof(uint_t) * 3;
         const char flashbackNameFile[] = "flashback_names.txt";
         bool flashbackInjectionReady = true;
         
-        // FileHelper object is only used in this area, so this scope is used so it doesn't stay allocated longer than it's needed
+        // 64 bytes to store string object plus padding
+        nameAreaOffset = loadDetectionInstructionsSize + (skipFlashbacks ? flashbackSkipInstructionsSize : flashbackWaitInstructionsSize) + 64;
+        
+        if (configCache.loaded()) // the names were copied into the cache when it was made
         {
-            FileHelper fh(flashbackNameFile);
-            if (fh.fd == -1) // error message will have been printed in the constructor
+            if (!loadCachedFlashbackNames(configCache.nameTable(), memfdName, nameAreaOffset, howManyNames, spacePerName))
             {
                 return false;
             }
-            
-            preprocessFlashbackNames(fh, howManyNames, longestName);
-            
-             // + 1 for null terminator
-            spacePerName = (((longestName + stringDataSize + 1) / 64) + (((longestName + stringDataSize + 1) % 64) != 0)) * 64;
-            // 64 bytes to store string object plus padding
-            nameAreaOffset = loadDetectionInstructionsSize + (skipFlashbacks ? flashbackSkipInstructionsSize : flashbackWaitInstructionsSize) + 64;
-            extraMemorySize = nameAreaOffset + (spacePerName * howManyNames);
-            
-            if (howManyNames == 0)
-            {
-                printCstr("ERROR: no flashback line names found in "); printCstr(flashbackNameFile); printCstr("\n");
-                // printf("ERROR: no flashback line names found in %s\n", flashbackNameFile);
-                flashbackInjectionReady = false;
-            }
-            
-            if (spacePerName > 0x7fffffff) // rbx can't have an immediate value larger than this added to it
-            {
-                printCstr("ERROR: flashback line names can't be longer than 2147483647\n");
-                flashbackInjectionReady = false;
-            }
-            
-            if (!setupMemfdPages(memfdName, extraMemorySize))
+        }
+        else
+        {
+            // MappedFileLines object is only used in this area, so this scope is used so the file doesn't stay mapped longer than it's needed
+            MappedFileLines lines(flashbackNameFile);
+            if (!lines.opened) // error message will have been printed in the constructor
             {
                 return false;
             }
             
-            if (!setFlashbackNames((unsigned char*)mmapAddress, fh, nameAreaOffset, spacePerName, extraMemorySize))
+            // the pages grow while the names are read, so this only needs to be a guess
+            if (!createMemfdPages(memfdName, nameAreaOffset + flashbackNamesInitialSpace) || !loadFlashbackNames(lines, nameAreaOffset, howManyNames, spacePerName))
             {
-                flashbackInjectionReady = false;
+                return false;
             }
         }
         
+        if (howManyNames == 0)
+        {
+            printCstr("ERROR: no flashback line names found in "); printCstr(flashbackNameFile); printCstr("\n");
+            // printf("ERROR: no flashback line names found in %s\n", flashbackNameFile);
+            flashbackInjectionReady = false;
+        }
+        
+        if (spacePerName > 0x7fffffff) // rbx can't have an immediate value larger than this added to it
+        {
+            printCstr("ERROR: flashback line names can't be longer than 2147483647\n");
+            flashbackInjectionReady = false;
+        }
+        startupProfiler.endPhase(StartupPhase::FlashbackNames);
+        
+        if (!sealMemfdPages())
+        {
+            return false;
+        }
+        startupProfiler.endPhase(StartupPhase::Memfd);
+        
         if (!flashbackInjectionReady)
         {
             printCstr("can't inject flashback skip/wait instructions\n");
@@ -1206,6 +1456,7 @@ static bool setupMemory(const bool skipFlashbacks, const bool delayFlashbacks)
         {
             return false;
         }
+        startupProfiler.endPhase(StartupPhase::PatternScan);
         
         if (mprotect((void*)gameStartAddress, gameSize, PROT_READ | PROT_WRITE) != 0)
         {
@@ -1213,6 +1464,7 @@ static bool setupMemory(const bool skipFlashbacks, const bool delayFlashbacks)
             // printf("ERROR: mprotect failure when setting game memory access protection to PROT_READ | PROT_WRITE: %d\n", errno);
             return false;
         }
+        startupProfiler.endPhase(StartupPhase::Mprotect);
         
         injectLoadDetectionInstructions(si, (unsigned char*)mmapAddress);
         
@@ -1227,6 +1479,7 @@ static bool setupMemory(const bool skipFlashbacks, const bool delayFlashbacks)
                 injectWaitInstructions(si, (unsigned char*)mmapAddress, howManyNames, (uint32_t)spacePerName);
             }
         }
+        startupProfiler.endPhase(StartupPhase::Injection);
         
         if (mprotect((void*)gameStartAddress, gameSize, PROT_READ | PROT_EXEC) != 0)
         {
@@ -1234,6 +1487,7 @@ static bool setupMemory(const bool skipFlashbacks, const bool delayFlashbacks)
             // printf("WARNING: mprotect failure when setting game memory back to PROT_READ | PROT_EXEC: %d\n", errno);
             return false;
         }
+        startupProfiler.endPhase(StartupPhase::Mprotect);
     }
     else
     {
@@ -1241,11 +1495,13 @@ static bool setupMemory(const bool skipFlashbacks, const bool delayFlashbacks)
         {
             return false;
         }
+        startupProfiler.endPhase(StartupPhase::Memfd);
         
         if (!findInstructions(si, (unsigned char*)(gameStartAddress), gameSize))
         {
             return false;
         }
+        startupProfiler.endPhase(StartupPhase::PatternScan);
         
         if (mprotect((void*)gameStartAddress, gameSize, PROT_READ | PROT_WRITE) != 0)
         {
@@ -1253,8 +1509,10 @@ static bool setupMemory(const bool skipFlashbacks, const bool delayFlashbacks)
             // printf("ERROR: mprotect failure when setting game memory access protection to PROT_READ | PROT_WRITE: %d\n", errno);
             return false;
         }
+        startupProfiler.endPhase(StartupPhase::Mprotect);
         
         injectLoadDetectionInstructions(si, (unsigned char*)mmapAddress);
+        startupProfiler.endPhase(StartupPhase::Injection);
         
         if (mprotect((void*)gameStartAddress, gameSize, PROT_READ | PROT_EXEC) != 0)
         {
@@ -1262,15 +1520,74 @@ static bool setupMemory(const bool skipFlashbacks, const bool delayFlashbacks)
             // printf("WARNING: mprotect failure when setting game memory back to PROT_READ | PROT_EXEC: %d\n", errno);
             return false;
         }
+        startupProfiler.endPhase(StartupPhase::Mprotect);
+    }
+    
+    if (profileFunctions)
+    {
+        installFunctionProbes((unsigned char*)gameStartAddress, gameSize);
+        startupProfiler.endPhase(StartupPhase::FunctionProbes);
     }
     
+    if (publishTimerRendezvous(memfdName, memfd) == TimerRendezvousResult::Failed) // without XDG_RUNTIME_DIR, timers just search like before
+    {
+        printCstr("couldn't write the rendezvous file in XDG_RUNTIME_DIR, timer programs will have to search for the game\n");
+    }
+    startupProfiler.endPhase(StartupPhase::Rendezvous);
+    
     return true;
 }
 
-static bool readSettingsFile(bool& skipFlashbacks, bool& delayFlashbacks, bool& delayFiles)
+struct ToolSettings
+{
+    bool skipFlashbacks = false;
+    bool delayFlashbacks = false;
+    bool delayFiles = false;
+    // settings after the first three are optional so settings files from older versions don't get reset
+    bool prefetchMapFiles = false;
+    bool warmPageCache = false;
+    size_t pageCacheBudgetMegabytes = 256;
+    bool mmapAssetFiles = false;
+    bool loadHistory = false;
+    bool recordFileOpens = false;
+    bool profileFunctions = false;
+    bool sampleLoads = false;
+};
+
+static uint32_t getConfigCacheSettingsFlags(const ToolSettings& settings)
+{
+    return (settings.skipFlashbacks ? configCacheSkipFlashbacks : 0)
+        | (settings.delayFlashbacks ? configCacheDelayFlashbacks : 0)
+        | (settings.delayFiles ? configCacheDelayFiles : 0)
+        | (settings.prefetchMapFiles ? configCachePrefetchMapFiles : 0)
+        | (settings.warmPageCache ? configCacheWarmPageCache : 0)
+        | (settings.mmapAssetFiles ? configCacheMmapAssetFiles : 0)
+        | (settings.loadHistory ? configCacheLoadHistory : 0)
+        | (settings.recordFileOpens ? configCacheRecordFileOpens : 0)
+        | (settings.profileFunctions ? configCacheProfileFunctions : 0)
+        | (settings.sampleLoads ? configCacheSampleLoads : 0);
+}
+
+static void readCachedSettings(ToolSettings& settings, const ConfigCacheHeader& cacheHeader)
+{
+    settings.skipFlashbacks = (cacheHeader.settingsFlags & configCacheSkipFlashbacks) != 0;
+    settings.delayFlashbacks = (cacheHeader.settingsFlags & configCacheDelayFlashbacks) != 0;
+    settings.delayFiles = (cacheHeader.settingsFlags & configCacheDelayFiles) != 0;
+    settings.prefetchMapFiles = (cacheHeader.settingsFlags & configCachePrefetchMapFiles) != 0;
+    settings.warmPageCache = (cacheHeader.settingsFlags & configCacheWarmPageCache) != 0;
+    settings.pageCacheBudgetMegabytes = (size_t)cacheHeader.pageCacheBudgetMegabytes;
+    settings.mmapAssetFiles = (cacheHeader.settingsFlags & configCacheMmapAssetFiles) != 0;
+    settings.loadHistory = (cacheHeader.settingsFlags & configCacheLoadHistory) != 0;
+    settings.recordFileOpens = (cacheHeader.settingsFlags & configCacheRecordFileOpens) != 0;
+    settings.profileFunctions = (cacheHeader.settingsFlags & configCacheProfileFunctions) != 0;
+    settings.sampleLoads = (cacheHeader.settingsFlags & configCacheSampleLoads) != 0;
+}
+
+static bool readSettingsFile(ToolSettings& settings)
 {
     // make sure this is small enough to fit in the buffer
-    char defaultText[] = "skip flashbacks: n\ndelay flashbacks: y\ndelay files: n\n";
+    char defaultText[] = "skip flashbacks: n\ndelay flashbacks: y\ndelay files: n\nprefetch map files: n\n\
+warm page cache: n\npage cache budget mb: 256\nmmap asset files: n\nload history: n\nrecord file opens: n\nprofile functions: n\nsample loads: n\n";
     
     char buffer[256]{};
     const char settingsFileName[] = "amnesia_settings.txt";
@@ -1278,6 +1595,14 @@ static bool readSettingsFile(bool& skipFlashbacks, bool& delayFlashbacks, bool&
     char skipFlashbacksSettingName[] = "skip flashbacks";
     char delayFlashbacksSettingName[] = "delay flashbacks";
     char delayFilesSettingName[] = "delay files";
+    char prefetchMapFilesSettingName[] = "prefetch map files";
+    char warmPageCacheSettingName[] = "warm page cache";
+    char pageCacheBudgetSettingName[] = "page cache budget mb";
+    char mmapAssetFilesSettingName[] = "mmap asset files";
+    char loadHistorySettingName[] = "load history";
+    char recordFileOpensSettingName[] = "record file opens";
+    char profileFunctionsSettingName[] = "profile functions";
+    char sampleLoadsSettingName[] = "sample loads";
     
     bool skipFlashbacksFound = false;
     bool delayFlashbacksFound = false;
@@ -1333,6 +1658,20 @@ static bool readSettingsFile(bool& skipFlashbacks, bool& delayFlashbacks, bool&
             continue;
         }
         
+        if (myStrncmp(&buffer[lineStartIdx], pageCacheBudgetSettingName, settingNameLength) == 0) // this setting is a number instead of y or n
+        {
+            size_t megabytes = 0;
+            for (; bufferIdx < charactersRead && buffer[bufferIdx] != '\n'; bufferIdx++)
+            {
+                if (buffer[bufferIdx] >= '0' && buffer[bufferIdx] <= '9' && megabytes <= (SIZE_MAX / (1024 * 1024)) / 10)
+                {
+                    megabytes = (megabytes * 10) + (size_t)(buffer[bufferIdx] - '0');
+                }
+            }
+            settings.pageCacheBudgetMegabytes = megabytes;
+            continue;
+        }
+        
         while (bufferIdx < charactersRead && buffer[bufferIdx] != '\n') // find y or n option
         {
             if (buffer[bufferIdx] == 'y' || buffer[bufferIdx] == 'Y' || buffer[bufferIdx] == 'n' || buffer[bufferIdx] == 'N')
@@ -1355,19 +1694,47 @@ static bool readSettingsFile(bool& skipFlashbacks, bool& delayFlashbacks, bool&
         
         if (myStrncmp(&buffer[lineStartIdx], skipFlashbacksSettingName, settingNameLength) == 0)
         {
-            skipFlashbacks = settingOnOrOff;
+            settings.skipFlashbacks = settingOnOrOff;
             skipFlashbacksFound = true;
         }
         else if (myStrncmp(&buffer[lineStartIdx], delayFlashbacksSettingName, settingNameLength) == 0)
         {
-            delayFlashbacks = settingOnOrOff;
+            settings.delayFlashbacks = settingOnOrOff;
             delayFlashbacksFound = true;
         }
         else if (myStrncmp(&buffer[lineStartIdx], delayFilesSettingName, settingNameLength) == 0)
         {
-            delayFiles = settingOnOrOff;
+            settings.delayFiles = settingOnOrOff;
             delayFilesFound = true;
         }
+        else if (myStrncmp(&buffer[lineStartIdx], prefetchMapFilesSettingName, settingNameLength) == 0)
+        {
+            settings.prefetchMapFiles = settingOnOrOff;
+        }
+        else if (myStrncmp(&buffer[lineStartIdx], warmPageCacheSettingName, settingNameLength) == 0)
+        {
+            settings.warmPageCache = settingOnOrOff;
+        }
+        else if (myStrncmp(&buffer[lineStartIdx], mmapAssetFilesSettingName, settingNameLength) == 0)
+        {
+            settings.mmapAssetFiles = settingOnOrOff;
+        }
+        else if (myStrncmp(&buffer[lineStartIdx], loadHistorySettingName, settingNameLength) == 0)
+        {
+            settings.loadHistory = settingOnOrOff;
+        }
+        else if (myStrncmp(&buffer[lineStartIdx], recordFileOpensSettingName, settingNameLength) == 0)
+        {
+            settings.recordFileOpens = settingOnOrOff;
+        }
+        else if (myStrncmp(&buffer[lineStartIdx], profileFunctionsSettingName, settingNameLength) == 0)
+        {
+            settings.profileFunctions = settingOnOrOff;
+        }
+        else if (myStrncmp(&buffer[lineStartIdx], sampleLoadsSettingName, settingNameLength) == 0)
+        {
+            settings.sampleLoads = settingOnOrOff;
+        }
     }
     
     if (!(skipFlashbacksFound && delayFlashbacksFound && delayFilesFound))
@@ -1390,8 +1757,16 @@ static bool readSettingsFile(bool& skipFlashbacks, bool& delayFlashbacks, bool&
     return true;
 }
 
-static void freeResources()
+// when the game exits, the shared memory and the config cache aren't unmapped, because the game's other threads can still be in
+// the hooks or the load detection instructions, which would fault on them. the delay table in the config cache is used by the
+// fopen hooks until a file edit replaces it. they're freed with the process
+static void freeResources(const bool gameExiting)
 {
+    if (!gameExiting)
+    {
+        configCache.unload();
+    }
+    removeTimerRendezvous();
     if (memfd != -1)
     {
         close(memfd);
@@ -1401,11 +1776,33 @@ static void freeResources()
     {
         std::atomic_ref<unsigned char> timerByteAtomicRef(*((unsigned char*)mmapAddress));
         timerByteAtomicRef.store(255);
-        munmap(mmapAddress, extraMemorySize);
+        recordTimerEvent(255);
+        stopTimerEvents();
+        if (!gameExiting)
+        {
+            munmap(mmapAddress, extraMemorySize);
+        }
         mmapAddress = MAP_FAILED;
     }
 }
 
+// set as timerEventObserver when "load history", "profile functions" or "sample loads" is on
+static void observeTimerEvent(const uint32_t eventCode, const int64_t monotonicNanoseconds)
+{
+    if (loadHistoryActive)
+    {
+        recordLoadHistoryEvent(eventCode, monotonicNanoseconds);
+    }
+    if (functionProbesActive)
+    {
+        reportFunctionProbes(eventCode);
+    }
+    if (loadSamplerActive)
+    {
+        loadSampler.timerEvent(eventCode);
+    }
+}
+
 __attribute__((constructor)) void readSettingsAndGetResources()
 {
 #if __x86_64__ || __ppc64__
@@ -1414,29 +1811,61 @@ __attribute__((constructor)) void readSettingsAndGetResources()
     printCstr("ATTENTION: Speedrunning on the 64-bit version of Amnesia TDD saves time due to permanent slippery physics.\n\
 If you have a 64-bit computer, you should speedrun on the 64-bit version of Amnesia TDD instead.\n");
 #endif
-    bool skipFlashbacks = false;
-    bool delayFlashbacks = false;
-    bool delayFiles = false;
+    ToolSettings settings;
+    FlashbackNameArea nameArea;
+    startupProfiler.start();
+    
+    // the stamps are read before the text files so the cache can't say it has changes made after they were read
+    ConfigCacheSourceStamp sourceStamps[configCacheSourceCount];
+    ConfigCache::readSourceStamps(sourceStamps);
     
-    if (!readSettingsFile(skipFlashbacks, delayFlashbacks, delayFiles))
+    bool cacheLoaded = configCache.load(sourceStamps);
+    startupProfiler.endPhase(StartupPhase::ConfigCache);
+    if (cacheLoaded)
+    {
+        readCachedSettings(settings, configCache.header());
+    }
+    else if (!readSettingsFile(settings))
     {
+        startupProfiler.endPhase(StartupPhase::Settings);
+        startupProfiler.print(false);
         return;
     }
+    startupProfiler.endPhase(StartupPhase::Settings);
     
-    if (!setupMemory(skipFlashbacks, delayFlashbacks))
+    if (!setupMemory(settings.skipFlashbacks, settings.delayFlashbacks, settings.profileFunctions, nameArea))
     {
-        freeResources();
+        freeResources(false);
+        startupProfiler.print(false);
         
         return;
     }
     
-    delaysActive = delayFiles; // this is in load_extender.h and determines if the file delay function gets called
+    if (!configCache.loaded())
+    {
+        configCache.rebuild(getConfigCacheSettingsFlags(settings), settings.pageCacheBudgetMegabytes, sourceStamps,
+            (unsigned char*)mmapAddress + nameArea.nameAreaOffset, nameArea.spacePerName, nameArea.howManyNames, sizeof(uint_t) * 3);
+    }
+    startupProfiler.endPhase(StartupPhase::CacheRebuild);
+    
+    timerBytePointer = (unsigned char*)mmapAddress; // this is in load_extender.h and lets the fopen hooks see when loads end
+    delaysActive = settings.delayFiles; // this is in load_extender.h and determines if the file delay function gets called
+    prefetchActive = settings.prefetchMapFiles; // this is in map_prefetcher.h and determines if map files get recorded and prefetched
+    warmPageCacheBudget = settings.pageCacheBudgetMegabytes * 1024 * 1024; // these are in page_cache_warmer.h
+    warmPageCacheActive = settings.warmPageCache && warmPageCacheBudget != 0;
+    mmapStreamsActive = settings.mmapAssetFiles; // this is in mmap_file_streams.h and determines if asset files are opened as mapped streams
+    loadHistoryActive = settings.loadHistory; // this is in load_history.h and makes every load get saved in load_history
+    functionProbesActive = settings.profileFunctions && functionProbeCount != 0; // this is in function_probes.h and prints a profile after every load
+    loadSamplerActive = settings.sampleLoads; // this is in load_sampler.h and makes every load's stacks get written to load_samples
+    timerEventObserver = loadHistoryActive || functionProbesActive || loadSamplerActive ? &observeTimerEvent : nullptr; // this is in timer_events.h
+    fileOpenTraceActive = settings.recordFileOpens; // this is in file_open_trace.h and makes every hooked path get written to file_open_traces
     
     printCstr("amnesia injected successfully.\n");
+    startupProfiler.print(true);
 }
 
 __attribute__((destructor)) void freeResourcesEnd()
 {
-    freeResources();
+    freeResources(true);
 }
 
@@ -0,0 +1,673 @@
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdio> // rename
+#include <climits>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+// Like non_std_functions.h, this avoids standard C/C++ functions and objects, because the cache is loaded in the __attribute__((constructor)) function.
+// fnv1a_hash.h has to be included before this
+
+static const char configCacheFileName[] = "amnesia_config_cache.bin";
+static const char configCacheTempFileName[] = "amnesia_config_cache.bin.tmp";
+static const char configCacheMagic[4] = {'A', 'M', 'C', 'C'};
+static const uint32_t configCacheVersion = 1;
+static const char delaysFileName[] = "files_and_delays.txt";
+
+// the text files the cache is made from, in the same order as ConfigCacheHeader::sources
+static const size_t configCacheSourceCount = 3;
+static const char* const configCacheSourceNames[configCacheSourceCount] = {
+    "amnesia_settings.txt",
+    delaysFileName,
+    "flashback_names.txt"
+};
+
+// ConfigCacheHeader::settingsFlags bits
+static const uint32_t configCacheSkipFlashbacks = 1 << 0;
+static const uint32_t configCacheDelayFlashbacks = 1 << 1;
+static const uint32_t configCacheDelayFiles = 1 << 2;
+static const uint32_t configCachePrefetchMapFiles = 1 << 3;
+static const uint32_t configCacheWarmPageCache = 1 << 4;
+static const uint32_t configCacheMmapAssetFiles = 1 << 5;
+static const uint32_t configCacheLoadHistory = 1 << 6;
+static const uint32_t configCacheRecordFileOpens = 1 << 7;
+static const uint32_t configCacheProfileFunctions = 1 << 8;
+static const uint32_t configCacheSampleLoads = 1 << 9;
+
+// a source file which doesn't exist has a size of UINT64_MAX
+struct ConfigCacheSourceStamp
+{
+    int64_t modifiedSeconds = 0;
+    int64_t modifiedNanoseconds = 0;
+    uint64_t size = 0;
+};
+
+// The cache is: ConfigCacheHeader | flat delay table | flat name table
+// Everything is fixed width so the 32-bit and 64-bit tools can use the same cache. Offsets are from the start of the cache.
+struct ConfigCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t checksum; // getConfigCacheChecksum of every byte after this
+    uint64_t size;
+    ConfigCacheSourceStamp sources[configCacheSourceCount];
+    uint64_t pageCacheBudgetMegabytes;
+    uint32_t settingsFlags;
+    uint32_t delayTableOffset;
+    uint32_t delayTableSize;
+    uint32_t nameTableOffset;
+    uint32_t nameTableSize;
+    uint32_t padding;
+};
+
+// A flat delay table is an open addressing hash table: FlatDelayTableHeader | slots | int32 delays | key bytes
+// Offsets are from the start of the table, so a table works the same inside the cache or by itself after files_and_delays.txt is reloaded.
+// fullResetGeneration and positionAndGeneration change while the game runs, so the cache is mapped writable and MAP_PRIVATE.
+struct FlatDelayTableHeader
+{
+    uint32_t slotCount; // a power of 2
+    uint32_t fileCount;
+    uint32_t delaysOffset;
+    uint32_t keysOffset;
+    uint32_t size;
+    uint32_t fullResetGeneration;
+};
+
+struct FlatDelaySlot
+{
+    uint64_t hash;
+    // the low 32 bits are the position in the file's delays, the high 32 bits are the full reset generation the position belongs to
+    uint64_t positionAndGeneration;
+    uint32_t keyOffset;
+    uint32_t keyLength; // 0 for an empty slot
+    // the file's delays start here in the int32 delays, see DelayTable::takeDelay for what -1 and -2 mean
+    uint32_t delaysIndex;
+    uint32_t padding;
+};
+
+// A flat name table is: FlatNameTableHeader | per name: uint32 length | name, padded to 4 bytes
+struct FlatNameTableHeader
+{
+    uint32_t nameCount;
+    uint32_t longestName;
+};
+
+static_assert(sizeof(ConfigCacheHeader) == 128 && sizeof(FlatDelayTableHeader) == 24 && sizeof(FlatDelaySlot) == 32 && sizeof(FlatNameTableHeader) == 8,
+    "the cache layout has to be the same for the 32-bit and 64-bit tools");
+
+// FNV-1a style, but 8 bytes at a time in 4 lanes so it isn't limited by one multiply per byte
+static uint64_t getConfigCacheChecksum(const unsigned char* bytes, const size_t size)
+{
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t lanes[4] = {14695981039346656037ULL, 14695981039346656037ULL ^ 1, 14695981039346656037ULL ^ 2, 14695981039346656037ULL ^ 3};
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32)
+    {
+        for (size_t laneIdx = 0; laneIdx < 4; laneIdx++)
+        {
+            uint64_t word = 0;
+            memcpy(&word, bytes + i + (laneIdx * 8), sizeof(word));
+            lanes[laneIdx] = (lanes[laneIdx] ^ word) * prime;
+        }
+    }
+
+    uint64_t checksum = fnv1a64(bytes + i, size - i); // the last bytes which don't fill all 4 lanes
+    for (uint64_t lane : lanes)
+    {
+        checksum = (checksum ^ lane) * prime;
+    }
+
+    return checksum;
+}
+
+// mmap memory which grows with mremap, so the cache can be built without standard containers
+class GrowableBuffer
+{
+public:
+    unsigned char* data = nullptr;
+    size_t size = 0;
+
+    GrowableBuffer() = default;
+    GrowableBuffer(const GrowableBuffer&) = delete;
+    GrowableBuffer& operator=(GrowableBuffer other) = delete;
+    GrowableBuffer(GrowableBuffer&&) = delete;
+    GrowableBuffer& operator=(GrowableBuffer&&) = delete;
+
+    ~GrowableBuffer()
+    {
+        if (data != nullptr)
+        {
+            munmap(data, _capacity);
+            data = nullptr;
+        }
+    }
+
+    bool reserve(const size_t newCapacity)
+    {
+        if (newCapacity <= _capacity)
+        {
+            return true;
+        }
+
+        size_t capacity = _capacity * 2 > newCapacity ? _capacity * 2 : newCapacity;
+        capacity = ((capacity + 4095) / 4096) * 4096;
+        void* newData = data == nullptr
+            ? mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+            : mremap(data, _capacity, capacity, MREMAP_MAYMOVE);
+
+        if (newData == MAP_FAILED)
+        {
+            printCstr("ERROR: GrowableBuffer couldn't grow to "); printInt(capacity); printCstr(" bytes: "); printInt(errno); printCstr("\n");
+            return false;
+        }
+
+        data = (unsigned char*)newData;
+        _capacity = capacity;
+
+        return true;
+    }
+
+    bool append(const void* bytes, const size_t byteCount)
+    {
+        if (!reserve(size + byteCount))
+        {
+            return false;
+        }
+
+        memcpy(data + size, bytes, byteCount);
+        size += byteCount;
+
+        return true;
+    }
+
+    bool appendZeros(const size_t byteCount)
+    {
+        if (!reserve(size + byteCount))
+        {
+            return false;
+        }
+
+        memset(data + size, 0, byteCount);
+        size += byteCount;
+
+        return true;
+    }
+
+    bool alignTo(const size_t alignment)
+    {
+        return appendZeros((alignment - (size % alignment)) % alignment);
+    }
+
+    // the caller has to munmap the returned pointer with mappingSize
+    unsigned char* release(size_t& mappingSize)
+    {
+        unsigned char* releasedData = data;
+        mappingSize = _capacity;
+        data = nullptr;
+        size = 0;
+        _capacity = 0;
+
+        return releasedData;
+    }
+
+private:
+    size_t _capacity = 0;
+};
+
+struct ParsedDelayEntry
+{
+    uint32_t keyOffset;
+    uint32_t keyLength;
+    uint32_t delaysIndex;
+};
+
+static bool isDelayLineWhitespace(const char ch)
+{
+    return ch == ' ' || ch == '\f' || ch == '\r' || ch == '\t' || ch == '\v';
+}
+
+// adds a delay for each number between slashes, or -1 if there's a dash. the -2 at the end is added in parseDelayLine when there isn't a dash.
+// characters other than digits, slashes, and dashes are ignored, and an empty part between slashes is a delay of 0
+// returns false if a delay is larger than INT_MAX
+static bool parseDelays(const char* text, const size_t textSize, GrowableBuffer& delays, bool& memoryError)
+{
+    int32_t delay = 0;
+    bool digitsFound = false;
+
+    for (size_t i = 0; i < textSize; i++)
+    {
+        char ch = text[i];
+
+        if (ch >= '0' && ch <= '9')
+        {
+            if (delay > (INT_MAX - (ch - '0')) / 10)
+            {
+                return false;
+            }
+
+            delay = (delay * 10) + (ch - '0');
+            digitsFound = true;
+        }
+        else if (ch == '-')
+        {
+            delay = -1;
+            memoryError |= !delays.append(&delay, sizeof(delay));
+
+            return true;
+        }
+        else if (ch == '/')
+        {
+            memoryError |= !delays.append(&delay, sizeof(delay));
+            delay = 0;
+            digitsFound = false;
+        }
+    }
+
+    if (digitsFound)
+    {
+        memoryError |= !delays.append(&delay, sizeof(delay));
+    }
+
+    return true;
+}
+
+// a line is: file name / delay / delay / ...
+// whitespace around the file name is ignored unless the line starts with a slash
+static bool parseDelayLine(const char* line, size_t lineSize, GrowableBuffer& keys, GrowableBuffer& delays, GrowableBuffer& entries, bool& memoryError)
+{
+    bool stripWhitespace = false;
+
+    if (lineSize > 0 && line[0] == '/')
+    {
+        stripWhitespace = true;
+        line++;
+        lineSize--;
+    }
+    else
+    {
+        // don't include starting whitespace
+        for (; lineSize > 0 && isDelayLineWhitespace(line[0]); line++, lineSize--);
+    }
+
+    const char* slash = (const char*)memchr(line, '/', lineSize);
+    if (slash == nullptr) // line ended abruptly
+    {
+        return true;
+    }
+
+    size_t keyLength = (size_t)(slash - line);
+
+    // don't include ending whitespace
+    if (!stripWhitespace)
+    {
+        for (; keyLength > 0 && isDelayLineWhitespace(line[keyLength - 1]); keyLength--);
+    }
+
+    size_t delaysStart = delays.size;
+    if (!parseDelays(slash + 1, (size_t)(line + lineSize - (slash + 1)), delays, memoryError))
+    {
+        return false;
+    }
+
+    if (keyLength == 0 || delays.size == delaysStart)
+    {
+        delays.size = delaysStart;
+        return true;
+    }
+
+    int32_t lastDelay = 0;
+    memcpy(&lastDelay, delays.data + delays.size - sizeof(lastDelay), sizeof(lastDelay));
+    if (lastDelay != -1)
+    {
+        int32_t noReset = -2;
+        memoryError |= !delays.append(&noReset, sizeof(noReset));
+    }
+
+    ParsedDelayEntry entry{(uint32_t)keys.size, (uint32_t)keyLength, (uint32_t)(delaysStart / sizeof(int32_t))};
+    memoryError |= !keys.append(line, keyLength);
+    memoryError |= !entries.append(&entry, sizeof(entry));
+
+    return true;
+}
+
+[[maybe_unused]] static FlatDelaySlot* findFlatDelaySlot(unsigned char* table, const std::string_view key)
+{
+    const FlatDelayTableHeader* header = (const FlatDelayTableHeader*)table;
+    FlatDelaySlot* slots = (FlatDelaySlot*)(table + sizeof(FlatDelayTableHeader));
+    uint32_t mask = header->slotCount - 1;
+    uint64_t hash = fnv1a64((const unsigned char*)key.data(), key.size());
+
+    // there's always an empty slot, so this stops
+    for (uint32_t slotIdx = (uint32_t)hash & mask; slots[slotIdx].keyLength != 0; slotIdx = (slotIdx + 1) & mask)
+    {
+        const FlatDelaySlot& slot = slots[slotIdx];
+        if (slot.hash == hash && slot.keyLength == key.size() && memcmp(table + header->keysOffset + slot.keyOffset, key.data(), key.size()) == 0)
+        {
+            return &slots[slotIdx];
+        }
+    }
+
+    return nullptr;
+}
+
+// Parses files_and_delays.txt into a flat delay table appended to table. When a file is listed more than once, the first line is used.
+// Returns false if there wasn't enough memory. A file which can't be read or has a delay that's too large gives an empty table.
+static bool buildFlatDelayTable(GrowableBuffer& table, const char* filename, const bool copyFile)
+{
+    GrowableBuffer keys;
+    GrowableBuffer delays;
+    GrowableBuffer entries;
+    bool memoryError = false;
+
+    {
+        MappedFileLines lines(filename, copyFile);
+        const char* line = nullptr;
+        size_t lineSize = 0;
+
+        while (lines.opened && lines.nextLine(line, lineSize) && !memoryError)
+        {
+            if (!parseDelayLine(line, lineSize, keys, delays, entries, memoryError))
+            {
+                printCstr("delays can't be larger than INT_MAX\nfiles can't be load extended\n");
+                entries.size = 0; // empty table so failure is more obvious
+                break;
+            }
+        }
+    }
+
+    size_t entryCount = entries.size / sizeof(ParsedDelayEntry);
+    // at most 2/3 full so probes stay short, and there's always an empty slot
+    uint32_t slotCount = 1;
+    while (slotCount < entryCount + (entryCount / 2) + 1 && slotCount < 0x80000000)
+    {
+        slotCount *= 2;
+    }
+
+    size_t delaysOffset = sizeof(FlatDelayTableHeader) + ((size_t)slotCount * sizeof(FlatDelaySlot));
+    size_t keysOffset = delaysOffset + delays.size;
+    size_t tableSize = ((keysOffset + keys.size + 7) / 8) * 8;
+    size_t tableStart = table.size;
+
+    if (memoryError || entryCount >= 0x40000000 || tableSize > UINT32_MAX || !table.appendZeros(tableSize))
+    {
+        printCstr("ERROR: not enough memory for the delays in "); printCstr(filename); printCstr("\n");
+        return false;
+    }
+
+    unsigned char* tableData = table.data + tableStart;
+    FlatDelayTableHeader header{slotCount, 0, (uint32_t)delaysOffset, (uint32_t)keysOffset, (uint32_t)tableSize, 0};
+    if (delays.size != 0)
+    {
+        memcpy(tableData + delaysOffset, delays.data, delays.size);
+    }
+    if (keys.size != 0)
+    {
+        memcpy(tableData + keysOffset, keys.data, keys.size);
+    }
+
+    FlatDelaySlot* slots = (FlatDelaySlot*)(tableData + sizeof(FlatDelayTableHeader));
+    for (size_t entryIdx = 0; entryIdx < entryCount; entryIdx++)
+    {
+        ParsedDelayEntry entry{};
+        memcpy(&entry, entries.data + (entryIdx * sizeof(entry)), sizeof(entry));
+        const unsigned char* key = keys.data + entry.keyOffset;
+        uint64_t hash = fnv1a64(key, entry.keyLength);
+        uint32_t slotIdx = (uint32_t)hash & (slotCount - 1);
+        bool duplicate = false;
+
+        for (; slots[slotIdx].keyLength != 0; slotIdx = (slotIdx + 1) & (slotCount - 1))
+        {
+            if (slots[slotIdx].hash == hash && slots[slotIdx].keyLength == entry.keyLength && memcmp(keys.data + slots[slotIdx].keyOffset, key, entry.keyLength) == 0)
+            {
+                duplicate = true;
+                break;
+            }
+        }
+
+        if (!duplicate)
+        {
+            slots[slotIdx].hash = hash;
+            slots[slotIdx].keyOffset = entry.keyOffset;
+            slots[slotIdx].keyLength = entry.keyLength;
+            slots[slotIdx].delaysIndex = entry.delaysIndex;
+            header.fileCount++;
+        }
+    }
+
+    memcpy(tableData, &header, sizeof(header));
+
+    return true;
+}
+
+// Keeps amnesia_config_cache.bin mapped. It's used instead of the text files when none of them have changed since it was made.
+// There's no constructor or destructor because this is used by the __attribute__((constructor)) function, which can run before
+// static objects are constructed. unload is called from freeResources in amnesia_tool.cpp.
+class ConfigCache
+{
+public:
+    bool loaded() const
+    {
+        return _cache != nullptr;
+    }
+
+    const ConfigCacheHeader& header() const
+    {
+        return *(const ConfigCacheHeader*)_cache;
+    }
+
+    // nullptr if the cache isn't loaded
+    unsigned char* delayTable() const
+    {
+        return _cache != nullptr ? _cache + header().delayTableOffset : nullptr;
+    }
+
+    const unsigned char* nameTable() const
+    {
+        return _cache != nullptr ? _cache + header().nameTableOffset : nullptr;
+    }
+
+    static void readSourceStamps(ConfigCacheSourceStamp* stamps)
+    {
+        for (size_t sourceIdx = 0; sourceIdx < configCacheSourceCount; sourceIdx++)
+        {
+            struct stat fileStatus{};
+            if (stat(configCacheSourceNames[sourceIdx], &fileStatus) == -1)
+            {
+                stamps[sourceIdx] = ConfigCacheSourceStamp{0, 0, UINT64_MAX};
+            }
+            else
+            {
+                stamps[sourceIdx] = ConfigCacheSourceStamp{fileStatus.st_mtim.tv_sec, fileStatus.st_mtim.tv_nsec, (uint64_t)fileStatus.st_size};
+            }
+        }
+    }
+
+    // returns true if the cache could be loaded and was made from the text files which have the given stamps
+    bool load(const ConfigCacheSourceStamp* stamps)
+    {
+        int fd = open(configCacheFileName, O_RDONLY | O_CLOEXEC); // make sure this gets closed
+        if (fd == -1) // the cache gets made the first time the tool runs
+        {
+            return false;
+        }
+
+        struct stat fileStatus{};
+        if (fstat(fd, &fileStatus) == -1 || (size_t)fileStatus.st_size < sizeof(ConfigCacheHeader))
+        {
+            close(fd);
+            return false;
+        }
+
+        size_t size = (size_t)fileStatus.st_size;
+        // populated because every page is read for the checksum anyway
+        void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        close(fd); // file closed here, the mapping keeps the file open
+        if (mapping == MAP_FAILED)
+        {
+            printCstr("WARNING: couldn't map "); printCstr(configCacheFileName); printCstr(": "); printInt(errno); printCstr("\n");
+            return false;
+        }
+
+        _cache = (unsigned char*)mapping;
+        _mappingSize = size;
+
+        const ConfigCacheHeader& cacheHeader = header();
+        if (!isValid(size))
+        {
+            printCstr("WARNING: "); printCstr(configCacheFileName); printCstr(" is damaged or from another version, it will be rebuilt\n");
+            unload();
+            return false;
+        }
+
+        if (memcmp(cacheHeader.sources, stamps, sizeof(cacheHeader.sources)) != 0) // a text file was changed
+        {
+            unload();
+            return false;
+        }
+
+        return true;
+    }
+
+    // Makes a new cache from the settings, files_and_delays.txt, and the flashback line names. The names are read from spacePerName sized string objects
+    // which start with their length. The cache is written to amnesia_config_cache.bin and loaded even if it can't be written.
+    bool rebuild(const uint32_t settingsFlags, const uint64_t pageCacheBudgetMegabytes, const ConfigCacheSourceStamp* stamps,
+        const unsigned char* names, const size_t spacePerName, const size_t howManyNames, const size_t stringDataSize)
+    {
+        unload();
+
+        GrowableBuffer cache;
+        ConfigCacheHeader cacheHeader{};
+        memcpy(cacheHeader.magic, configCacheMagic, sizeof(configCacheMagic));
+        cacheHeader.version = configCacheVersion;
+        memcpy(cacheHeader.sources, stamps, sizeof(cacheHeader.sources));
+        cacheHeader.pageCacheBudgetMegabytes = pageCacheBudgetMegabytes;
+        cacheHeader.settingsFlags = settingsFlags;
+
+        if (!cache.appendZeros(sizeof(cacheHeader)))
+        {
+            return false;
+        }
+
+        cacheHeader.delayTableOffset = (uint32_t)cache.size;
+        if (!buildFlatDelayTable(cache, delaysFileName, true))
+        {
+            return false;
+        }
+        cacheHeader.delayTableSize = (uint32_t)(cache.size - cacheHeader.delayTableOffset);
+
+        cacheHeader.nameTableOffset = (uint32_t)cache.size;
+        FlatNameTableHeader nameTableHeader{(uint32_t)howManyNames, 0};
+        bool appended = cache.append(&nameTableHeader, sizeof(nameTableHeader));
+        for (size_t nameIdx = 0; nameIdx < howManyNames && appended; nameIdx++)
+        {
+            const unsigned char* slot = names + (nameIdx * spacePerName);
+            size_t nameSize = 0;
+            memcpy(&nameSize, slot, sizeof(nameSize));
+            uint32_t nameLength = (uint32_t)nameSize;
+
+            nameTableHeader.longestName = nameLength > nameTableHeader.longestName ? nameLength : nameTableHeader.longestName;
+            appended = cache.append(&nameLength, sizeof(nameLength)) && cache.append(slot + stringDataSize, nameLength) && cache.alignTo(4);
+        }
+        if (!appended || !cache.alignTo(8) || cache.size > UINT32_MAX)
+        {
+            return false;
+        }
+        memcpy(cache.data + cacheHeader.nameTableOffset, &nameTableHeader, sizeof(nameTableHeader));
+        cacheHeader.nameTableSize = (uint32_t)(cache.size - cacheHeader.nameTableOffset);
+
+        cacheHeader.size = cache.size;
+        memcpy(cache.data, &cacheHeader, sizeof(cacheHeader));
+        cacheHeader.checksum = getConfigCacheChecksum(cache.data + checksummedStart, cache.size - checksummedStart);
+        memcpy(cache.data, &cacheHeader, sizeof(cacheHeader));
+
+        writeCache(cache.data, cache.size);
+
+        _cache = cache.release(_mappingSize);
+
+        return true;
+    }
+
+    void unload()
+    {
+        if (_cache != nullptr)
+        {
+            munmap(_cache, _mappingSize);
+            _cache = nullptr;
+            _mappingSize = 0;
+        }
+    }
+
+private:
+    static const size_t checksummedStart = offsetof(ConfigCacheHeader, checksum) + sizeof(uint64_t);
+
+    unsigned char* _cache = nullptr;
+    size_t _mappingSize = 0;
+
+    bool isValid(const size_t size) const
+    {
+        const ConfigCacheHeader& cacheHeader = header();
+        if (
+            memcmp(cacheHeader.magic, configCacheMagic, sizeof(configCacheMagic)) != 0
+            || cacheHeader.version != configCacheVersion
+            || cacheHeader.size != size
+            || cacheHeader.checksum != getConfigCacheChecksum(_cache + checksummedStart, size - checksummedStart)
+            || cacheHeader.delayTableOffset % 8 != 0
+            || cacheHeader.delayTableSize < sizeof(FlatDelayTableHeader)
+            || cacheHeader.delayTableOffset + (uint64_t)cacheHeader.delayTableSize > size
+            || cacheHeader.nameTableSize < sizeof(FlatNameTableHeader)
+            || cacheHeader.nameTableOffset + (uint64_t)cacheHeader.nameTableSize > size)
+        {
+            return false;
+        }
+
+        // the tables were checked when the cache was made and the checksum matched, so only the parts needed to stay in bounds are checked here
+        const FlatDelayTableHeader* delayTableHeader = (const FlatDelayTableHeader*)(_cache + cacheHeader.delayTableOffset);
+        return delayTableHeader->slotCount != 0
+            && (delayTableHeader->slotCount & (delayTableHeader->slotCount - 1)) == 0
+            && delayTableHeader->fileCount < delayTableHeader->slotCount
+            && delayTableHeader->size == cacheHeader.delayTableSize
+            && sizeof(FlatDelayTableHeader) + ((uint64_t)delayTableHeader->slotCount * sizeof(FlatDelaySlot)) <= delayTableHeader->delaysOffset
+            && delayTableHeader->delaysOffset <= delayTableHeader->keysOffset
+            && delayTableHeader->keysOffset <= delayTableHeader->size;
+    }
+
+    // the cache is written to a temporary file first so a crash can't leave a half written cache behind
+    static void writeCache(const unsigned char* cache, const size_t size)
+    {
+        int fd = open(configCacheTempFileName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644); // make sure this gets closed
+        if (fd == -1)
+        {
+            printCstr("WARNING: couldn't open "); printCstr(configCacheTempFileName);
+            printCstr(": "); printInt(errno); printCstr("\n");
+            return;
+        }
+
+        size_t totalWritten = 0;
+        while (totalWritten < size)
+        {
+            ssize_t bytesWritten = write(fd, cache + totalWritten, size - totalWritten);
+            if (bytesWritten == -1)
+            {
+                printCstr("WARNING: couldn't write "); printCstr(configCacheTempFileName);
+                printCstr(": "); printInt(errno); printCstr("\n");
+                close(fd);
+                unlink(configCacheTempFileName);
+                return;
+            }
+            totalWritten += (size_t)bytesWritten;
+        }
+        close(fd); // file closed here
+
+        if (rename(configCacheTempFileName, configCacheFileName) == -1)
+        {
+            printCstr("WARNING: couldn't replace "); printCstr(configCacheFileName);
+            printCstr(": "); printInt(errno); printCstr("\n");
+        }
+    }
+};
+
+static ConfigCache configCache;
@@ -0,0 +1,387 @@
+
+// Times the files_and_delays.txt and flashback_names.txt parsers against the getCharacter parsers they replaced,
+// and loading amnesia_config_cache.bin, using large generated files. It checks all of them give the same delays.
+// usage: config_parser_benchmark.exe [lines, default 20000] [runs, default 20]
+
+#include <sys/mman.h>
+#include <cstring>
+#include <errno.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <charconv>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "non_std_functions.h"
+#include "fnv1a_hash.h"
+#include "config_cache.h"
+#include "tool_counters.h"
+#include "map_prefetcher.h"
+#include "page_cache_warmer.h"
+#include "mmap_file_streams.h"
+#include "load_history.h"
+#include "file_open_trace.h"
+#include "load_extender.h"
+
+static const char flashbackNamesFileName[] = "flashback_names.txt";
+
+// the delay map from before the flat delay table
+struct MapValue
+{
+    std::unique_ptr<int[]> delays;
+
+    explicit MapValue(std::vector<int>& delaysVector) : delays(std::make_unique<int[]>(delaysVector.size()))
+    {
+        memcpy(delays.get(), delaysVector.data(), delaysVector.size() * sizeof(int));
+    }
+};
+
+struct KeyCmp
+{
+    using is_transparent = void;
+
+    bool operator()(const std::unique_ptr<char[]>& cstr1, const std::unique_ptr<char[]>& cstr2) const
+    {
+        return strcmp(cstr1.get(), cstr2.get()) == 0;
+    }
+};
+
+struct KeyHash
+{
+    size_t operator()(const std::unique_ptr<char[]>& cstr) const
+    {
+        return std::hash<std::string_view>()(std::string_view(cstr.get()));
+    }
+};
+
+using myMapType = std::unordered_map<std::unique_ptr<char[]>, MapValue, KeyHash, KeyCmp>;
+
+// the files_and_delays.txt parser from before MappedFileLines, kept here to compare against
+class GetCharacterDelayTable
+{
+public:
+    myMapType fileMap;
+
+    GetCharacterDelayTable()
+    {
+        std::vector<char> intAsChars;
+        intAsChars.reserve(10);
+        intAsChars.push_back('0'); // empty vector causes std::errc::invalid_argument
+        std::vector<char> keyVector;
+        std::vector<int> delaysVector;
+
+        FileHelper fhelper(delaysFileName);
+        if (fhelper.fd == -1)
+        {
+            return;
+        }
+
+        while (addMapPair(keyVector, delaysVector, fhelper, intAsChars));
+    }
+
+private:
+    static bool isLineWhitespace(const char ch)
+    {
+        return ch == ' ' || ch == '\f' || ch == '\r' || ch == '\t' || ch == '\v';
+    }
+
+    bool addMapPair(std::vector<char>& keyVector, std::vector<int>& delaysVector, FileHelper& fhelper, std::vector<char>& intAsChars)
+    {
+        keyVector.clear();
+        delaysVector.clear();
+        char ch = '\0';
+        bool stripWhitespace = false;
+        bool textRemaining = fhelper.getCharacter(ch);
+
+        if (ch == '/')
+        {
+            stripWhitespace = true;
+            textRemaining = fhelper.getCharacter(ch);
+        }
+        else if (isLineWhitespace(ch))
+        {
+            for (textRemaining = fhelper.getCharacter(ch); textRemaining && isLineWhitespace(ch); textRemaining = fhelper.getCharacter(ch));
+        }
+
+        while (ch != '\n' && ch != '/' && textRemaining)
+        {
+            keyVector.push_back(ch);
+            textRemaining = fhelper.getCharacter(ch);
+        }
+
+        if (!stripWhitespace)
+        {
+            while (!keyVector.empty() && isLineWhitespace(keyVector.back()))
+            {
+                keyVector.pop_back();
+            }
+        }
+
+        if (textRemaining && ch == '/')
+        {
+            fillDelaysVector(textRemaining, delaysVector, fhelper, intAsChars);
+
+            if (!keyVector.empty() && !delaysVector.empty())
+            {
+                if (delaysVector.back() != -1)
+                {
+                    delaysVector.push_back(-2);
+                }
+
+                keyVector.push_back('\0');
+                std::unique_ptr<char[]> keyPtr = std::make_unique<char[]>(keyVector.size());
+                memcpy(keyPtr.get(), keyVector.data(), keyVector.size() * sizeof(char));
+                fileMap.emplace(std::piecewise_construct, std::forward_as_tuple(std::move(keyPtr)), std::forward_as_tuple(delaysVector));
+            }
+        }
+
+        return textRemaining;
+    }
+
+    void fillDelaysVector(bool& textRemaining, std::vector<int>& delaysVector, FileHelper& fhelper, std::vector<char>& intAsChars)
+    {
+        char ch = '\0';
+        int delay = 0;
+
+        for (textRemaining = fhelper.getCharacter(ch); ch != '\n' && textRemaining; textRemaining = fhelper.getCharacter(ch))
+        {
+            if (ch >= '0' && ch <= '9')
+            {
+                intAsChars.push_back((char)ch);
+            }
+            else if (ch == '-')
+            {
+                delaysVector.push_back(-1);
+                break;
+            }
+            else if (ch == '/')
+            {
+                std::from_chars(intAsChars.data(), intAsChars.data() + intAsChars.size(), delay);
+                delaysVector.push_back(delay);
+                intAsChars.clear();
+                intAsChars.push_back('0');
+            }
+        }
+
+        if ((delaysVector.empty() || delaysVector.back() != -1) && intAsChars.size() > 1)
+        {
+            std::from_chars(intAsChars.data(), intAsChars.data() + intAsChars.size(), delay);
+            delaysVector.push_back(delay);
+        }
+
+        intAsChars.clear();
+        intAsChars.push_back('0');
+
+        for (; ch != '\n' && textRemaining; textRemaining = fhelper.getCharacter(ch));
+    }
+};
+
+// the first pass amnesia_tool.cpp makes over flashback_names.txt, with each way of reading the file
+static size_t countNamesWithGetCharacter(size_t& longestName)
+{
+    FileHelper fh(flashbackNamesFileName);
+    size_t howManyNames = 0;
+    size_t currentNameLength = 0;
+    char ch = '\0';
+
+    while (fh.getCharacter(ch))
+    {
+        if (ch == '\r')
+        {
+            continue;
+        }
+        else if (ch == '\n')
+        {
+            longestName = currentNameLength > longestName ? currentNameLength : longestName;
+            howManyNames += currentNameLength > 0;
+            currentNameLength = 0;
+        }
+        else
+        {
+            currentNameLength++;
+        }
+    }
+    longestName = currentNameLength > longestName ? currentNameLength : longestName;
+    howManyNames += currentNameLength > 0;
+
+    return howManyNames;
+}
+
+static size_t countNamesWithMappedFileLines(size_t& longestName)
+{
+    MappedFileLines lines(flashbackNamesFileName);
+    size_t howManyNames = 0;
+    const char* line = nullptr;
+    size_t lineSize = 0;
+
+    while (lines.nextLine(line, lineSize))
+    {
+        if (lineSize > 0 && line[lineSize - 1] == '\r')
+        {
+            lineSize--;
+        }
+        longestName = lineSize > longestName ? lineSize : longestName;
+        howManyNames += lineSize > 0;
+    }
+
+    return howManyNames;
+}
+
+static bool writeFile(const char* filename, const std::string& text)
+{
+    FILE* f = fopen(filename, "wb");
+    if (f == nullptr)
+    {
+        printf("couldn't open %s: %d\n", filename, errno);
+        return false;
+    }
+
+    bool success = fwrite(text.data(), 1, text.size(), f) == text.size();
+    fclose(f);
+
+    return success;
+}
+
+// the same kinds of lines as the real files, including the unusual ones the parsers have to handle
+static bool generateFiles(const size_t lineCount)
+{
+    std::string delaysText;
+    std::string namesText;
+    srand(1);
+
+    for (size_t i = 0; i < lineCount; i++)
+    {
+        std::string name = "generated_map_" + std::to_string(i) + ".hps";
+
+        switch (i % 6)
+        {
+            case 0: delaysText += name + " / " + std::to_string(rand() % 5000) + " / -\n"; break;
+            case 1: delaysText += "  " + name + "\t/ 1000 / 2500 / 400\r\n"; break;
+            case 2: delaysText += "/" + name + " /" + std::to_string(rand()) + "/ / 7\n"; break;
+            case 3: delaysText += name + " / -\n"; break;
+            case 4: delaysText += name + " has no delays\n\n"; break;
+            case 5: delaysText += name + " / 12 34 / 5"; delaysText += (i + 1 == lineCount ? "" : "\n"); break;
+        }
+
+        namesText += "CH0" + std::to_string(i % 10) + "L" + std::to_string(i) + "_Flashback_" + std::string(i % 40, 'x') + (i % 2 ? "\r\n" : "\n");
+    }
+
+    return writeFile(delaysFileName, delaysText) && writeFile(flashbackNamesFileName, namesText);
+}
+
+static bool sameDelays(const myMapType& oldMap, const DelayTable& newTable)
+{
+    if (oldMap.size() != newTable.fileCount())
+    {
+        return false;
+    }
+
+    for (const auto& [key, value] : oldMap)
+    {
+        const int32_t* delays = newTable.findDelays(std::string_view(key.get()));
+        if (delays == nullptr)
+        {
+            return false;
+        }
+
+        for (size_t i = 0; ; i++)
+        {
+            if (value.delays[i] != delays[i])
+            {
+                return false;
+            }
+            if (value.delays[i] < 0)
+            {
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+template <typename F>
+static double bestMicroseconds(const size_t runs, F function)
+{
+    double best = 1e300;
+    for (size_t i = 0; i < runs; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        best = elapsed.count() < best ? elapsed.count() : best;
+    }
+
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    size_t lineCount = argc > 1 ? strtoull(argv[1], nullptr, 10) : 20000;
+    size_t runs = argc > 2 ? strtoull(argv[2], nullptr, 10) : 20;
+    if (lineCount == 0 || runs == 0)
+    {
+        printf("usage: %s [lines] [runs]\n", argv[0]);
+        return 1;
+    }
+
+    char directory[] = "/tmp/config_parser_benchmark_XXXXXX";
+    if (mkdtemp(directory) == nullptr || chdir(directory) == -1)
+    {
+        printf("couldn't make a directory for the generated files: %d\n", errno);
+        return 1;
+    }
+
+    bool success = generateFiles(lineCount);
+    ConfigCacheSourceStamp stamps[configCacheSourceCount];
+    ConfigCache::readSourceStamps(stamps);
+    success = success && configCache.rebuild(0, 0, stamps, nullptr, 0, 0, 0);
+
+    if (success)
+    {
+        GetCharacterDelayTable oldTable;
+        DelayTable newTable;
+        DelayTable cachedTable(configCache.delayTable());
+        size_t oldLongest = 0;
+        size_t newLongest = 0;
+        size_t oldNames = countNamesWithGetCharacter(oldLongest);
+        size_t newNames = countNamesWithMappedFileLines(newLongest);
+
+        if (!sameDelays(oldTable.fileMap, newTable) || !sameDelays(oldTable.fileMap, cachedTable) || oldNames != newNames || oldLongest != newLongest)
+        {
+            printf("the parsers disagree: %zu, %zu, and %zu files with delays, %zu and %zu flashback names\n",
+                oldTable.fileMap.size(), newTable.fileCount(), cachedTable.fileCount(), oldNames, newNames);
+            success = false;
+        }
+        else
+        {
+            printf("%zu lines, %zu files with delays, %zu flashback names, best of %zu runs\n", lineCount, newTable.fileCount(), newNames, runs);
+
+            double oldDelays = bestMicroseconds(runs, [] { GetCharacterDelayTable table; });
+            double newDelays = bestMicroseconds(runs, [] { DelayTable table; });
+            printf("files_and_delays.txt: getCharacter %.0f us, flat delay table %.0f us, %.2fx\n", oldDelays, newDelays, oldDelays / newDelays);
+
+            double oldFlashbacks = bestMicroseconds(runs, [] { size_t longest = 0; countNamesWithGetCharacter(longest); });
+            double newFlashbacks = bestMicroseconds(runs, [] { size_t longest = 0; countNamesWithMappedFileLines(longest); });
+            printf("flashback_names.txt: getCharacter %.0f us, MappedFileLines %.0f us, %.2fx\n", oldFlashbacks, newFlashbacks, oldFlashbacks / newFlashbacks);
+
+            // loading includes checking the checksum, the delay table in the cache is used without being parsed or copied
+            double cacheLoad = bestMicroseconds(runs, [&stamps] { configCache.unload(); configCache.load(stamps); });
+            printf("%s: load %.0f us, %.2fx faster than parsing files_and_delays.txt\n", configCacheFileName, cacheLoad, newDelays / cacheLoad);
+            success = configCache.loaded();
+        }
+    }
+
+    configCache.unload();
+    unlink(configCacheFileName);
+    unlink(delaysFileName);
+    unlink(flashbackNamesFileName);
+    chdir("/");
+    rmdir(directory);
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,307 @@
+
+// Replays the traces the tool writes to file_open_traces when "record file opens" is on. Every traced open is given to a new delay
+// table made from files_and_delays.txt (or the file after --delays), in the trace's order, with a virtual clock instead of sleeping,
+// and the delay it gets is compared to the delay the tool gave it when the trace was recorded. So changes to the delay rules
+// (the restarting -1 at the end, the -2 which doesn't restart, and a -1 at the start resetting every file) can be checked against
+// real sessions without playing the game. It exits with 1 if any delay is different.
+// The delay table is the one from load_extender.h, compiled in like in config_parser_benchmark. The virtual clock is the traced
+// time plus how much longer the replayed delays were than the recorded ones so far, which is right for opens from one thread.
+// With --repeat, every trace is replayed that many more times with a new table each time, to time the delay table.
+// usage: delay_trace_replayer.exe [--delays delays file] [--all] [--repeat count] [traces or folders of them, default file_open_traces]
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <cstring>
+#include <errno.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <charconv>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "non_std_functions.h"
+#include "fnv1a_hash.h"
+#include "config_cache.h"
+#include "tool_counters.h"
+#include "map_prefetcher.h"
+#include "page_cache_warmer.h"
+#include "mmap_file_streams.h"
+#include "load_history.h"
+#include "file_open_trace.h"
+#include "load_extender.h"
+
+struct TracedOpen
+{
+    int64_t nanoseconds = 0;
+    unsigned char timerByte = 0;
+    bool delayRecorded = false; // false if delays were off when the trace was recorded
+    int recordedDelay = -1;
+    std::string path;
+    size_t filenameIndex = 0; // where the filename starts in path, like in sharedPathCheckingFunction
+};
+
+struct Trace
+{
+    std::string name;
+    std::vector<TracedOpen> opens;
+};
+
+struct ReplayTotals
+{
+    size_t traces = 0;
+    size_t opens = 0;
+    size_t delayedOpens = 0;
+    size_t mismatches = 0;
+};
+
+static bool parseTracedOpen(const char* line, const size_t lineSize, TracedOpen& open)
+{
+    const char* end = line + lineSize;
+    int timerByte = 0;
+
+    auto result = std::from_chars(line, end, open.nanoseconds);
+    if (result.ec != std::errc() || result.ptr == end || *result.ptr != ' ')
+    {
+        return false;
+    }
+    result = std::from_chars(result.ptr + 1, end, timerByte);
+    if (result.ec != std::errc() || result.ptr == end || *result.ptr != ' ' || timerByte < 0 || timerByte > 255)
+    {
+        return false;
+    }
+    open.timerByte = (unsigned char)timerByte;
+
+    const char* delayStart = result.ptr + 1;
+    if (delayStart < end && *delayStart == '-' && delayStart + 1 < end && delayStart[1] == ' ')
+    {
+        open.delayRecorded = false;
+        result.ptr = delayStart + 1;
+    }
+    else
+    {
+        result = std::from_chars(delayStart, end, open.recordedDelay);
+        if (result.ec != std::errc() || result.ptr == end || *result.ptr != ' ')
+        {
+            return false;
+        }
+        open.delayRecorded = true;
+    }
+
+    open.path.assign(result.ptr + 1, (size_t)(end - (result.ptr + 1)));
+    size_t slash = open.path.rfind('/');
+    open.filenameIndex = slash == std::string::npos ? 0 : slash + 1;
+    return true;
+}
+
+static bool readTrace(const std::string& path, Trace& trace)
+{
+    MappedFileLines lines(path.c_str());
+    if (!lines.opened)
+    {
+        return false;
+    }
+
+    trace.name = path;
+    const char* line = nullptr;
+    size_t lineSize = 0;
+    size_t lineNumber = 0;
+    while (lines.nextLine(line, lineSize))
+    {
+        lineNumber++;
+        if (lineSize == 0 || line[0] == '#')
+        {
+            continue;
+        }
+
+        TracedOpen open;
+        if (!parseTracedOpen(line, lineSize, open))
+        {
+            printf("%s line %zu isn't a traced open\n", path.c_str(), lineNumber);
+            return false;
+        }
+        trace.opens.push_back(std::move(open));
+    }
+
+    return true;
+}
+
+static void readPath(const std::string& path, std::vector<Trace>& traces)
+{
+    struct stat pathStatus{};
+    if (stat(path.c_str(), &pathStatus) == -1)
+    {
+        printf("couldn't find %s: %d\n", path.c_str(), errno);
+        return;
+    }
+    if (!S_ISDIR(pathStatus.st_mode))
+    {
+        Trace trace;
+        if (readTrace(path, trace))
+        {
+            traces.push_back(std::move(trace));
+        }
+        return;
+    }
+
+    DIR* directory = opendir(path.c_str()); // make sure this gets closed
+    if (directory == nullptr)
+    {
+        printf("couldn't open %s: %d\n", path.c_str(), errno);
+        return;
+    }
+    std::vector<std::string> entries;
+    while (struct dirent* entry = readdir(directory))
+    {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.substr(name.size() - 4) == ".txt")
+        {
+            entries.push_back(path + "/" + name);
+        }
+    }
+    closedir(directory); // directory closed here
+
+    std::sort(entries.begin(), entries.end());
+    for (const std::string& entry : entries)
+    {
+        readPath(entry, traces);
+    }
+}
+
+// gives every open in the trace to a copy of the delay table with all of its delay positions at the start, like when the game starts
+static void replayTrace(const Trace& trace, const GrowableBuffer& sourceTable, GrowableBuffer& workTable, std::vector<int>& delays)
+{
+    memcpy(workTable.data, sourceTable.data, sourceTable.size);
+    DelayTable table(workTable.data);
+
+    delays.resize(trace.opens.size());
+    for (size_t i = 0; i < trace.opens.size(); i++)
+    {
+        const TracedOpen& open = trace.opens[i];
+        delays[i] = table.takeDelay(std::string_view(open.path).substr(open.filenameIndex));
+    }
+}
+
+static void printReplay(const Trace& trace, const std::vector<int>& delays, const bool printAll, ReplayTotals& totals)
+{
+    printf("%s\n%12s %5s %7s %8s  file\n", trace.name.c_str(), "virtual ms", "timer", "delay", "recorded");
+
+    int64_t clockOffsetNanoseconds = 0; // how much later the replay is than the recording
+    int64_t delayMilliseconds = 0;
+    size_t delayedOpens = 0;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < trace.opens.size(); i++)
+    {
+        const TracedOpen& open = trace.opens[i];
+        bool mismatch = open.delayRecorded && open.recordedDelay != delays[i];
+
+        if (printAll || delays[i] >= 0 || mismatch)
+        {
+            char recorded[16] = "-";
+            if (open.delayRecorded)
+            {
+                snprintf(recorded, sizeof(recorded), "%d", open.recordedDelay);
+            }
+            printf("%12.3f %5d %7d %8s  %s%s\n", (double)(open.nanoseconds + clockOffsetNanoseconds) / 1e6, (int)open.timerByte, delays[i],
+                recorded, open.path.c_str() + open.filenameIndex, mismatch ? "  DIFFERENT" : "");
+        }
+
+        int replayedDelay = delays[i] > 0 ? delays[i] : 0;
+        int recordedDelay = open.delayRecorded && open.recordedDelay > 0 ? open.recordedDelay : 0;
+        clockOffsetNanoseconds += (int64_t)(replayedDelay - recordedDelay) * 1000000;
+        delayMilliseconds += replayedDelay;
+        delayedOpens += delays[i] >= 0;
+        mismatches += mismatch;
+    }
+
+    printf("%zu opens, %zu in the delay table, %lld ms of delays, %zu different from the recording\n\n", trace.opens.size(), delayedOpens,
+        (long long)delayMilliseconds, mismatches);
+    totals.traces += 1;
+    totals.opens += trace.opens.size();
+    totals.delayedOpens += delayedOpens;
+    totals.mismatches += mismatches;
+}
+
+int main(int argc, char** argv)
+{
+    const char* delaysFile = delaysFileName;
+    bool printAll = false;
+    size_t repeats = 0;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--delays") == 0 && i + 1 < argc)
+        {
+            delaysFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            repeats = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--all") == 0)
+        {
+            printAll = true;
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty())
+    {
+        paths.push_back(fileOpenTraceFolderName);
+    }
+
+    GrowableBuffer sourceTable;
+    GrowableBuffer workTable;
+    if (!buildFlatDelayTable(sourceTable, delaysFile, true) || !workTable.reserve(sourceTable.size))
+    {
+        return EXIT_FAILURE;
+    }
+    workTable.size = sourceTable.size;
+
+    std::vector<Trace> traces;
+    for (const std::string& path : paths)
+    {
+        readPath(path, traces);
+    }
+    if (traces.empty())
+    {
+        printf("no traces to replay\n");
+        return EXIT_FAILURE;
+    }
+
+    ReplayTotals totals;
+    std::vector<int> delays;
+    for (const Trace& trace : traces)
+    {
+        replayTrace(trace, sourceTable, workTable, delays);
+        printReplay(trace, delays, printAll, totals);
+    }
+    printf("%zu traces, %zu opens, %zu in the delay table, %zu different from the recordings\n", totals.traces, totals.opens,
+        totals.delayedOpens, totals.mismatches);
+
+    if (repeats != 0)
+    {
+        auto start = std::chrono::steady_clock::now();
+        int checksum = 0; // so the replays can't be optimized away
+        for (size_t repeat = 0; repeat < repeats; repeat++)
+        {
+            for (const Trace& trace : traces)
+            {
+                replayTrace(trace, sourceTable, workTable, delays);
+                checksum += delays.empty() ? 0 : delays.back();
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double replays = (double)repeats * (double)traces.size();
+        printf("%zu repeats: %.0f traces per second, %.1f ns per open (%d)\n", repeats, replays / seconds,
+            seconds * 1e9 / ((double)repeats * (double)totals.opens), checksum);
+    }
+
+    return totals.mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,889 @@
+
+// A stand-in for the game executable, for testing and benchmarking the tool without the game.
+// Its code has every instruction byte pattern findInstructions looks for, with the instructions around them laid out the way
+// the tool expects, so the tool injects into it exactly like it injects into the game. A script then calls the functions the
+// tool injected into, in any order, and opens files with stdio so the fopen hooks and file delays run too.
+// It attaches to its own load detection, so every load detection event is checked as soon as the game "loads".
+// Build it with the game's executable name (Amnesia.bin.x86_64 or Amnesia.bin.x86, the commands are in readme.md) and run it
+// with LD_PRELOAD, from a folder with the tool's settings files:
+//     LD_PRELOAD='amnesia_tool_64.so file path' ./Amnesia.bin.x86_64 [script, default fake_game_script.txt]
+//     LD_PRELOAD='amnesia_tool_64.so file path' ./Amnesia.bin.x86_64 --startup [runs, default 20]
+// --startup measures how long it takes from exec to main, which is mostly the tool's constructor when the tool is preloaded.
+// Run it with and without LD_PRELOAD to get the injection time.
+//
+// Script lines (# starts a comment):
+//     menu                  starting to load a save from the menu. the timer should pause
+//     map                   changing maps. the timer should pause and split, and with skip flashbacks every flashback is stopped
+//     load end              the loading screen finishing. the timer should resume
+//     map load end          a map finishing loading. with delay flashbacks this waits while a flashback is playing
+//     play milliseconds     makes IsPlaying return true for this long, like a flashback playing
+//     open path [times]     fopen and fclose the file, and prints how long it took
+//     open64 path [times]
+//     freopen path [times]
+//     frames count milliseconds  swaps buffers count times, this many milliseconds apart, through the tool's swap hooks
+//     sleep milliseconds
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "amnesia_timer.h"
+
+// where the instructions below find things in the game's objects. the offsets are the ones in the instructions the tool copies
+#if __x86_64__
+static const size_t quitMessageObjectOffset = 0xd8;
+static const size_t sceneObjectOffset = 0x28;
+#else
+static const size_t quitMessageObjectOffset = 0x74;
+static const size_t sceneObjectOffset = 0x14;
+#endif
+static const size_t mapHandlerOffset = 0x138;
+static const size_t engineOffset = 0x40;
+static const size_t soundHandlerOffset = 0x48;
+
+struct FakeObject
+{
+    alignas(16) unsigned char bytes[0x200];
+};
+
+struct FakeGameCounts
+{
+    uint32_t quitMessageChecks = 0;
+    uint32_t mapLoads = 0;
+    uint32_t fadeOuts = 0;
+    uint32_t sceneLoads = 0;
+    uint32_t applicationTimeChecks = 0;
+    uint32_t flashbacksStopped = 0;
+    uint32_t isPlayingChecks = 0;
+    uint32_t waits = 0;
+    uint64_t waitedMicroseconds = 0;
+    uint32_t swaps = 0;
+    uint32_t frames[3]{}; // every swap but the first ends a frame, counted by AmnesiaTimerFrameState
+    uint32_t failures = 0;
+};
+
+static FakeObject fakeGame;
+static FakeObject fakeEngine;
+static FakeObject fakeSoundHandler;
+static FakeObject fakeMapHandler;
+static FakeObject fakeLoadingScreen;
+static FakeObject fakeQuitMessageObject;
+static FakeObject fakeMap;
+static FakeObject fakeScene;
+static void* fakeSceneVirtualFunctions[4]{};
+static FakeGameCounts counts;
+static int64_t soundPlayingUntil = 0;
+
+static int64_t monotonicNanoseconds()
+{
+    struct timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+static void setPointer(FakeObject& object, const size_t offset, void* pointer)
+{
+    memcpy(&object.bytes[offset], &pointer, sizeof(pointer));
+}
+
+static void fail(const char* what)
+{
+    printf("FAILED: %s\n", what);
+    counts.failures += 1;
+}
+
+extern "C"
+{
+    // the game's global pointer to the game object, which the tool finds from the rip offset (or address) in the map load instructions
+    void* gpBase = &fakeGame;
+
+    // written in assembly below
+    bool fakeLoadEnd(FakeObject* loadingScreen);
+    void fakeMenuLoad();
+    void fakeChangeMap();
+    void fakeMapLoadEnd(FakeObject* map);
+
+    // called from the assembly below, and from the tool's instructions
+    bool fakeIsQuitMessagePosted(FakeObject* object)
+    {
+        counts.quitMessageChecks += 1;
+        if (object != &fakeQuitMessageObject)
+        {
+            fail("isQuitMessagePosted got the wrong object");
+        }
+        return false;
+    }
+
+    void fakeMenuLoaded(intptr_t firstOffset, intptr_t secondOffset)
+    {
+        // the tool moves these instructions somewhere else and corrects their rsp offsets, so this checks they still point to the same place
+#if __x86_64__
+        if (firstOffset != 0xb8 || secondOffset != 0xf5)
+#else
+        if (firstOffset != -0x1b || secondOffset != -0x30)
+#endif
+        {
+            fail("the menu load instructions didn't get the right addresses");
+        }
+    }
+
+    void fakeLoadMap(FakeObject* mapHandler)
+    {
+        counts.mapLoads += 1;
+        if (mapHandler != &fakeMapHandler)
+        {
+            fail("the map load instructions didn't get the map handler");
+        }
+    }
+
+#if __x86_64__
+    void fakeFadeOut(FakeObject* soundHandler, uintptr_t beforeFadeOutValue)
+    {
+        bool beforeFadeOutRan = beforeFadeOutValue == 3;
+#else
+    void fakeFadeOut(FakeObject* soundHandler, uint32_t first, uint32_t second, uint32_t third)
+    {
+        bool beforeFadeOutRan = first == 3 && second == 2 && third == 1;
+#endif
+        counts.fadeOuts += 1;
+        if (soundHandler != &fakeSoundHandler)
+        {
+            fail("the fade out instructions didn't get the sound handler");
+        }
+        if (!beforeFadeOutRan)
+        {
+            fail("the instructions before the fade out didn't all run");
+        }
+    }
+
+    void fakeSceneLoaded(FakeObject* scene)
+    {
+        counts.sceneLoads += 1;
+        if (scene != &fakeScene)
+        {
+            fail("the map load end instructions didn't get the scene");
+        }
+    }
+
+    double fakeGetApplicationTime()
+    {
+        counts.applicationTimeChecks += 1;
+        return (double)monotonicNanoseconds() / 1000000000.0;
+    }
+
+    // the flashback names are in the tool's string objects, which start with a pointer to the characters
+    void fakeStopImplementation(FakeObject* soundHandler, const char** name)
+    {
+        counts.flashbacksStopped += 1;
+        if (soundHandler != &fakeSoundHandler || name == nullptr || *name == nullptr)
+        {
+            fail("Stop got the wrong sound handler or name");
+        }
+    }
+
+    int fakeIsPlayingImplementation(FakeObject* soundHandler, const char** name)
+    {
+        counts.isPlayingChecks += 1;
+        if (soundHandler != &fakeSoundHandler || name == nullptr || *name == nullptr)
+        {
+            fail("IsPlaying got the wrong sound handler or name");
+        }
+        return monotonicNanoseconds() < soundPlayingUntil;
+    }
+
+    void fakeWaitImplementation(uint32_t microseconds)
+    {
+        counts.waits += 1;
+        counts.waitedMicroseconds += microseconds;
+        usleep(microseconds);
+    }
+}
+
+// Every function starts by jumping over its byte pattern, which is never run. The instructions after it are the ones the tool
+// copies or jumps over, and they're written as bytes so they're encoded exactly the same way as in the game.
+// The stack is aligned by 16 at every place the tool injects into, like in the game.
+#if __x86_64__
+asm(R"(
+    .intel_syntax noprefix
+    .text
+
+    .globl fakeLoadEnd
+fakeLoadEnd:
+    push rbx
+    mov rbx, rdi
+    jmp .LloadEnd
+.LloadEndPattern:
+    .byte 0xe8
+    .fill 6, 1, 0xcc
+    .byte 0x7b, 0xcc, 0xbe, 0x06
+    .fill 8, 1, 0xcc
+.LloadEnd:
+    .byte 0x48, 0x8b, 0xbb, 0xd8, 0x00, 0x00, 0x00      # mov rdi, qword ptr [rbx + 0xd8]
+    .byte 0xe8                                          # call isQuitMessagePosted
+    .long fakeIsQuitMessagePosted - . - 4
+    .byte 0x84, 0xc0                                    # test al, al
+    movzx eax, al
+    pop rbx
+    ret
+    .if .LloadEnd - .LloadEndPattern != 19
+    .error "the load end instructions have to be 19 bytes after the pattern"
+    .endif
+
+    .globl fakeMenuLoad
+fakeMenuLoad:
+    push rbp
+    sub rsp, 0x100
+    jmp .LmenuLoad
+.LmenuLoadPattern:
+    .byte 0xc1, 0xcc, 0xcc, 0xe7, 0xcc, 0x8b, 0x80
+    .fill 13, 1, 0xcc
+.LmenuLoad:
+    .byte 0x48, 0x8d, 0xac, 0x24, 0xb8, 0x00, 0x00, 0x00    # lea rbp, [rsp + 0xb8]
+    .byte 0x48, 0x8d, 0x94, 0x24, 0xf5, 0x00, 0x00, 0x00    # lea rdx, [rsp + 0xf5]
+    mov rdi, rbp
+    sub rdi, rsp
+    mov rsi, rdx
+    sub rsi, rsp
+    call fakeMenuLoaded
+    add rsp, 0x100
+    pop rbp
+    ret
+    .if .LmenuLoad - .LmenuLoadPattern != 20
+    .error "the menu load instructions have to be 20 bytes after the pattern"
+    .endif
+
+    .globl fakeChangeMap
+fakeChangeMap:
+    push rbx
+    jmp .LmapLoad
+.LmapLoadPattern:
+    .byte 0xff, 0xcc, 0xcc, 0x4c
+    .fill 8, 1, 0xcc
+    .byte 0x4f
+    .fill 41, 1, 0xcc
+.LmapLoad:
+    .byte 0x48, 0x8b, 0x05                              # mov rax, qword ptr [rip + gpBase]
+    .long gpBase - . - 4
+    .byte 0x48, 0x8b, 0xb8, 0x38, 0x01, 0x00, 0x00      # mov rdi, qword ptr [rax + 0x138]
+    .byte 0xe8                                          # call fakeLoadMap
+    .long fakeLoadMap - . - 4
+    .byte 0x48, 0x8b, 0x05                              # mov rax, qword ptr [rip + gpBase]
+    .long gpBase - . - 4
+    .fill 16, 1, 0x90
+.LbeforeFadeOut:
+    .byte 0x48, 0xc7, 0xc1, 0x03, 0x00, 0x00, 0x00      # mov rcx, 3
+    .byte 0x0f, 0x1f, 0x40, 0x00                        # nop dword ptr [rax]
+    .byte 0x48, 0x8b, 0x05                              # mov rax, qword ptr [rip + gpBase] // the tool corrects this when it moves it
+    .long gpBase - . - 4
+.LgettingSoundHandler:
+    .byte 0x48, 0x8b, 0x80, 0x40, 0x00, 0x00, 0x00      # mov rax, qword ptr [rax + 0x40]
+    .byte 0x48, 0x8b, 0xb8, 0x48, 0x00, 0x00, 0x00      # mov rdi, qword ptr [rax + 0x48]
+    mov rsi, rcx
+    call fakeFadeOut
+    pop rbx
+    ret
+    .if .LmapLoad - .LmapLoadPattern != 54 || .LbeforeFadeOut - .LmapLoadPattern != 96 || .LgettingSoundHandler - .LmapLoadPattern != 114
+    .error "the map load instructions have to be 54, 96 and 114 bytes after the pattern"
+    .endif
+
+    .globl fakeMapLoadEnd
+fakeMapLoadEnd:
+    push rbx
+    mov rbx, rdi
+    jmp .LmapLoadEnd
+.LmapLoadEndPattern:
+    .byte 0xed
+    .fill 8, 1, 0xcc
+    .byte 0x6c
+    .fill 4, 1, 0xcc
+    .byte 0x54
+    .fill 35, 1, 0xcc
+.LmapLoadEnd:
+    .byte 0x48, 0x8b, 0x7b, 0x28                        # mov rdi, qword ptr [rbx + 0x28]
+    .byte 0x48, 0x8b, 0x07                              # mov rax, qword ptr [rdi]
+    .byte 0xff, 0x50, 0x18                              # call qword ptr [rax + 0x18]
+    .byte 0xe8                                          # call getApplicationTime
+    .long fakeGetApplicationTime - . - 4
+    pop rbx
+    ret
+    .if .LmapLoadEnd - .LmapLoadEndPattern != 50
+    .error "the map load end instructions have to be 50 bytes after the pattern"
+    .endif
+
+fakeStop:
+    .byte 0xe9
+    .long fakeStopImplementation - . - 4
+    .fill 93, 1, 0xcc
+.LstopPattern:
+    .byte 0x80, 0x7b, 0xcc, 0xcc, 0xb8
+    .fill 6, 1, 0xcc
+    .byte 0x80
+    .if .LstopPattern - fakeStop != 98
+    .error "the Stop pattern has to be 98 bytes after the start of the function"
+    .endif
+
+fakeIsPlaying:
+    .byte 0xe9
+    .long fakeIsPlayingImplementation - . - 4
+    .fill 94, 1, 0xcc
+.LisPlayingPattern:
+    .byte 0x8b, 0x7b, 0xcc, 0xcc, 0xcc, 0x07
+    .fill 7, 1, 0xcc
+    .byte 0x83
+    .if .LisPlayingPattern - fakeIsPlaying != 99
+    .error "the IsPlaying pattern has to be 99 bytes after the start of the function"
+    .endif
+
+fakeFlWait:
+    .byte 0x89, 0xf8                                    # mov eax, edi
+    .byte 0xba, 0x00, 0x00, 0x00, 0x00                  # mov edx, 0
+    .byte 0x48, 0x83, 0xec, 0x08                        # sub rsp, 8
+    call fakeWaitImplementation
+    add rsp, 8
+    ret
+
+    .att_syntax prefix
+)");
+#else
+asm(R"(
+    .intel_syntax noprefix
+    .text
+
+    .globl fakeLoadEnd
+fakeLoadEnd:
+    push ebx
+    sub esp, 8
+    mov ebx, dword ptr [esp + 16]
+    jmp .LloadEnd
+.LloadEndPattern:
+    .byte 0xe8
+    .fill 8, 1, 0xcc
+    .byte 0x06, 0x00, 0xcc, 0xcc, 0xd9
+    .fill 14, 1, 0xcc
+.LloadEnd:
+    .byte 0x8b, 0x43, 0x74                              # mov eax, dword ptr [ebx + 0x74]
+    .byte 0x89, 0x04, 0x24                              # mov dword ptr [esp], eax
+    call fakeIsQuitMessagePosted
+    movzx eax, al
+    add esp, 8
+    pop ebx
+    ret
+    .if .LloadEnd - .LloadEndPattern != 28
+    .error "the load end instructions have to be 28 bytes after the pattern"
+    .endif
+
+    .globl fakeMenuLoad
+fakeMenuLoad:
+    push ebp
+    mov ebp, esp
+    push esi
+    sub esp, 0x44
+    jmp .LmenuLoad
+.LmenuLoadPattern:
+    .byte 0x7d, 0xcc, 0xcc, 0x40, 0xcc, 0x8b, 0xcc, 0xcc, 0xc7
+    .fill 29, 1, 0xcc
+.LmenuLoad:
+    .byte 0x8d, 0x45, 0xe5                              # lea eax, [ebp - 0x1b]
+    .byte 0x8d, 0x75, 0xd0                              # lea esi, [ebp - 0x30]
+    sub eax, ebp
+    sub esi, ebp
+    mov dword ptr [esp], eax
+    mov dword ptr [esp + 4], esi
+    call fakeMenuLoaded
+    add esp, 0x44
+    pop esi
+    pop ebp
+    ret
+    .if .LmenuLoad - .LmenuLoadPattern != 38
+    .error "the menu load instructions have to be 38 bytes after the pattern"
+    .endif
+
+    .globl fakeChangeMap
+fakeChangeMap:
+    push ebx
+    sub esp, 0x18
+    jmp .LmapLoad
+.LmapLoadPattern:
+    .byte 0x52, 0xcc, 0x8d, 0xcc, 0xcc, 0x8d, 0xcc, 0xcc, 0x89
+    .fill 50, 1, 0xcc
+.LmapLoad:
+    .byte 0xa1                                          # mov eax, dword ptr [gpBase]
+    .long gpBase
+    .byte 0x8b, 0x80, 0x38, 0x01, 0x00, 0x00            # mov eax, dword ptr [eax + 0x138]
+    .byte 0x89, 0x04, 0x24                              # mov dword ptr [esp], eax
+    .byte 0xe8                                          # call fakeLoadMap
+    .long fakeLoadMap - . - 4
+    .fill 18, 1, 0x90
+.LgettingSoundHandler:
+    .byte 0xa1                                          # mov eax, dword ptr [gpBase]
+    .long gpBase
+.LbeforeFadeOut:
+    .byte 0xc7, 0x44, 0x24, 0x0c, 0x01, 0x00, 0x00, 0x00    # mov dword ptr [esp + 12], 1
+    .byte 0xc7, 0x44, 0x24, 0x08, 0x02, 0x00, 0x00, 0x00    # mov dword ptr [esp + 8], 2
+    .byte 0xc7, 0x44, 0x24, 0x04, 0x03, 0x00, 0x00, 0x00    # mov dword ptr [esp + 4], 3
+.LgettingSoundHandlerEnd:
+    .byte 0x8b, 0x80, 0x40, 0x00, 0x00, 0x00            # mov eax, dword ptr [eax + 0x40]
+    .byte 0x8b, 0x40, 0x48                              # mov eax, dword ptr [eax + 0x48]
+    .byte 0x89, 0xc0                                    # mov eax, eax
+    mov dword ptr [esp], eax
+    call fakeFadeOut
+    add esp, 0x18
+    pop ebx
+    ret
+    .if .LmapLoad - .LmapLoadPattern != 59 || .LgettingSoundHandler - .LmapLoadPattern != 96 || .LgettingSoundHandlerEnd - .LmapLoadPattern != 125
+    .error "the map load instructions have to be 59, 96 and 125 bytes after the pattern"
+    .endif
+
+    .globl fakeMapLoadEnd
+fakeMapLoadEnd:
+    push ebx
+    sub esp, 0x18
+    mov ebx, dword ptr [esp + 0x20]
+    jmp .LmapLoadEnd
+.LmapLoadEndPattern:
+    .byte 0xf2, 0x84
+    .fill 11, 1, 0xcc
+    .byte 0x75
+    .fill 44, 1, 0xcc
+.LmapLoadEnd:
+    .byte 0x8b, 0x43, 0x14                              # mov eax, dword ptr [ebx + 0x14]
+    .byte 0x8b, 0x10                                    # mov edx, dword ptr [eax]
+    mov dword ptr [esp], eax
+    call dword ptr [edx + 0x0c]
+    call fakeGetApplicationTime
+    fstp st(0)
+    add esp, 0x18
+    pop ebx
+    ret
+    .if .LmapLoadEnd - .LmapLoadEndPattern != 58
+    .error "the map load end instructions have to be 58 bytes after the pattern"
+    .endif
+
+fakeStop:
+    .byte 0xe9
+    .long fakeStopImplementation - . - 4
+    .fill 121, 1, 0xcc
+.LstopPattern:
+    .byte 0x80, 0x7b, 0xcc, 0xcc, 0xb8
+    .fill 6, 1, 0xcc
+    .byte 0x80
+    .if .LstopPattern - fakeStop != 126
+    .error "the Stop pattern has to be 126 bytes after the start of the function"
+    .endif
+
+fakeIsPlaying:
+    .byte 0xe9
+    .long fakeIsPlayingImplementation - . - 4
+    .fill 114, 1, 0xcc
+.LisPlayingPattern:
+    .byte 0x43, 0xcc, 0x8b
+    .fill 8, 1, 0xcc
+    .byte 0x65
+    .if .LisPlayingPattern - fakeIsPlaying != 119
+    .error "the IsPlaying pattern has to be 119 bytes after the start of the function"
+    .endif
+
+fakeFlWait:
+    .byte 0x53                                          # push ebx
+    .byte 0x83, 0xec, 0x18                              # sub esp, 0x18
+    .byte 0x8b, 0x5c, 0x24, 0x20                        # mov ebx, dword ptr [esp + 0x20]
+    .byte 0xba, 0x00, 0x00, 0x00, 0x00                  # mov edx, 0
+    .byte 0x89, 0xd8                                    # mov eax, ebx
+    mov dword ptr [esp], eax
+    call fakeWaitImplementation
+    add esp, 0x18
+    pop ebx
+    ret
+
+    .att_syntax prefix
+)");
+#endif
+
+static void setUpFakeObjects()
+{
+    setPointer(fakeGame, mapHandlerOffset, &fakeMapHandler);
+    setPointer(fakeGame, engineOffset, &fakeEngine);
+    setPointer(fakeEngine, soundHandlerOffset, &fakeSoundHandler);
+    setPointer(fakeLoadingScreen, quitMessageObjectOffset, &fakeQuitMessageObject);
+    setPointer(fakeMap, sceneObjectOffset, &fakeScene);
+    fakeSceneVirtualFunctions[3] = (void*)&fakeSceneLoaded;
+    setPointer(fakeScene, 0, fakeSceneVirtualFunctions);
+}
+
+// checks the tool wrote exactly this event while the game was loading. timer is nullptr if the tool isn't loaded
+static void checkEvent(AmnesiaTimer* timer, const uint32_t expectedEventCode, uint32_t& eventsChecked)
+{
+    if (timer == nullptr)
+    {
+        return;
+    }
+
+    eventsChecked += 1;
+    AmnesiaTimerEvent event{};
+    if (amnesiaTimerPoll(timer, &event) != amnesiaTimerGotEvent)
+    {
+        printf("FAILED: expected event %u, but there wasn't one\n", expectedEventCode);
+        counts.failures += 1;
+        return;
+    }
+    if (event.eventCode != expectedEventCode || event.missedEvents != 0)
+    {
+        printf("FAILED: expected event %u, got %u (%u missed)\n", expectedEventCode, event.eventCode, event.missedEvents);
+        counts.failures += 1;
+    }
+    while (amnesiaTimerPoll(timer, &event) == amnesiaTimerGotEvent)
+    {
+        printf("FAILED: an extra event %u after %u\n", event.eventCode, expectedEventCode);
+        counts.failures += 1;
+    }
+}
+
+static void openFile(const char* command, const char* path, const int times)
+{
+    int64_t before = monotonicNanoseconds();
+    int opened = 0;
+    for (int i = 0; i < times; i++)
+    {
+        FILE* file = nullptr; // make sure this gets closed
+        if (strcmp(command, "open") == 0)
+        {
+            file = fopen(path, "rb");
+        }
+        else if (strcmp(command, "open64") == 0)
+        {
+            file = fopen64(path, "rb");
+        }
+        else
+        {
+            file = fopen("/dev/null", "rb");
+            if (file != nullptr)
+            {
+                file = freopen(path, "rb", file);
+            }
+        }
+
+        if (file != nullptr)
+        {
+            opened += 1;
+            fclose(file); // file closed here
+        }
+    }
+    int64_t took = monotonicNanoseconds() - before;
+
+    printf("%s %s: %d of %d opened, %lld ns per open\n", command, path, opened, times, (long long)(took / times));
+}
+
+// there's no libGL or libSDL, so the tool's hooks are called directly, and find nothing to call after them.
+// the hooks are found with dlsym because they're only there when the tool is preloaded
+static void swapFrames(const int frames, const int milliseconds, const bool loading, const int64_t resumeNanoseconds)
+{
+    auto glxSwapBuffers = reinterpret_cast<void (*)(void* display, unsigned long drawable)>(dlsym(RTLD_DEFAULT, "glXSwapBuffers"));
+    auto sdlGlSwapWindow = reinterpret_cast<void (*)(void* window)>(dlsym(RTLD_DEFAULT, "SDL_GL_SwapWindow"));
+    auto sdlGlSwapBuffers = reinterpret_cast<void (*)()>(dlsym(RTLD_DEFAULT, "SDL_GL_SwapBuffers"));
+    if (glxSwapBuffers == nullptr || sdlGlSwapWindow == nullptr || sdlGlSwapBuffers == nullptr)
+    {
+        printf("not swapping, the tool's swap hooks aren't loaded\n");
+        return;
+    }
+
+    for (int i = 0; i < frames; i++)
+    {
+        usleep(milliseconds * 1000);
+        switch (counts.swaps % 3)
+        {
+        case 0:
+            glxSwapBuffers(nullptr, 0);
+            break;
+        case 1:
+            sdlGlSwapWindow(nullptr);
+            break;
+        default:
+            sdlGlSwapBuffers();
+            break;
+        }
+
+        // the same states the tool gives frames. frames close to 2 seconds after a load could go either way, so scripts avoid them
+        if (counts.swaps++ != 0)
+        {
+            bool afterLoad = resumeNanoseconds != 0 && monotonicNanoseconds() - resumeNanoseconds < 2000000000;
+            counts.frames[loading ? amnesiaTimerFrameLoading : afterLoad ? amnesiaTimerFrameAfterLoad : amnesiaTimerFramePlaying] += 1;
+        }
+    }
+}
+
+// checks the tool measured a frame for every swap, in the same states the fake game was in
+static void checkFrameTimes(AmnesiaTimer* timer)
+{
+    if (timer == nullptr || counts.swaps == 0)
+    {
+        return;
+    }
+
+    const char* stateNames[3] = {"playing", "loading", "after loads"};
+    uint64_t frames = 0;
+    for (int state = 0; state < 3; state++)
+    {
+        AmnesiaTimerFrameTimes frameTimes{};
+        if (amnesiaTimerFrameTimes(timer, state, &frameTimes) != 0)
+        {
+            fail("the tool didn't have frame times");
+            return;
+        }
+        printf("frames %s: %llu, p50 %.2f ms, p99 %.2f ms, longest %.2f ms, %llu hooked opens\n", stateNames[state],
+            (unsigned long long)frameTimes.frames, (double)frameTimes.p50Nanoseconds / 1e6, (double)frameTimes.p99Nanoseconds / 1e6,
+            (double)frameTimes.longestNanoseconds / 1e6, (unsigned long long)frameTimes.hookedOpens);
+        if (frameTimes.frames != counts.frames[state])
+        {
+            fail("the tool's frame times don't match the swaps");
+        }
+        frames += frameTimes.frames;
+    }
+
+    std::vector<AmnesiaTimerRenderedFrame> recentFrames(frames);
+    int recentCount = amnesiaTimerRecentFrames(timer, recentFrames.data(), (int)recentFrames.size());
+    if (recentCount != (int)frames || (frames != 0 && recentFrames.back().sequence != frames))
+    {
+        fail("the tool's recent frames don't match the swaps");
+    }
+}
+
+// checks the tool counted the same loads and flashback waits as the fake game did. the flashback skips are counted once for every
+// map change, but only if skip flashbacks is on
+static void checkCounters(AmnesiaTimer* timer, const uint32_t menuLoads, const uint32_t mapChanges, const uint32_t loadEnds)
+{
+    AmnesiaTimerCounters counters{};
+    if (timer == nullptr || amnesiaTimerCounters(timer, &counters) != 0)
+    {
+        return;
+    }
+
+    printf("tool counters: %llu stdio opens, %llu delayed files (%lld ms), %llu flashback skips, %llu flashback waits\n",
+        (unsigned long long)(counters.fopenCalls + counters.freopenCalls + counters.fopen64Calls + counters.freopen64Calls),
+        (unsigned long long)counters.delayedFiles, (long long)(counters.delayNanoseconds / 1000000),
+        (unsigned long long)counters.flashbackSkips, (unsigned long long)counters.flashbackWaits);
+    if (counters.eventCounts[amnesiaTimerPause] != menuLoads || counters.eventCounts[amnesiaTimerPauseAndSplit] != mapChanges
+        || counters.eventCounts[amnesiaTimerResume] != loadEnds)
+    {
+        fail("the tool's event counters don't match the loads");
+    }
+    if (counters.flashbackWaits != counts.waits || (counters.flashbackSkips != 0 && counters.flashbackSkips != mapChanges))
+    {
+        fail("the tool's flashback counters don't match what the flashback instructions did");
+    }
+}
+
+static int runScript(const char* scriptPath)
+{
+    setUpFakeObjects();
+
+    FILE* script = fopen(scriptPath, "r"); // make sure this gets closed
+    if (script == nullptr)
+    {
+        printf("couldn't open %s: %d\n", scriptPath, errno);
+        return EXIT_FAILURE;
+    }
+
+    AmnesiaTimer* timer = amnesiaTimerAttachPid(getpid(), nullptr); // remember to detach
+    if (timer == nullptr)
+    {
+        printf("not checking load detection events: %s\n", amnesiaTimerLastError());
+    }
+
+    uint32_t menuLoads = 0;
+    uint32_t mapChanges = 0;
+    uint32_t loadEnds = 0;
+    uint32_t mapLoadEnds = 0;
+    uint32_t eventsChecked = 0;
+    int64_t longestMapLoadEnd = 0;
+    bool loading = false;
+    int64_t resumeNanoseconds = 0;
+    char line[512]{};
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), script) != nullptr)
+    {
+        lineNumber += 1;
+        line[strcspn(line, "#\r\n")] = '\0';
+
+        char command[32]{};
+        char argument[400]{};
+        int times = 1;
+        int howManyRead = sscanf(line, "%31s %399s %d", command, argument, &times);
+        if (howManyRead <= 0)
+        {
+            continue;
+        }
+
+        if (strcmp(command, "menu") == 0)
+        {
+            fakeMenuLoad();
+            menuLoads += 1;
+            loading = true;
+            checkEvent(timer, amnesiaTimerPause, eventsChecked);
+        }
+        else if (strcmp(command, "map") == 0 && howManyRead == 1)
+        {
+            fakeChangeMap();
+            mapChanges += 1;
+            loading = true;
+            checkEvent(timer, amnesiaTimerPauseAndSplit, eventsChecked);
+        }
+        else if (strcmp(command, "load") == 0 && strcmp(argument, "end") == 0)
+        {
+            fakeLoadEnd(&fakeLoadingScreen);
+            loadEnds += 1;
+            loading = false;
+            resumeNanoseconds = monotonicNanoseconds();
+            checkEvent(timer, amnesiaTimerResume, eventsChecked);
+        }
+        else if (strcmp(command, "map") == 0 && strcmp(argument, "load") == 0)
+        {
+            int64_t before = monotonicNanoseconds();
+            fakeMapLoadEnd(&fakeMap);
+            longestMapLoadEnd = std::max(longestMapLoadEnd, monotonicNanoseconds() - before);
+            mapLoadEnds += 1;
+        }
+        else if (strcmp(command, "play") == 0 && howManyRead >= 2)
+        {
+            soundPlayingUntil = monotonicNanoseconds() + (atoll(argument) * 1000000);
+        }
+        else if ((strcmp(command, "open") == 0 || strcmp(command, "open64") == 0 || strcmp(command, "freopen") == 0) && howManyRead >= 2)
+        {
+            openFile(command, argument, times < 1 ? 1 : times);
+        }
+        else if (strcmp(command, "frames") == 0 && howManyRead >= 3)
+        {
+            swapFrames(atoi(argument), times, loading, resumeNanoseconds);
+        }
+        else if (strcmp(command, "sleep") == 0 && howManyRead >= 2)
+        {
+            usleep(atoi(argument) * 1000);
+        }
+        else
+        {
+            printf("line %d of %s isn't a command: %s\n", lineNumber, scriptPath, line);
+        }
+    }
+    fclose(script); // script closed here
+
+    if (mapChanges != counts.mapLoads || mapChanges != counts.fadeOuts || loadEnds != counts.quitMessageChecks
+        || mapLoadEnds != counts.sceneLoads || mapLoadEnds != counts.applicationTimeChecks)
+    {
+        fail("some of the game's own instructions didn't run after the tool moved them");
+    }
+
+    printf("menu loads: %u, map changes: %u, load ends: %u, map load ends: %u\n", menuLoads, mapChanges, loadEnds, mapLoadEnds);
+    printf("load detection events checked: %u\n", eventsChecked);
+    printf("flashbacks stopped: %u, IsPlaying checks: %u, FLwait calls: %u (%llu ms), longest map load end: %lld ms\n",
+        counts.flashbacksStopped, counts.isPlayingChecks, counts.waits, (unsigned long long)(counts.waitedMicroseconds / 1000),
+        (long long)(longestMapLoadEnd / 1000000));
+    checkCounters(timer, menuLoads, mapChanges, loadEnds);
+    checkFrameTimes(timer);
+    printf("%s\n", counts.failures == 0 ? "everything worked" : "something FAILED");
+
+    if (timer != nullptr)
+    {
+        amnesiaTimerDetach(timer); // detached here
+    }
+
+    return counts.failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static const char startupTimeVariable[] = "FAKE_GAME_EXEC_NANOSECONDS";
+static const char startupFdVariable[] = "FAKE_GAME_STARTUP_FD";
+
+// every run execs this executable again, which sends back how long it took to get to main and exits.
+// LD_PRELOAD is inherited, so the tool is loaded in every run if it's loaded in this one
+static int measureStartup(char* executableName, const int runs)
+{
+    std::vector<int64_t> startupTimes;
+    for (int run = 0; run < runs; run++)
+    {
+        int pipeFds[2]{};
+        if (pipe2(pipeFds, O_CLOEXEC) == -1) // make sure these get closed
+        {
+            printf("pipe2 error: %d\n", errno);
+            return EXIT_FAILURE;
+        }
+
+        pid_t child = fork();
+        if (child == 0)
+        {
+            char fdNumber[16]{};
+            snprintf(fdNumber, sizeof(fdNumber), "%d", pipeFds[1]);
+            fcntl(pipeFds[1], F_SETFD, 0); // the child keeps the write end
+            if (run != 0)
+            {
+                int devNull = open("/dev/null", O_WRONLY);
+                dup2(devNull, 1); // only the first run's tool messages are shown
+            }
+            char execTime[24]{};
+            snprintf(execTime, sizeof(execTime), "%lld", (long long)monotonicNanoseconds());
+            setenv(startupFdVariable, fdNumber, 1);
+            setenv(startupTimeVariable, execTime, 1);
+            char* childArgv[] = {executableName, nullptr};
+            execv("/proc/self/exe", childArgv);
+            _exit(127);
+        }
+        close(pipeFds[1]);
+
+        int64_t startupTime = -1;
+        if (child != -1)
+        {
+            char result[32]{};
+            ssize_t bytesRead = read(pipeFds[0], result, sizeof(result) - 1);
+            if (bytesRead > 0)
+            {
+                startupTime = atoll(result);
+            }
+            waitpid(child, nullptr, 0);
+        }
+        close(pipeFds[0]); // pipe closed here
+
+        if (startupTime < 0)
+        {
+            printf("run %d failed\n", run);
+            return EXIT_FAILURE;
+        }
+        startupTimes.push_back(startupTime);
+    }
+
+    std::sort(startupTimes.begin(), startupTimes.end());
+    const char* preload = getenv("LD_PRELOAD");
+    printf("exec to main over %d runs (LD_PRELOAD=%s): min %lld us, median %lld us, max %lld us\n", runs, preload == nullptr ? "" : preload,
+        (long long)(startupTimes.front() / 1000), (long long)(startupTimes[startupTimes.size() / 2] / 1000), (long long)(startupTimes.back() / 1000));
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    // a --startup run, which only reports how long it took to get here
+    const char* execTime = getenv(startupTimeVariable);
+    const char* startupFd = getenv(startupFdVariable);
+    if (execTime != nullptr && startupFd != nullptr)
+    {
+        int64_t startupTime = monotonicNanoseconds() - atoll(execTime);
+        int fd = atoi(startupFd);
+        dprintf(fd, "%lld\n", (long long)startupTime);
+        close(fd);
+        return EXIT_SUCCESS;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--startup") == 0)
+    {
+        int runs = argc > 2 ? atoi(argv[2]) : 20;
+        return measureStartup(argv[0], runs < 1 ? 1 : runs);
+    }
+
+    return runScript(argc > 1 ? argv[1] : "fake_game_script.txt");
+}
@@ -0,0 +1,205 @@
+
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <condition_variable>
+#include <cstdio> // snprintf
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// non_std_functions.h has to be included before this
+
+[[maybe_unused]] static bool fileOpenTraceActive = false;
+static const char fileOpenTraceFolderName[] = "file_open_traces";
+static const char fileOpenTraceFirstLine[] = "# file open trace 1: nanoseconds, timer byte, delay in ms, path\n";
+static const size_t fileOpenTraceBufferSize = 256 * 1024; // two of these, one being filled by the hooks and one being written
+
+// Every path the stdio hooks see is written to a trace file in file_open_traces, one line per open in the order the delays were taken:
+// the nanoseconds since the first open, the timer byte, the delay the file got (-1 if it isn't in the delay table, or - if delays
+// were off), and the path. delay_trace_replayer feeds a trace to a new delay table to check that changes to the delay rules
+// give the same delays. The delay is taken while the recorder's mutex is held, so the trace's order is the order the delay
+// positions were changed in, even when several threads open files at once. That makes the hooks slower, which is why it's off by default.
+// The hooks only copy their line into a buffer while they have the mutex. A writer thread, started by the first open, swaps the
+// buffers and writes the full one, so no hook waits for the disk. If the hooks fill a buffer before the other one is written,
+// the lines that don't fit are dropped and counted, and lines still in the buffers are lost if the game is killed.
+class FileOpenTraceRecorder
+{
+public:
+    FileOpenTraceRecorder(const FileOpenTraceRecorder&) = delete;
+    FileOpenTraceRecorder& operator=(FileOpenTraceRecorder other) = delete;
+    FileOpenTraceRecorder(FileOpenTraceRecorder&&) = delete;
+    FileOpenTraceRecorder& operator=(FileOpenTraceRecorder&&) = delete;
+
+    FileOpenTraceRecorder() = default;
+
+    ~FileOpenTraceRecorder()
+    {
+        if (_worker.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopWorker = true; // the lines already recorded are still written
+            }
+            _workAvailable.notify_one();
+            _worker.join();
+        }
+        if (_fd != -1)
+        {
+            close(_fd); // file closed here
+            _fd = -1;
+        }
+    }
+
+    // takeDelay returns the file's delay like DelayTable::takeDelay. the delay is slept after this returns
+    template <typename F>
+    int record(const char* path, const unsigned char timerByte, const bool delaysOn, F takeDelay)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        int delay = takeDelay();
+        if (_failed)
+        {
+            return delay;
+        }
+        if (!_worker.joinable() && !start())
+        {
+            _failed = true;
+            return delay;
+        }
+
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        char numbers[64];
+        int numbersSize = delaysOn
+            ? snprintf(numbers, sizeof(numbers), "%lld %d %d ", (long long)(now - _startNanoseconds), (int)timerByte, delay)
+            : snprintf(numbers, sizeof(numbers), "%lld %d - ", (long long)(now - _startNanoseconds), (int)timerByte);
+        size_t pathSize = strlen(path);
+        size_t lineSize = (size_t)numbersSize + pathSize + 1;
+        if (_filling + lineSize > fileOpenTraceBufferSize)
+        {
+            _droppedLines++;
+            return delay;
+        }
+
+        char* line = _buffers[_fillingBuffer].get() + _filling;
+        memcpy(line, numbers, (size_t)numbersSize);
+        memcpy(line + numbersSize, path, pathSize);
+        line[lineSize - 1] = '\n';
+        bool wasEmpty = _filling == 0;
+        _filling += lineSize;
+        lock.unlock();
+
+        if (wasEmpty) // the writer is waiting, or will see the lines when it's done with the other buffer
+        {
+            _workAvailable.notify_one();
+        }
+        return delay;
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _workAvailable;
+    std::thread _worker;
+    bool _stopWorker = false;
+    bool _failed = false;
+    int64_t _startNanoseconds = 0;
+    std::unique_ptr<char[]> _buffers[2];
+    size_t _fillingBuffer = 0;
+    size_t _filling = 0; // bytes in the buffer the hooks are filling
+    size_t _droppedLines = 0;
+
+    int _fd = -1; // only used by the writer thread
+
+    // called with _mutex locked
+    bool start()
+    {
+        _buffers[0].reset(new (std::nothrow) char[fileOpenTraceBufferSize]);
+        _buffers[1].reset(new (std::nothrow) char[fileOpenTraceBufferSize]);
+        if (_buffers[0] == nullptr || _buffers[1] == nullptr)
+        {
+            printCstr("WARNING: couldn't allocate the file open trace's buffers\n");
+            return false;
+        }
+
+        _startNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        _worker = std::thread(&FileOpenTraceRecorder::workerLoop, this);
+        return true;
+    }
+
+    void workerLoop()
+    {
+        bool writeFailed = !openFile();
+        if (writeFailed)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _failed = true; // the hooks stop adding lines, and the ones already added are thrown away
+        }
+        while (true)
+        {
+            char* buffer = nullptr;
+            size_t size = 0;
+            size_t droppedLines = 0;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _workAvailable.wait(lock, [this]() { return _stopWorker || _filling != 0; });
+                if (_filling == 0)
+                {
+                    return;
+                }
+                buffer = _buffers[_fillingBuffer].get();
+                size = _filling;
+                _fillingBuffer ^= 1; // the hooks fill the other buffer while this one is written
+                _filling = 0;
+                droppedLines = _droppedLines;
+                _droppedLines = 0;
+            }
+
+            if (droppedLines != 0)
+            {
+                printCstr("WARNING: "); printInt(droppedLines); printCstr(" opens weren't written to the file open trace because it couldn't keep up\n");
+            }
+            // one write with O_APPEND of whole lines, so a line is never split even if the game is killed
+            if (!writeFailed && write(_fd, buffer, size) != (ssize_t)size)
+            {
+                printCstr("WARNING: stopped writing the file open trace, write failure: "); printInt(errno); printCstr("\n");
+                writeFailed = true;
+            }
+        }
+    }
+
+    bool openFile()
+    {
+        if (mkdir(fileOpenTraceFolderName, 0755) == -1 && errno != EEXIST)
+        {
+            printCstr("WARNING: couldn't make the "); printCstr(fileOpenTraceFolderName); printCstr(" folder: "); printInt(errno); printCstr("\n");
+            return false;
+        }
+
+        struct timespec realtime{};
+        clock_gettime(CLOCK_REALTIME, &realtime);
+        std::string path = std::string(fileOpenTraceFolderName) + "/trace_" + std::to_string((long long)realtime.tv_sec) + "_"
+            + std::to_string((int)getpid()) + ".txt";
+        _fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644); // make sure this gets closed
+        if (_fd == -1)
+        {
+            printCstr("WARNING: couldn't open "); printCstr(path.c_str()); printCstr(": "); printInt(errno); printCstr("\n");
+            return false;
+        }
+        if (write(_fd, fileOpenTraceFirstLine, sizeof(fileOpenTraceFirstLine) - 1) != sizeof(fileOpenTraceFirstLine) - 1)
+        {
+            printCstr("WARNING: couldn't write "); printCstr(path.c_str()); printCstr(": "); printInt(errno); printCstr("\n");
+            return false;
+        }
+        return true;
+    }
+};
+
+static FileOpenTraceRecorder fileOpenTraceRecorder;
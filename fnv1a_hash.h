@@ -0,0 +1,14 @@
+
+#include <cstdint>
+#include <cstddef>
+
+// the hash the config cache's delay table and the load history's map names use, so they're the same in the tool and the programs which read them
+[[maybe_unused]] static uint64_t fnv1a64(const unsigned char* bytes, const size_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
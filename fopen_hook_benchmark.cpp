@@ -0,0 +1,334 @@
+
+// Times the fopen, fopen64 and freopen hooks in load_extender.h against calling libc's functions directly. The hooks are timed
+// with every hook turned off, for files which aren't in the delay table (the miss path), and for files which are (the hit path,
+// with 0 ms delays so only the table lookup and the delay position's compare and swap are timed).
+// Then the miss and hit paths are run from several threads at once, because every open goes through the delay table's reader counts
+// and every hit changes the same delay positions, so the hooks could slow each other down when the game opens files from several threads.
+// The hooks are compiled into this program like in config_parser_benchmark, because the tool only turns them on after it has
+// injected into the game. The paths are about as long as the game's, which are absolute paths into the game's folder.
+// usage: fopen_hook_benchmark.exe [opens per measurement, default 20000] [threads, default the number of CPUs]
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <errno.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "non_std_functions.h"
+#include "fnv1a_hash.h"
+#include "config_cache.h"
+#include "tool_counters.h"
+#include "map_prefetcher.h"
+#include "page_cache_warmer.h"
+#include "mmap_file_streams.h"
+#include "load_history.h"
+#include "file_open_trace.h"
+#include "load_extender.h"
+
+enum class OpenFunction
+{
+    Fopen,
+    Fopen64,
+    Freopen
+};
+
+static const char* openFunctionNames[] = {"fopen", "fopen64", "freopen"};
+
+static const char assetDirectory[] = "steamapps/common/Amnesia The Dark Descent/redist/static_objects/castlebase/doors";
+static const size_t filesPerPath = 32;
+static const size_t fillerDelayLines = 2000; // about as many as a full route's files_and_delays.txt
+static const char delayCheckFileName[] = "delay_check.dae";
+static const int delayCheckMilliseconds = 20;
+
+// opens and closes the files opens times, and returns how many nanoseconds each open took, or -1 if one failed
+static double nanosecondsPerOpen(const OpenFunction function, const bool hooked, const std::vector<std::string>& paths, const size_t opens)
+{
+    FILE* reopened = function == OpenFunction::Freopen ? originalFopen("/dev/null", "rb") : nullptr; // make sure this gets closed
+    bool failed = function == OpenFunction::Freopen && reopened == nullptr;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < opens && !failed; i++)
+    {
+        const char* path = paths[i % paths.size()].c_str();
+        FILE* file = nullptr;
+        if (function == OpenFunction::Fopen)
+        {
+            file = hooked ? fopen(path, "rb") : originalFopen(path, "rb");
+        }
+        else if (function == OpenFunction::Fopen64)
+        {
+            file = hooked ? fopen64(path, "rb") : originalFopen64(path, "rb");
+        }
+        else
+        {
+            // freopen closes the stream even if it fails
+            file = hooked ? freopen(path, "rb", reopened) : originalFreopen(path, "rb", reopened);
+            reopened = file;
+        }
+
+        failed = file == nullptr;
+        if (file != nullptr && function != OpenFunction::Freopen)
+        {
+            fclose(file);
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (reopened != nullptr)
+    {
+        fclose(reopened); // stream closed here
+    }
+
+    return failed ? -1.0 : elapsed.count() / (double)opens;
+}
+
+// keeps the best of a few runs, so one slow run from something else using the CPU doesn't count. returns false if the run failed
+static bool keepBest(double& best, const double result)
+{
+    if (result < 0)
+    {
+        return false;
+    }
+    best = (best == 0 || result < best) ? result : best;
+    return true;
+}
+
+// every thread opens the files opens times. returns the nanoseconds per open for one thread, from when they all started to when they all finished
+static double threadedNanosecondsPerOpen(const size_t threadCount, const bool hooked, const std::vector<std::string>& paths, const size_t opens)
+{
+    std::atomic<bool> go = false;
+    std::atomic<size_t> ready = 0;
+    std::atomic<bool> failed = false;
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        threads.emplace_back([&, i]
+        {
+            // each thread starts on a different file, like the game's threads would
+            std::vector<std::string> rotatedPaths(paths.begin() + (i % paths.size()), paths.end());
+            rotatedPaths.insert(rotatedPaths.end(), paths.begin(), paths.begin() + (i % paths.size()));
+            ready.fetch_add(1);
+            while (!go.load());
+            if (nanosecondsPerOpen(OpenFunction::Fopen, hooked, rotatedPaths, opens) < 0)
+            {
+                failed.store(true);
+            }
+        });
+    }
+
+    while (ready.load() != threadCount);
+    auto start = std::chrono::steady_clock::now();
+    go.store(true);
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    return failed.load() ? -1.0 : elapsed.count() / (double)opens;
+}
+
+static bool writeFile(const char* filename, const std::string& text)
+{
+    FILE* file = originalFopen(filename, "wb"); // make sure this gets closed
+    if (file == nullptr)
+    {
+        printf("couldn't write %s: %d\n", filename, errno);
+        return false;
+    }
+    bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+    fclose(file); // file closed here
+    return written;
+}
+
+// the files with delays are the hit paths and the others are the miss paths
+static bool generateFiles(const std::string& directory, std::vector<std::string>& hitPaths, std::vector<std::string>& missPaths)
+{
+    std::string partialDirectory;
+    for (const char* part = assetDirectory; *part != '\0';)
+    {
+        const char* partEnd = strchr(part, '/');
+        size_t partLength = partEnd != nullptr ? (size_t)(partEnd - part) : strlen(part);
+        partialDirectory.append(part, partLength);
+        if (mkdir(partialDirectory.c_str(), 0700) == -1)
+        {
+            printf("couldn't make %s: %d\n", partialDirectory.c_str(), errno);
+            return false;
+        }
+        partialDirectory += '/';
+        part += partLength + (partEnd != nullptr);
+    }
+
+    std::string delaysText;
+    for (size_t i = 0; i < fillerDelayLines; i++)
+    {
+        delaysText += "filler_" + std::to_string(i) + ".hps / 1000 / -\n";
+    }
+    for (size_t i = 0; i < filesPerPath; i++)
+    {
+        std::string hitName = "castle_door_wooden_" + std::to_string(i) + ".dae";
+        std::string missName = "castle_door_iron_" + std::to_string(i) + ".dae";
+        delaysText += hitName + " / 0 / -\n";
+        hitPaths.push_back(directory + "/" + partialDirectory + hitName);
+        missPaths.push_back(directory + "/" + partialDirectory + missName);
+    }
+    delaysText += std::string(delayCheckFileName) + " / " + std::to_string(delayCheckMilliseconds) + " / -\n";
+
+    bool success = writeFile(delaysFileName, delaysText) && writeFile(delayCheckFileName, "");
+    for (size_t i = 0; i < filesPerPath && success; i++)
+    {
+        success = writeFile(hitPaths[i].c_str(), "") && writeFile(missPaths[i].c_str(), "");
+    }
+    return success;
+}
+
+static void removeFiles(const std::vector<std::string>& hitPaths, const std::vector<std::string>& missPaths)
+{
+    for (size_t i = 0; i < hitPaths.size(); i++)
+    {
+        unlink(hitPaths[i].c_str());
+        unlink(missPaths[i].c_str());
+    }
+    unlink(delaysFileName);
+    unlink(delayCheckFileName);
+
+    // removing the directories from the deepest one up
+    std::string partialDirectory = assetDirectory;
+    while (!partialDirectory.empty())
+    {
+        rmdir(partialDirectory.c_str());
+        size_t slash = partialDirectory.rfind('/');
+        partialDirectory.resize(slash == std::string::npos ? 0 : slash);
+    }
+}
+
+static void printRow(const char* name, const double* nanoseconds, const double* baseline)
+{
+    printf("%-18s", name);
+    for (size_t i = 0; i < 3; i++)
+    {
+        if (baseline == nullptr)
+        {
+            printf("%10.0f ns          ", nanoseconds[i]);
+        }
+        else
+        {
+            printf("%10.0f ns (%+6.0f)", nanoseconds[i], nanoseconds[i] - baseline[i]);
+        }
+    }
+    printf("\n");
+}
+
+static bool benchmark(const size_t opens, const size_t threadCount, const std::vector<std::string>& hitPaths, const std::vector<std::string>& missPaths)
+{
+    double libc[3]{};
+    double hooksOff[3]{};
+    double miss[3]{};
+    double hit[3]{};
+    const OpenFunction functions[] = {OpenFunction::Fopen, OpenFunction::Fopen64, OpenFunction::Freopen};
+
+    // checking the delay table is really being used before timing it
+    delaysActive = true;
+    auto delayCheckStart = std::chrono::steady_clock::now();
+    FILE* delayCheckFile = fopen(delayCheckFileName, "rb");
+    std::chrono::duration<double, std::milli> delayCheck = std::chrono::steady_clock::now() - delayCheckStart;
+    if (delayCheckFile != nullptr)
+    {
+        fclose(delayCheckFile);
+    }
+    if (delayCheckFile == nullptr || delayCheck.count() < delayCheckMilliseconds)
+    {
+        printf("the delay table isn't working, %s took %.1f ms instead of %d ms\n", delayCheckFileName, delayCheck.count(), delayCheckMilliseconds);
+        return false;
+    }
+
+    // every run times all of them one after another, so the CPU's clock speed changing between runs affects them all the same
+    bool succeeded = true;
+    for (int run = 0; run < 5 && succeeded; run++)
+    {
+        for (size_t i = 0; i < 3 && succeeded; i++)
+        {
+            delaysActive = false;
+            succeeded = keepBest(libc[i], nanosecondsPerOpen(functions[i], false, missPaths, opens))
+                && keepBest(hooksOff[i], nanosecondsPerOpen(functions[i], true, missPaths, opens));
+            delaysActive = true;
+            succeeded = succeeded && keepBest(miss[i], nanosecondsPerOpen(functions[i], true, missPaths, opens))
+                && keepBest(hit[i], nanosecondsPerOpen(functions[i], true, hitPaths, opens));
+        }
+    }
+    if (!succeeded)
+    {
+        printf("opening the files failed: %d\n", errno);
+        return false;
+    }
+
+    printf("%zu opens of %zu files with %zu character paths, %zu other files with delays, best of 5 runs\n",
+        opens, filesPerPath, hitPaths[0].size(), fillerDelayLines);
+    printf("%-18s%-26s%-26s%-26s\n", "", openFunctionNames[0], openFunctionNames[1], openFunctionNames[2]);
+    printRow("libc", libc, nullptr);
+    printRow("hooks off", hooksOff, libc);
+    printRow("delay table miss", miss, libc);
+    printRow("delay table hit", hit, libc);
+
+    printf("\nfopen from several threads at once, nanoseconds per open for each thread\n");
+    printf("%-10s%-16s%-26s%-26s\n", "threads", "libc", "delay table miss", "delay table hit");
+    for (size_t threads = 1; threads <= threadCount; threads *= 2)
+    {
+        delaysActive = false;
+        double threadedLibc = threadedNanosecondsPerOpen(threads, false, missPaths, opens);
+        delaysActive = true;
+        double threadedMiss = threadedNanosecondsPerOpen(threads, true, missPaths, opens);
+        double threadedHit = threadedNanosecondsPerOpen(threads, true, hitPaths, opens);
+        if (threadedLibc < 0 || threadedMiss < 0 || threadedHit < 0)
+        {
+            printf("opening the files failed: %d\n", errno);
+            return false;
+        }
+        printf("%-10zu%10.0f ns    %10.0f ns (%+6.0f)   %10.0f ns (%+6.0f)\n", threads, threadedLibc,
+            threadedMiss, threadedMiss - threadedLibc, threadedHit, threadedHit - threadedLibc);
+
+        if (threads < threadCount && threads * 2 > threadCount)
+        {
+            threads = threadCount / 2; // so the last row is threadCount
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    size_t opens = argc > 1 ? strtoull(argv[1], nullptr, 10) : 20000;
+    size_t threadCount = argc > 2 ? strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+    threadCount = threadCount == 0 ? 1 : threadCount;
+    if (opens == 0)
+    {
+        printf("usage: %s [opens] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    char directory[] = "/tmp/fopen_hook_benchmark_XXXXXX";
+    if (mkdtemp(directory) == nullptr || chdir(directory) == -1)
+    {
+        printf("couldn't make a directory for the generated files: %d\n", errno);
+        return 1;
+    }
+
+    std::vector<std::string> hitPaths;
+    std::vector<std::string> missPaths;
+    bool success = generateFiles(directory, hitPaths, missPaths) && benchmark(opens, threadCount, hitPaths, missPaths);
+
+    delaysActive = false;
+    removeFiles(hitPaths, missPaths);
+    chdir("/");
+    rmdir(directory);
+
+    return success ? 0 : 1;
+}
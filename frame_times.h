@@ -0,0 +1,109 @@
+
+#include <cstdint>
+#include <atomic>
+
+static const uint32_t frameTimeRingCapacity = 4096; // power of 2, about a minute of frames at 60 fps
+static const uint32_t frameTimeBucketNanoseconds = 250000;
+static const uint32_t frameTimeBucketCount = 256; // the last bucket has every frame which took 63.75 ms or longer
+static const int64_t frameTimeAfterLoadNanoseconds = 2000000000; // frames this soon after the timer resumes are counted as after a load
+static const uint32_t frameLoadStateCount = 3;
+
+// the same values as AmnesiaTimerFrameState
+enum class FrameLoadState : uint8_t
+{
+    Playing = 0,
+    Loading = 1, // the timer byte wasn't 0
+    AfterLoad = 2 // less than frameTimeAfterLoadNanoseconds after the timer resumed
+};
+
+// one frame, from the swap before it to its own swap. sequence is 0 while the record is being written, like TimerEventRecord
+struct FrameTimeRecord
+{
+    uint32_t sequence;
+    uint8_t loadState; // a FrameLoadState, from when the frame's swap happened
+    uint8_t padding;
+    uint16_t hookedOpens; // files opened through the stdio hooks during the frame, up to 65535
+    alignas(8) int64_t swapNanoseconds; // CLOCK_MONOTONIC
+    alignas(8) int64_t frameNanoseconds;
+    alignas(8) int64_t delayNanoseconds; // how long the tool slept for file delays during the frame, on any thread
+};
+
+struct FrameTimeHistogram
+{
+    alignas(8) uint64_t frames;
+    alignas(8) uint64_t totalNanoseconds;
+    alignas(8) uint64_t longestNanoseconds;
+    alignas(8) uint64_t hookedOpens;
+    alignas(8) uint64_t delayNanoseconds;
+    uint32_t buckets[frameTimeBucketCount]; // frameNanoseconds / frameTimeBucketNanoseconds
+};
+
+// Frame times the tool measures from the game's buffer swaps, in the shared memory after the ToolCounters, at their frameTimesOffset.
+// Every frame is added to the histogram for the load state it ended in, and written to the ring, so timer programs can see how
+// smooth the game is while loading, right after loads and the rest of the time, and how many hooked opens and delays each frame had.
+// The histograms are relaxed atomics like the counters. The ring works like the timer event ring, with frameSequence as how many
+// frames were written, but it isn't a futex and nothing is notified after a frame.
+// Frames are only written by the thread which swaps buffers.
+struct FrameTimes
+{
+    uint32_t frameSequence;
+    uint32_t ringCapacity;
+    uint32_t bucketNanoseconds;
+    uint32_t bucketCount;
+    alignas(8) int64_t afterLoadNanoseconds;
+    uint32_t unused[10]; // so the histograms start on their own cache line
+    FrameTimeHistogram histograms[frameLoadStateCount]; // indexed by FrameLoadState
+    FrameTimeRecord ring[frameTimeRingCapacity];
+};
+
+static_assert(sizeof(FrameTimeRecord) == 32 && sizeof(FrameTimeHistogram) == 1064 && sizeof(FrameTimes) == 64 + (3 * 1064) + (4096 * 32),
+    "timer programs depend on these sizes");
+
+static FrameTimes* frameTimes = nullptr;
+
+// used by timer programs. sequence starts at 1 for the first frame. false if the record was overwritten or isn't written yet
+[[maybe_unused]] static bool readFrameTime(const FrameTimes* times, const uint32_t sequence, FrameTimeRecord& frame)
+{
+    FrameTimeRecord& record = const_cast<FrameTimes*>(times)->ring[(sequence - 1) & (frameTimeRingCapacity - 1)];
+    std::atomic_ref<uint32_t> recordSequence(record.sequence);
+
+    uint32_t sequenceBefore = recordSequence.load(std::memory_order_acquire);
+    frame.loadState = std::atomic_ref<uint8_t>(record.loadState).load(std::memory_order_relaxed);
+    frame.hookedOpens = std::atomic_ref<uint16_t>(record.hookedOpens).load(std::memory_order_relaxed);
+    frame.swapNanoseconds = std::atomic_ref<int64_t>(record.swapNanoseconds).load(std::memory_order_relaxed);
+    frame.frameNanoseconds = std::atomic_ref<int64_t>(record.frameNanoseconds).load(std::memory_order_relaxed);
+    frame.delayNanoseconds = std::atomic_ref<int64_t>(record.delayNanoseconds).load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    frame.sequence = recordSequence.load(std::memory_order_relaxed);
+
+    return sequenceBefore == sequence && frame.sequence == sequence;
+}
+
+// used by timer programs. the frame time that at least fraction of the histogram's frames took or less, rounded up to a whole bucket
+[[maybe_unused]] static int64_t frameTimePercentile(const FrameTimeHistogram& histogram, const double fraction)
+{
+    uint32_t counts[frameTimeBucketCount];
+    uint64_t frames = 0;
+    for (uint32_t i = 0; i < frameTimeBucketCount; i++)
+    {
+        counts[i] = std::atomic_ref<uint32_t>(const_cast<uint32_t&>(histogram.buckets[i])).load(std::memory_order_relaxed);
+        frames += counts[i];
+    }
+    if (frames == 0)
+    {
+        return 0;
+    }
+
+    uint64_t needed = (uint64_t)(fraction * (double)frames + 0.999999);
+    needed = needed == 0 ? 1 : needed;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < frameTimeBucketCount; i++)
+    {
+        seen += counts[i];
+        if (seen >= needed)
+        {
+            return (int64_t)(i + 1) * frameTimeBucketNanoseconds;
+        }
+    }
+    return (int64_t)frameTimeBucketCount * frameTimeBucketNanoseconds;
+}
@@ -0,0 +1,1133 @@
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <x86intrin.h> // __rdtsc
+
+// non_std_functions.h has to be included before this
+
+// Profiles game functions during loads. profiled_functions.txt lists the functions by a byte pattern which is found in the game's
+// executable memory, like the patterns findInstructions looks for, so nothing has to be hand-computed for a new function:
+//     function name / byte pattern, with ?? for bytes which change / how many bytes the function starts after the pattern's start
+// e.g.: cLuaHandler::Load / 55 48 89 e5 41 57 41 56 ?? ?? ?? ?? 53 / 0
+// Each function's first instructions are decoded with decodeX86Instruction and moved into a trampoline near the game's code, with
+// their rip offsets and relative jumps corrected, and a 5 byte jmp to the function's enter probe replaces them. The enter probe
+// saves every register, swaps the function's return address for the exit probe's address and goes to the trampoline, so the
+// function runs normally. The exit probe records the function's enter and exit TSC times in a lock-free ring, and goes back to the
+// real return address. When a load ends, every call which ended during the load is added up and printed on a reporting thread.
+// Functions which are longjmp'd out of are fine, but exceptions can't be thrown through a profiled function, because the unwinder
+// can't find the exit probe. Functions which are jumped back into within their first 5 bytes, or which call something in them, can't be
+// profiled.
+
+[[maybe_unused]] static bool functionProbesActive = false;
+static const char functionProbesFileName[] = "profiled_functions.txt";
+static const size_t maxFunctionProbes = 32;
+static const size_t functionProbeNameSize = 48;
+static const size_t functionProbePatternSize = 64;
+static const size_t functionProbeBlockSize = 256; // enter probe and trampoline for one function
+static const size_t functionProbeStackSize = 256; // how deep profiled functions can call each other on one thread
+static const size_t functionProbeRingCapacity = 1 << 16; // has to be a power of 2
+
+// the parts of an x86 instruction which have to be changed when it's moved
+struct X86Instruction
+{
+    uint32_t length = 0;
+    uint32_t ripDisplacementIndex = 0; // where a rip-relative disp32 is, 0 if there isn't one
+    uint32_t branchIndex = 0; // where a relative jump or call's offset is, 0 if it isn't one
+    uint32_t branchSize = 0; // 1 or 4
+    bool conditionalBranch = false;
+    bool movableBranch = true; // loop and jrcxz only have 8-bit offsets, so they can't be moved
+    bool endsFunction = false; // ret, jmp, int3, hlt, ud2. the bytes after it might be another function
+    bool call = false; // the function called would get the trampoline's address as its return address
+};
+
+static bool x86OneByteHasModrm(const unsigned char op)
+{
+    if (op < 0x40)
+    {
+        return (op & 7) < 4;
+    }
+    return op == 0x62 || op == 0x63 || op == 0x69 || op == 0x6b || (op >= 0x80 && op <= 0x8f) || op == 0xc0 || op == 0xc1
+        || (op >= 0xc4 && op <= 0xc7) || (op >= 0xd0 && op <= 0xd3) || (op >= 0xd8 && op <= 0xdf) || op == 0xf6 || op == 0xf7
+        || op == 0xfe || op == 0xff;
+}
+
+static bool x86TwoByteHasModrm(const unsigned char op)
+{
+    return !(op == 0x05 || op == 0x06 || op == 0x07 || op == 0x08 || op == 0x09 || op == 0x0b || op == 0x0e || (op >= 0x30 && op <= 0x37)
+        || op == 0x77 || (op >= 0x80 && op <= 0x8f) || op == 0xa0 || op == 0xa1 || op == 0xa2 || op == 0xa8 || op == 0xa9 || op == 0xaa
+        || (op >= 0xc8 && op <= 0xcf));
+}
+
+// A length decoder for the general purpose, x87, MMX and SSE instructions compilers put in function prologues, in 64-bit or
+// 32-bit mode. Returns false for instructions it can't decode (VEX, EVEX and XOP instructions, 16-bit addressing, far jumps in
+// 64-bit mode), which just means the function can't be profiled.
+static bool decodeX86Instruction(const unsigned char* code, const bool mode64, X86Instruction& instruction)
+{
+    instruction = X86Instruction{};
+    uint32_t i = 0;
+    bool operandSize16 = false;
+    bool addressSizeOverride = false;
+    bool rexW = false;
+
+    for (; i < 14; i++)
+    {
+        unsigned char prefix = code[i];
+        if (prefix == 0x66)
+        {
+            operandSize16 = true;
+        }
+        else if (prefix == 0x67)
+        {
+            addressSizeOverride = true;
+        }
+        else if (!(prefix == 0xf0 || prefix == 0xf2 || prefix == 0xf3 || prefix == 0x2e || prefix == 0x36 || prefix == 0x3e
+            || prefix == 0x26 || prefix == 0x64 || prefix == 0x65))
+        {
+            break;
+        }
+    }
+    if (mode64 && (code[i] & 0xf0) == 0x40)
+    {
+        rexW = (code[i] & 0x08) != 0;
+        i++;
+    }
+
+    uint32_t immediateSize = 0;
+    uint32_t fullImmediateSize = operandSize16 ? 2 : 4;
+    bool hasModrm = false;
+    unsigned char op = code[i++];
+    unsigned char modrmReg = (unsigned char)((code[i] >> 3) & 7); // only used if the instruction has a modrm byte
+
+    if (op == 0x0f)
+    {
+        unsigned char op2 = code[i++];
+        if (op2 == 0x38)
+        {
+            i++;
+            hasModrm = true;
+        }
+        else if (op2 == 0x3a)
+        {
+            i++;
+            hasModrm = true;
+            immediateSize = 1;
+        }
+        else
+        {
+            hasModrm = x86TwoByteHasModrm(op2);
+            if ((op2 >= 0x70 && op2 <= 0x73) || op2 == 0xa4 || op2 == 0xac || op2 == 0xba || op2 == 0xc2 || (op2 >= 0xc4 && op2 <= 0xc6)
+                || op2 == 0x0f) // 3DNow! has its opcode after the modrm byte
+            {
+                immediateSize = 1;
+            }
+            else if (op2 >= 0x80 && op2 <= 0x8f) // jcc rel32
+            {
+                if (operandSize16)
+                {
+                    return false;
+                }
+                instruction.conditionalBranch = true;
+                instruction.branchSize = 4;
+                immediateSize = 4;
+            }
+            instruction.endsFunction = op2 == 0x0b;
+        }
+        modrmReg = (unsigned char)((code[i] >> 3) & 7);
+    }
+    else
+    {
+        if (mode64 && (op == 0x06 || op == 0x07 || op == 0x0e || op == 0x16 || op == 0x17 || op == 0x1e || op == 0x1f || op == 0x27
+            || op == 0x2f || op == 0x37 || op == 0x3f || op == 0x60 || op == 0x61 || op == 0x62 || op == 0x82 || op == 0x9a
+            || op == 0xc4 || op == 0xc5 || op == 0xce || op == 0xd4 || op == 0xd5 || op == 0xd6 || op == 0xea))
+        {
+            return false; // not valid in 64-bit mode, or VEX and EVEX prefixes
+        }
+        if (!mode64 && (op == 0x62 || op == 0xc4 || op == 0xc5) && (code[i] & 0xc0) == 0xc0)
+        {
+            return false; // VEX and EVEX prefixes instead of bound, les and lds
+        }
+        if (op == 0x8f && modrmReg != 0)
+        {
+            return false; // XOP
+        }
+
+        hasModrm = x86OneByteHasModrm(op);
+        if ((op < 0x40 && (op & 7) == 4) || op == 0x6a || op == 0x6b || op == 0x80 || op == 0x82 || op == 0x83 || op == 0xa8
+            || (op >= 0xb0 && op <= 0xb7) || op == 0xc0 || op == 0xc1 || op == 0xc6 || op == 0xcd || op == 0xd4 || op == 0xd5
+            || (op >= 0xe4 && op <= 0xe7) || (op == 0xf6 && modrmReg < 2))
+        {
+            immediateSize = 1;
+        }
+        else if ((op < 0x40 && (op & 7) == 5) || op == 0x68 || op == 0x69 || op == 0x81 || op == 0xa9 || op == 0xc7
+            || (op == 0xf7 && modrmReg < 2))
+        {
+            immediateSize = fullImmediateSize;
+        }
+        else if (op >= 0xb8 && op <= 0xbf)
+        {
+            immediateSize = rexW ? 8 : fullImmediateSize;
+        }
+        else if (op == 0xc2 || op == 0xca)
+        {
+            immediateSize = 2;
+        }
+        else if (op == 0xc8)
+        {
+            immediateSize = 3;
+        }
+        else if (op >= 0xa0 && op <= 0xa3) // mov with a memory offset instead of a modrm byte
+        {
+            immediateSize = mode64 ? (addressSizeOverride ? 4 : 8) : (addressSizeOverride ? 2 : 4);
+        }
+        else if (op == 0x9a || op == 0xea)
+        {
+            immediateSize = fullImmediateSize + 2;
+        }
+        else if ((op >= 0x70 && op <= 0x7f) || (op >= 0xe0 && op <= 0xe3) || op == 0xeb) // jcc, loop, jrcxz and jmp rel8
+        {
+            instruction.conditionalBranch = op != 0xeb;
+            instruction.movableBranch = !(op >= 0xe0 && op <= 0xe3);
+            instruction.branchSize = 1;
+            immediateSize = 1;
+        }
+        else if (op == 0xe8 || op == 0xe9) // call and jmp rel32
+        {
+            if (operandSize16)
+            {
+                return false;
+            }
+            instruction.branchSize = 4;
+            immediateSize = 4;
+        }
+
+        instruction.call = op == 0xe8 || op == 0x9a || (op == 0xff && (modrmReg == 2 || modrmReg == 3));
+        instruction.endsFunction = op == 0xc3 || op == 0xc2 || op == 0xcb || op == 0xca || op == 0xcc || op == 0xe9 || op == 0xeb
+            || op == 0xf4 || (op == 0xff && (modrmReg == 4 || modrmReg == 5));
+    }
+
+    if (hasModrm)
+    {
+        if (addressSizeOverride && !mode64)
+        {
+            return false; // 16-bit addressing
+        }
+
+        unsigned char modrm = code[i++];
+        unsigned char mod = (unsigned char)(modrm >> 6);
+        unsigned char rm = (unsigned char)(modrm & 7);
+        if (mod != 3)
+        {
+            if (rm == 4)
+            {
+                unsigned char sib = code[i++];
+                if (mod == 0 && (sib & 7) == 5)
+                {
+                    i += 4;
+                }
+            }
+            else if (mod == 0 && rm == 5)
+            {
+                if (mode64)
+                {
+                    instruction.ripDisplacementIndex = i;
+                }
+                i += 4;
+            }
+            i += mod == 1 ? 1 : (mod == 2 ? 4 : 0);
+        }
+    }
+
+    if (instruction.branchSize != 0)
+    {
+        instruction.branchIndex = i;
+    }
+    i += immediateSize;
+
+    if (i > 15)
+    {
+        return false;
+    }
+    instruction.length = i;
+    return true;
+}
+
+static bool fitsInInt32(const int64_t value)
+{
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+// Copies whole instructions from source to destination until at least minimumBytes are copied, correcting rip offsets and relative
+// jumps for the instructions' new address, and widening 8-bit jumps to 32-bit ones. Returns how many bytes of source were copied,
+// or 0 if they can't be moved. destinationSize is how many bytes were written.
+static size_t relocateX86Instructions(const unsigned char* source, const size_t minimumBytes, unsigned char* destination, size_t& destinationSize,
+    const bool mode64, const char*& whyNot)
+{
+    size_t sourceSize = 0;
+    destinationSize = 0;
+    uintptr_t branchTargets[16]{}; // checked once it's known how many bytes are moved
+    size_t branchCount = 0;
+
+    while (sourceSize < minimumBytes)
+    {
+        X86Instruction instruction;
+        const unsigned char* from = source + sourceSize;
+        unsigned char* to = destination + destinationSize;
+        if (!decodeX86Instruction(from, mode64, instruction))
+        {
+            whyNot = "an instruction couldn't be decoded";
+            return 0;
+        }
+        if (instruction.endsFunction && sourceSize + instruction.length < minimumBytes)
+        {
+            whyNot = "the function is too short";
+            return 0;
+        }
+        // 32-bit code finds its GOT from the return address of a call at the start, like call __x86.get_pc_thunk.bx,
+        // which would be the trampoline's address instead of the function's
+        if (instruction.call)
+        {
+            whyNot = "it starts with a call instruction";
+            return 0;
+        }
+
+        if (instruction.branchSize != 0)
+        {
+            if (!instruction.movableBranch)
+            {
+                whyNot = "it starts with a loop or jrcxz instruction";
+                return 0;
+            }
+
+            int32_t offset = 0;
+            if (instruction.branchSize == 1)
+            {
+                offset = (int8_t)from[instruction.branchIndex];
+            }
+            else
+            {
+                memcpy(&offset, from + instruction.branchIndex, sizeof(offset));
+            }
+            uintptr_t target = (uintptr_t)from + instruction.length + (intptr_t)offset;
+            branchTargets[branchCount++] = target;
+
+            size_t newLength = instruction.length;
+            if (instruction.branchSize == 1) // jmp rel8 becomes jmp rel32, and jcc rel8 becomes jcc rel32
+            {
+                size_t prefixes = instruction.branchIndex - 1;
+                memcpy(to, from, prefixes);
+                if (instruction.conditionalBranch)
+                {
+                    to[prefixes] = 0x0f;
+                    to[prefixes + 1] = (unsigned char)(0x80 | (from[prefixes] & 0x0f));
+                    newLength = prefixes + 6;
+                }
+                else
+                {
+                    to[prefixes] = 0xe9;
+                    newLength = prefixes + 5;
+                }
+            }
+            else
+            {
+                memcpy(to, from, instruction.length);
+            }
+
+            int64_t newOffset = (int64_t)(target - ((uintptr_t)to + newLength));
+            if (mode64 && !fitsInInt32(newOffset))
+            {
+                whyNot = "the trampoline is too far from a jump's target";
+                return 0;
+            }
+            int32_t newOffset32 = (int32_t)newOffset;
+            memcpy(to + newLength - 4, &newOffset32, sizeof(newOffset32));
+            destinationSize += newLength;
+        }
+        else
+        {
+            memcpy(to, from, instruction.length);
+            if (instruction.ripDisplacementIndex != 0)
+            {
+                int32_t displacement = 0;
+                memcpy(&displacement, from + instruction.ripDisplacementIndex, sizeof(displacement));
+                int64_t newDisplacement = (int64_t)displacement + (int64_t)((intptr_t)from - (intptr_t)to);
+                if (!fitsInInt32(newDisplacement))
+                {
+                    whyNot = "the trampoline is too far from a rip-relative address";
+                    return 0;
+                }
+                int32_t newDisplacement32 = (int32_t)newDisplacement;
+                memcpy(to + instruction.ripDisplacementIndex, &newDisplacement32, sizeof(newDisplacement32));
+            }
+            destinationSize += instruction.length;
+        }
+
+        sourceSize += instruction.length;
+    }
+
+    for (size_t i = 0; i < branchCount; i++)
+    {
+        if (branchTargets[i] >= (uintptr_t)source && branchTargets[i] < (uintptr_t)source + sourceSize)
+        {
+            whyNot = "it jumps into its first instructions";
+            return 0;
+        }
+    }
+
+    return sourceSize;
+}
+
+// one call of a profiled function, written by whichever thread the call ended on
+struct FunctionProbeRecord
+{
+    alignas(8) uint64_t sequence; // 2 * index + 2 once it's written, odd while it's being written
+    alignas(8) uint64_t enterTsc;
+    alignas(8) uint64_t exitTsc;
+    uint32_t probeIndex;
+    uint32_t nested; // 1 if the function was already running on this thread, so its time is already in the outer call's
+};
+
+// a profiled call which hasn't returned yet. returnSlot is where the return address was on the stack
+struct FunctionProbeFrame
+{
+    uintptr_t returnAddress;
+    uintptr_t* returnSlot;
+    uint64_t enterTsc;
+    uint32_t probeIndex;
+};
+
+static thread_local FunctionProbeFrame functionProbeStack[functionProbeStackSize];
+static thread_local size_t functionProbeDepth = 0;
+static thread_local uint32_t functionProbeRunning[maxFunctionProbes]; // how many times each function is on this thread's stack
+
+static FunctionProbeRecord* functionProbeRing = nullptr;
+static std::atomic<uint64_t> functionProbeWriteIndex = 0;
+static std::atomic<uint64_t> functionProbeTooDeep = 0;
+static uintptr_t functionProbeExitAddress = 0;
+
+// frames that a longjmp left, so the stack of frames stays in the order of the real stack
+static void forgetFunctionProbeFrame()
+{
+    functionProbeDepth--;
+    functionProbeRunning[functionProbeStack[functionProbeDepth].probeIndex]--;
+}
+
+// called by a function's enter probe, which saves every register before calling this
+static void functionProbeEnter(const uint32_t probeIndex, uintptr_t* returnSlot)
+{
+    // a call that hasn't returned has its return address higher in the stack than any newer call's
+    while (functionProbeDepth != 0 && functionProbeStack[functionProbeDepth - 1].returnSlot <= returnSlot)
+    {
+        forgetFunctionProbeFrame();
+    }
+    if (functionProbeDepth == functionProbeStackSize)
+    {
+        functionProbeTooDeep.fetch_add(1, std::memory_order_relaxed);
+        return; // the call isn't profiled, but it still runs
+    }
+
+    FunctionProbeFrame& frame = functionProbeStack[functionProbeDepth];
+    frame.returnAddress = *returnSlot;
+    frame.returnSlot = returnSlot;
+    frame.probeIndex = probeIndex;
+    functionProbeDepth++;
+    functionProbeRunning[probeIndex]++;
+    *returnSlot = functionProbeExitAddress;
+    frame.enterTsc = __rdtsc();
+}
+
+// called by the exit probe, which saves every register before calling this. the exit probe's space for the return address is
+// where the function's return address was, or a few bytes higher if the function popped its arguments with ret n, like 32 bit
+// functions returning a struct do
+static void functionProbeExit(uintptr_t* returnSlot)
+{
+    uint64_t exitTsc = __rdtsc();
+
+    // frames deeper in the stack than this one were longjmp'd out of. the frame below is the caller's, which is always higher
+    while (functionProbeDepth > 1 && functionProbeStack[functionProbeDepth - 2].returnSlot <= returnSlot)
+    {
+        forgetFunctionProbeFrame();
+    }
+    if (functionProbeDepth == 0 || functionProbeStack[functionProbeDepth - 1].returnSlot > returnSlot
+        || (uintptr_t)returnSlot - (uintptr_t)functionProbeStack[functionProbeDepth - 1].returnSlot > 64)
+    {
+        printCstr("ERROR: a profiled function returned to the exit probe without entering it, the game can't continue\n");
+        abort();
+    }
+
+    functionProbeDepth--;
+    const FunctionProbeFrame& frame = functionProbeStack[functionProbeDepth];
+    *returnSlot = frame.returnAddress;
+    uint32_t nested = --functionProbeRunning[frame.probeIndex] != 0;
+
+    uint64_t index = functionProbeWriteIndex.fetch_add(1, std::memory_order_relaxed);
+    FunctionProbeRecord& record = functionProbeRing[index & (functionProbeRingCapacity - 1)];
+    std::atomic_ref<uint64_t> recordSequence(record.sequence);
+    recordSequence.store((2 * index) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::atomic_ref<uint64_t>(record.enterTsc).store(frame.enterTsc, std::memory_order_relaxed);
+    std::atomic_ref<uint64_t>(record.exitTsc).store(exitTsc, std::memory_order_relaxed);
+    std::atomic_ref<uint32_t>(record.probeIndex).store(frame.probeIndex, std::memory_order_relaxed);
+    std::atomic_ref<uint32_t>(record.nested).store(nested, std::memory_order_relaxed);
+    recordSequence.store((2 * index) + 2, std::memory_order_release);
+}
+
+// false if the record was overwritten before it could be read
+static bool readFunctionProbeRecord(const uint64_t index, FunctionProbeRecord& copy)
+{
+    FunctionProbeRecord& record = functionProbeRing[index & (functionProbeRingCapacity - 1)];
+    std::atomic_ref<uint64_t> recordSequence(record.sequence);
+    if (recordSequence.load(std::memory_order_acquire) != (2 * index) + 2)
+    {
+        return false;
+    }
+    copy.enterTsc = std::atomic_ref<uint64_t>(record.enterTsc).load(std::memory_order_relaxed);
+    copy.exitTsc = std::atomic_ref<uint64_t>(record.exitTsc).load(std::memory_order_relaxed);
+    copy.probeIndex = std::atomic_ref<uint32_t>(record.probeIndex).load(std::memory_order_relaxed);
+    copy.nested = std::atomic_ref<uint32_t>(record.nested).load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return recordSequence.load(std::memory_order_relaxed) == (2 * index) + 2;
+}
+
+#if __x86_64__ || __ppc64__
+static const bool functionProbesMode64 = true;
+static const size_t functionProbeEnterIndexOffset = 35;
+static const size_t functionProbeEnterFunctionOffset = 45;
+static const size_t functionProbeEnterJumpOffset = 78;
+static const size_t functionProbeExitFunctionOffset = 41;
+
+// for both probes, the return address is at rbp + 88 after the registers are saved
+static const unsigned char functionProbeEnterInstructions[] = {
+    0x9c,                                                           // 0000 // pushfq
+    0x50,                                                           // 0001 // push rax
+    0x51,                                                           // 0002 // push rcx
+    0x52,                                                           // 0003 // push rdx
+    0x56,                                                           // 0004 // push rsi
+    0x57,                                                           // 0005 // push rdi
+    0x41, 0x50,                                                     // 0006 // push r8
+    0x41, 0x51,                                                     // 0008 // push r9
+    0x41, 0x52,                                                     // 0010 // push r10
+    0x41, 0x53,                                                     // 0012 // push r11
+    0x55,                                                           // 0014 // push rbp
+    0x48, 0x89, 0xe5,                                               // 0015 // mov rbp, rsp
+    0x48, 0x83, 0xe4, 0xf0,                                         // 0018 // and rsp, -16 // stack is aligned by 16 for function call
+    0x48, 0x81, 0xec, 0x00, 0x02, 0x00, 0x00,                       // 0022 // sub rsp, 512
+    0x0f, 0xae, 0x04, 0x24,                                         // 0029 // fxsave [rsp] // xmm registers, which hold float arguments
+    0xfc,                                                           // 0033 // cld
+    0xbf, 0x00, 0x00, 0x00, 0x00,                                   // 0034 // mov edi, probe index
+    0x48, 0x8d, 0x75, 0x58,                                         // 0039 // lea rsi, [rbp + 88] // return address
+    0x48, 0xb8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0043 // mov rax, functionProbeEnter address
+    0xff, 0xd0,                                                     // 0053 // call rax
+    0x0f, 0xae, 0x0c, 0x24,                                         // 0055 // fxrstor [rsp]
+    0x48, 0x89, 0xec,                                               // 0059 // mov rsp, rbp
+    0x5d,                                                           // 0062 // pop rbp
+    0x41, 0x5b,                                                     // 0063 // pop r11
+    0x41, 0x5a,                                                     // 0065 // pop r10
+    0x41, 0x59,                                                     // 0067 // pop r9
+    0x41, 0x58,                                                     // 0069 // pop r8
+    0x5f,                                                           // 0071 // pop rdi
+    0x5e,                                                           // 0072 // pop rsi
+    0x5a,                                                           // 0073 // pop rdx
+    0x59,                                                           // 0074 // pop rcx
+    0x58,                                                           // 0075 // pop rax
+    0x9d,                                                           // 0076 // popfq
+    0xe9, 0x00, 0x00, 0x00, 0x00,                                   // 0077 // jmp trampoline
+};
+
+// rax, rdx, xmm0, xmm1 and st0 hold the function's return value, so they're saved too
+static const unsigned char functionProbeExitInstructions[] = {
+    0x50,                                                           // 0000 // push rax // space for the return address
+    0x9c,                                                           // 0001 // pushfq
+    0x50,                                                           // 0002 // push rax
+    0x51,                                                           // 0003 // push rcx
+    0x52,                                                           // 0004 // push rdx
+    0x56,                                                           // 0005 // push rsi
+    0x57,                                                           // 0006 // push rdi
+    0x41, 0x50,                                                     // 0007 // push r8
+    0x41, 0x51,                                                     // 0009 // push r9
+    0x41, 0x52,                                                     // 0011 // push r10
+    0x41, 0x53,                                                     // 0013 // push r11
+    0x55,                                                           // 0015 // push rbp
+    0x48, 0x89, 0xe5,                                               // 0016 // mov rbp, rsp
+    0x48, 0x83, 0xe4, 0xf0,                                         // 0019 // and rsp, -16
+    0x48, 0x81, 0xec, 0x00, 0x02, 0x00, 0x00,                       // 0023 // sub rsp, 512
+    0x0f, 0xae, 0x04, 0x24,                                         // 0030 // fxsave [rsp]
+    0xfc,                                                           // 0034 // cld
+    0x48, 0x8d, 0x7d, 0x58,                                         // 0035 // lea rdi, [rbp + 88] // space for the return address
+    0x48, 0xb8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 0039 // mov rax, functionProbeExit address
+    0xff, 0xd0,                                                     // 0049 // call rax
+    0x0f, 0xae, 0x0c, 0x24,                                         // 0051 // fxrstor [rsp]
+    0x48, 0x89, 0xec,                                               // 0055 // mov rsp, rbp
+    0x5d,                                                           // 0058 // pop rbp
+    0x41, 0x5b,                                                     // 0059 // pop r11
+    0x41, 0x5a,                                                     // 0061 // pop r10
+    0x41, 0x59,                                                     // 0063 // pop r9
+    0x41, 0x58,                                                     // 0065 // pop r8
+    0x5f,                                                           // 0067 // pop rdi
+    0x5e,                                                           // 0068 // pop rsi
+    0x5a,                                                           // 0069 // pop rdx
+    0x59,                                                           // 0070 // pop rcx
+    0x58,                                                           // 0071 // pop rax
+    0x9d,                                                           // 0072 // popfq
+    0xc3,                                                           // 0073 // ret // to the function's return address
+};
+#else
+static const bool functionProbesMode64 = false;
+static const size_t functionProbeEnterIndexOffset = 29;
+static const size_t functionProbeEnterFunctionOffset = 34;
+static const size_t functionProbeEnterJumpOffset = 50;
+static const size_t functionProbeExitFunctionOffset = 27;
+
+// for both probes, the return address is at ebp + 36 after the registers are saved
+static const unsigned char functionProbeEnterInstructions[] = {
+    0x9c,                                                           // 0000 // pushfd
+    0x60,                                                           // 0001 // pushad
+    0x89, 0xe5,                                                     // 0002 // mov ebp, esp
+    0x83, 0xe4, 0xf0,                                               // 0004 // and esp, -16 // stack is aligned by 16 for function call
+    0x81, 0xec, 0x10, 0x02, 0x00, 0x00,                             // 0007 // sub esp, 528 // 512 for fxsave and 16 for arguments
+    0x0f, 0xae, 0x44, 0x24, 0x10,                                   // 0013 // fxsave [esp + 16]
+    0xfc,                                                           // 0018 // cld
+    0x8d, 0x45, 0x24,                                               // 0019 // lea eax, [ebp + 36] // return address
+    0x89, 0x44, 0x24, 0x04,                                         // 0022 // mov dword ptr [esp + 4], eax
+    0xc7, 0x04, 0x24, 0x00, 0x00, 0x00, 0x00,                       // 0026 // mov dword ptr [esp], probe index
+    0xb8, 0x00, 0x00, 0x00, 0x00,                                   // 0033 // mov eax, functionProbeEnter address
+    0xff, 0xd0,                                                     // 0038 // call eax
+    0x0f, 0xae, 0x4c, 0x24, 0x10,                                   // 0040 // fxrstor [esp + 16]
+    0x89, 0xec,                                                     // 0045 // mov esp, ebp
+    0x61,                                                           // 0047 // popad
+    0x9d,                                                           // 0048 // popfd
+    0xe9, 0x00, 0x00, 0x00, 0x00,                                   // 0049 // jmp trampoline
+};
+
+// eax, edx and st0 hold the function's return value, so they're saved too
+static const unsigned char functionProbeExitInstructions[] = {
+    0x50,                                                           // 0000 // push eax // space for the return address
+    0x9c,                                                           // 0001 // pushfd
+    0x60,                                                           // 0002 // pushad
+    0x89, 0xe5,                                                     // 0003 // mov ebp, esp
+    0x83, 0xe4, 0xf0,                                               // 0005 // and esp, -16
+    0x81, 0xec, 0x10, 0x02, 0x00, 0x00,                             // 0008 // sub esp, 528
+    0x0f, 0xae, 0x44, 0x24, 0x10,                                   // 0014 // fxsave [esp + 16]
+    0xfc,                                                           // 0019 // cld
+    0x8d, 0x45, 0x24,                                               // 0020 // lea eax, [ebp + 36] // space for the return address
+    0x89, 0x04, 0x24,                                               // 0023 // mov dword ptr [esp], eax
+    0xb8, 0x00, 0x00, 0x00, 0x00,                                   // 0026 // mov eax, functionProbeExit address
+    0xff, 0xd0,                                                     // 0031 // call eax
+    0x0f, 0xae, 0x4c, 0x24, 0x10,                                   // 0033 // fxrstor [esp + 16]
+    0x89, 0xec,                                                     // 0038 // mov esp, ebp
+    0x61,                                                           // 0040 // popad
+    0x9d,                                                           // 0041 // popfd
+    0xc3,                                                           // 0042 // ret // to the function's return address
+};
+#endif
+
+static_assert(sizeof(functionProbeEnterInstructions) <= 96 && sizeof(functionProbeExitInstructions) <= functionProbeBlockSize,
+    "the trampolines start 96 bytes into each block");
+
+struct FunctionProbeSite
+{
+    char name[functionProbeNameSize];
+    unsigned char pattern[functionProbePatternSize];
+    bool wildcard[functionProbePatternSize];
+    size_t patternSize;
+    intptr_t offset;
+};
+
+struct FunctionProbeTotals
+{
+    uint64_t calls;
+    uint64_t totalTicks; // only counting the part of each call which was during the load
+    uint64_t longestTicks;
+};
+
+static FunctionProbeSite functionProbeSites[maxFunctionProbes];
+static size_t functionProbeCount = 0;
+static uint64_t functionProbeStartTsc = 0; // for finding the TSC frequency
+static int64_t functionProbeStartNanoseconds = 0;
+
+static int64_t functionProbeNanoseconds()
+{
+    struct timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+static int hexDigitValue(const char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static bool isProbeLineWhitespace(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// name / pattern / offset
+static bool parseFunctionProbeLine(const char* line, const size_t lineSize, FunctionProbeSite& site)
+{
+    site = FunctionProbeSite{};
+    const char* end = line + lineSize;
+    const char* firstSlash = (const char*)memchr(line, '/', lineSize);
+    const char* secondSlash = firstSlash != nullptr ? (const char*)memchr(firstSlash + 1, '/', (size_t)(end - (firstSlash + 1))) : nullptr;
+    if (secondSlash == nullptr)
+    {
+        return false;
+    }
+
+    const char* nameStart = line;
+    const char* nameEnd = firstSlash;
+    for (; nameStart < nameEnd && isProbeLineWhitespace(*nameStart); nameStart++);
+    for (; nameEnd > nameStart && isProbeLineWhitespace(nameEnd[-1]); nameEnd--);
+    size_t nameSize = (size_t)(nameEnd - nameStart) < functionProbeNameSize - 1 ? (size_t)(nameEnd - nameStart) : functionProbeNameSize - 1;
+    if (nameSize == 0)
+    {
+        return false;
+    }
+    memcpy(site.name, nameStart, nameSize);
+
+    for (const char* c = firstSlash + 1; c < secondSlash; c++)
+    {
+        if (isProbeLineWhitespace(*c))
+        {
+            continue;
+        }
+        if (c + 1 >= secondSlash || site.patternSize == functionProbePatternSize)
+        {
+            return false;
+        }
+        if (c[0] == '?' && c[1] == '?')
+        {
+            site.wildcard[site.patternSize] = true;
+        }
+        else if (hexDigitValue(c[0]) >= 0 && hexDigitValue(c[1]) >= 0)
+        {
+            site.pattern[site.patternSize] = (unsigned char)((hexDigitValue(c[0]) << 4) | hexDigitValue(c[1]));
+        }
+        else
+        {
+            return false;
+        }
+        site.patternSize++;
+        c++;
+    }
+    if (site.patternSize == 0 || site.wildcard[0])
+    {
+        return false; // the first byte is searched for with memchr
+    }
+
+    const char* c = secondSlash + 1;
+    for (; c < end && isProbeLineWhitespace(*c); c++);
+    bool negative = c < end && *c == '-';
+    c += negative;
+    size_t offset = 0;
+    for (; c < end && *c >= '0' && *c <= '9' && offset < 0x10000000; c++)
+    {
+        offset = (offset * 10) + (size_t)(*c - '0');
+    }
+    site.offset = negative ? -(intptr_t)offset : (intptr_t)offset;
+    return true;
+}
+
+// returns how many places the pattern was found, and the first one
+static size_t findFunctionProbePattern(const FunctionProbeSite& site, unsigned char* gameStart, const size_t gameSize, unsigned char*& found)
+{
+    size_t matches = 0;
+    unsigned char* end = gameStart + gameSize - site.patternSize;
+    for (unsigned char* candidate = gameStart; candidate <= end; candidate++)
+    {
+        candidate = (unsigned char*)memchr(candidate, site.pattern[0], (size_t)(end - candidate) + 1);
+        if (candidate == nullptr)
+        {
+            break;
+        }
+
+        size_t i = 1;
+        for (; i < site.patternSize && (site.wildcard[i] || candidate[i] == site.pattern[i]); i++);
+        if (i == site.patternSize)
+        {
+            found = matches == 0 ? candidate : found;
+            matches++;
+        }
+    }
+    return matches;
+}
+
+// the enter probes and trampolines are reached with 32-bit jumps from the functions, so in 64-bit mode they have to be within 2 GiB
+static unsigned char* mapFunctionProbeMemory(unsigned char* gameStart, const size_t gameSize, const size_t size)
+{
+    if (!functionProbesMode64)
+    {
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return memory != MAP_FAILED ? (unsigned char*)memory : nullptr;
+    }
+
+    const uintptr_t step = 1 << 20;
+    const uintptr_t gameFirst = (uintptr_t)gameStart;
+    const uintptr_t gameLast = (uintptr_t)gameStart + gameSize;
+    for (uintptr_t distance = step; distance < ((uintptr_t)1 << 31) - gameSize - size; distance += step)
+    {
+        uintptr_t hints[2] = {((gameLast + distance) & ~(step - 1)), gameFirst > distance + size ? ((gameFirst - distance - size) & ~(step - 1)) : 0};
+        for (uintptr_t hint : hints)
+        {
+            if (hint == 0)
+            {
+                continue;
+            }
+
+            void* memory = mmap((void*)hint, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+            {
+                continue;
+            }
+            uintptr_t first = (uintptr_t)memory;
+            uintptr_t last = first + size;
+            if (fitsInInt32((int64_t)(last - gameFirst)) && fitsInInt32((int64_t)(first - gameLast)))
+            {
+                return (unsigned char*)memory;
+            }
+            munmap(memory, size);
+        }
+    }
+    return nullptr;
+}
+
+static bool patchFunctionEntry(unsigned char* function, const size_t stolenSize, const unsigned char* enterProbe)
+{
+    uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t firstPage = (uintptr_t)function & ~(pageSize - 1);
+    size_t protectSize = (size_t)(((uintptr_t)function + stolenSize + pageSize - 1) & ~(pageSize - 1)) - firstPage;
+    if (mprotect((void*)firstPage, protectSize, PROT_READ | PROT_WRITE) != 0)
+    {
+        printCstr("ERROR: mprotect failure when making a profiled function writable: "); printInt(errno); printCstr("\n");
+        return false;
+    }
+
+    int32_t jumpOffset = (int32_t)((intptr_t)enterProbe - ((intptr_t)function + 5));
+    function[0] = 0xe9; // jmp enter probe
+    memcpy(function + 1, &jumpOffset, sizeof(jumpOffset));
+    memset(function + 5, 0xcc, stolenSize - 5); // int3 for the rest of the moved instructions, which are never run here
+
+    if (mprotect((void*)firstPage, protectSize, PROT_READ | PROT_EXEC) != 0)
+    {
+        printCstr("WARNING: mprotect failure when setting a profiled function back to PROT_READ | PROT_EXEC: "); printInt(errno); printCstr("\n");
+    }
+    return true;
+}
+
+// builds the enter probe and trampoline for a function in its block. false if the function's first instructions can't be moved
+static bool buildFunctionProbe(const size_t probeIndex, unsigned char* function, unsigned char* block, size_t& stolenSize, const char*& whyNot)
+{
+    unsigned char* trampoline = block + 96;
+    size_t trampolineSize = 0;
+    stolenSize = relocateX86Instructions(function, 5, trampoline, trampolineSize, functionProbesMode64, whyNot);
+    if (stolenSize == 0)
+    {
+        return false;
+    }
+
+    unsigned char* jumpBack = trampoline + trampolineSize;
+    int32_t jumpBackOffset = (int32_t)((intptr_t)(function + stolenSize) - ((intptr_t)jumpBack + 5));
+    jumpBack[0] = 0xe9; // jmp to the rest of the function
+    memcpy(jumpBack + 1, &jumpBackOffset, sizeof(jumpBackOffset));
+
+    uint32_t index = (uint32_t)probeIndex;
+    uintptr_t enterAddress = (uintptr_t)&functionProbeEnter;
+    int32_t trampolineOffset = (int32_t)((intptr_t)trampoline - ((intptr_t)block + functionProbeEnterJumpOffset + 4));
+    memcpy(block, functionProbeEnterInstructions, sizeof(functionProbeEnterInstructions));
+    memcpy(block + functionProbeEnterIndexOffset, &index, sizeof(index));
+    memcpy(block + functionProbeEnterFunctionOffset, &enterAddress, sizeof(enterAddress));
+    memcpy(block + functionProbeEnterJumpOffset, &trampolineOffset, sizeof(trampolineOffset));
+    return true;
+}
+
+// reads profiled_functions.txt, finds each function in the game's executable memory and profiles it. the game's threads can't
+// be running yet, because the functions' first bytes are replaced
+[[maybe_unused]] static void installFunctionProbes(unsigned char* gameStart, const size_t gameSize)
+{
+    {
+        MappedFileLines lines(functionProbesFileName);
+        const char* line = nullptr;
+        size_t lineSize = 0;
+        while (lines.opened && lines.nextLine(line, lineSize) && functionProbeCount < maxFunctionProbes)
+        {
+            if (lineSize != 0 && line[0] != '#' && !parseFunctionProbeLine(line, lineSize, functionProbeSites[functionProbeCount++]))
+            {
+                functionProbeCount--;
+                printCstr("WARNING: a line in "); printCstr(functionProbesFileName); printCstr(" isn't name / byte pattern / offset\n");
+            }
+        }
+    }
+    if (functionProbeCount == 0)
+    {
+        printCstr("no functions to profile in "); printCstr(functionProbesFileName); printCstr("\n");
+        return;
+    }
+
+    size_t exitProbeSize = (sizeof(functionProbeExitInstructions) + 63) & ~(size_t)63;
+    size_t codeSize = (exitProbeSize + (functionProbeCount * functionProbeBlockSize) + 4095) & ~(size_t)4095;
+    unsigned char* code = mapFunctionProbeMemory(gameStart, gameSize, codeSize);
+    void* ring = mmap(nullptr, functionProbeRingCapacity * sizeof(FunctionProbeRecord), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == nullptr || ring == MAP_FAILED)
+    {
+        printCstr("ERROR: couldn't map memory for the function probes near the game: "); printInt(errno); printCstr("\n");
+        functionProbeCount = 0;
+        return;
+    }
+    functionProbeRing = (FunctionProbeRecord*)ring;
+    memset(code, 0xcc, codeSize);
+
+    uintptr_t exitAddress = (uintptr_t)&functionProbeExit;
+    memcpy(code, functionProbeExitInstructions, sizeof(functionProbeExitInstructions));
+    memcpy(code + functionProbeExitFunctionOffset, &exitAddress, sizeof(exitAddress));
+    functionProbeExitAddress = (uintptr_t)code;
+
+    // the functions are found before any are patched, so a function's pattern can't be broken by patching another one
+    unsigned char* functions[maxFunctionProbes]{};
+    for (size_t i = 0; i < functionProbeCount; i++)
+    {
+        const FunctionProbeSite& site = functionProbeSites[i];
+        unsigned char* found = nullptr;
+        size_t matches = findFunctionProbePattern(site, gameStart, gameSize, found);
+        intptr_t functionOffset = matches == 1 ? (found - gameStart) + site.offset : -1;
+        if (matches != 1 || functionOffset < 0 || (size_t)functionOffset + 32 > gameSize)
+        {
+            printCstr("WARNING: not profiling "); printCstr(site.name); printCstr(", its pattern was found ");
+            printInt(matches); printCstr(matches == 1 ? " time but the offset is outside the game\n" : " times instead of once\n");
+            continue;
+        }
+        functions[i] = gameStart + functionOffset;
+    }
+
+    size_t installed = 0;
+    for (size_t i = 0; i < functionProbeCount; i++)
+    {
+        unsigned char* block = code + exitProbeSize + (i * functionProbeBlockSize);
+        size_t stolenSize = 0;
+        const char* whyNot = "";
+        if (functions[i] == nullptr)
+        {
+            continue;
+        }
+        if (!buildFunctionProbe(i, functions[i], block, stolenSize, whyNot))
+        {
+            printCstr("WARNING: not profiling "); printCstr(functionProbeSites[i].name); printCstr(", "); printCstr(whyNot); printCstr("\n");
+            continue;
+        }
+        if (!patchFunctionEntry(functions[i], stolenSize, block))
+        {
+            continue;
+        }
+        installed++;
+    }
+
+    if (mprotect(code, codeSize, PROT_READ | PROT_EXEC) != 0)
+    {
+        printCstr("ERROR: mprotect failure when making the function probes executable: "); printInt(errno); printCstr("\n");
+        abort(); // the functions already jump to the probes
+    }
+
+    functionProbeStartTsc = __rdtsc();
+    functionProbeStartNanoseconds = functionProbeNanoseconds();
+    printCstr("profiling "); printInt(installed); printCstr(" of "); printInt(functionProbeCount); printCstr(" functions during loads\n");
+}
+
+static const size_t functionProbePendingLoads = 8; // loads waiting to be printed, later ones are dropped
+
+// the calls of one load are the ring's records from startIndex to endIndex
+struct FunctionProbeLoad
+{
+    uint64_t startTsc;
+    uint64_t endTsc;
+    uint64_t startIndex;
+    uint64_t endIndex;
+};
+
+// Adds up and prints each load's calls on its own thread, which is started when the first load pauses the timer, so the game's main
+// thread only hands the load off when the timer resumes. The ring is big enough that the calls are still there when the thread reads
+// them, and ones which were overwritten first are printed as not counted.
+// timerEvent is called from recordTimerEvent on the game's main thread.
+class FunctionProbeReporter
+{
+public:
+    FunctionProbeReporter(const FunctionProbeReporter&) = delete;
+    FunctionProbeReporter& operator=(FunctionProbeReporter other) = delete;
+    FunctionProbeReporter(FunctionProbeReporter&&) = delete;
+    FunctionProbeReporter& operator=(FunctionProbeReporter&&) = delete;
+
+    FunctionProbeReporter() = default;
+
+    ~FunctionProbeReporter()
+    {
+        if (_worker.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopWorker = true; // loads which haven't been printed yet are thrown away
+            }
+            _workAvailable.notify_one();
+            _worker.join();
+        }
+    }
+
+    // a load starts at the first pause after a resume, and its profile is printed when it ends
+    void timerEvent(const uint32_t eventCode)
+    {
+        if (functionProbeRing == nullptr || eventCode == 255)
+        {
+            return;
+        }
+
+        if (eventCode != 0)
+        {
+            if (!_loading)
+            {
+                _loading = true;
+                _load.startTsc = __rdtsc();
+                _load.startIndex = functionProbeWriteIndex.load(std::memory_order_acquire);
+                if (!_worker.joinable()) // started while the timer is paused, so it isn't part of the time the run is timed
+                {
+                    _worker = std::thread(&FunctionProbeReporter::workerLoop, this);
+                }
+            }
+            return;
+        }
+        if (!_loading)
+        {
+            return;
+        }
+        _loading = false;
+
+        _load.endTsc = __rdtsc();
+        _load.endIndex = functionProbeWriteIndex.load(std::memory_order_acquire);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_pendingCount == functionProbePendingLoads)
+            {
+                _droppedLoads++;
+                return;
+            }
+            _pending[(_pendingStart + _pendingCount) % functionProbePendingLoads] = _load;
+            _pendingCount++;
+        }
+        _workAvailable.notify_one();
+    }
+
+private:
+    // only used by the game's main thread
+    bool _loading = false;
+    FunctionProbeLoad _load{};
+
+    std::mutex _mutex;
+    std::condition_variable _workAvailable;
+    std::thread _worker;
+    bool _stopWorker = false;
+    FunctionProbeLoad _pending[functionProbePendingLoads]{};
+    size_t _pendingStart = 0;
+    size_t _pendingCount = 0;
+    size_t _droppedLoads = 0;
+
+    FunctionProbeTotals _totals[maxFunctionProbes]{}; // only used by the reporting thread
+
+    void workerLoop()
+    {
+        while (true)
+        {
+            FunctionProbeLoad load{};
+            size_t droppedLoads = 0;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _workAvailable.wait(lock, [this]() { return _stopWorker || _pendingCount != 0; });
+                if (_stopWorker)
+                {
+                    return;
+                }
+                load = _pending[_pendingStart];
+                _pendingStart = (_pendingStart + 1) % functionProbePendingLoads;
+                _pendingCount--;
+                droppedLoads = _droppedLoads;
+                _droppedLoads = 0;
+            }
+
+            if (droppedLoads != 0)
+            {
+                printCstr("WARNING: "); printInt(droppedLoads); printCstr(" loads weren't profiled because their profiles couldn't be printed fast enough\n");
+            }
+            printLoad(load);
+        }
+    }
+
+    void printLoad(const FunctionProbeLoad& load)
+    {
+        uint64_t readIndex = load.startIndex;
+        uint64_t lost = 0;
+        if (load.endIndex - readIndex > functionProbeRingCapacity)
+        {
+            lost = load.endIndex - readIndex - functionProbeRingCapacity;
+            readIndex = load.endIndex - functionProbeRingCapacity;
+        }
+
+        memset(_totals, 0, sizeof(_totals));
+        for (; readIndex < load.endIndex; readIndex++)
+        {
+            FunctionProbeRecord record{};
+            if (!readFunctionProbeRecord(readIndex, record) || record.probeIndex >= functionProbeCount)
+            {
+                lost++; // overwritten before this read it, or still being written by a thread which was interrupted
+                continue;
+            }
+            uint64_t start = record.enterTsc > load.startTsc ? record.enterTsc : load.startTsc;
+            uint64_t ticks = record.exitTsc > start ? record.exitTsc - start : 0;
+            FunctionProbeTotals& totals = _totals[record.probeIndex];
+            totals.calls++;
+            totals.totalTicks += record.nested ? 0 : ticks;
+            totals.longestTicks = ticks > totals.longestTicks ? ticks : totals.longestTicks;
+        }
+
+        double nanosecondsPerTick = (double)(functionProbeNanoseconds() - functionProbeStartNanoseconds) / (double)(__rdtsc() - functionProbeStartTsc);
+        printCstr("function profile for this load ("); printInt((size_t)((double)(load.endTsc - load.startTsc) * nanosecondsPerTick / 1000.0));
+        printCstr(" us):\n");
+        for (size_t i = 0; i < functionProbeCount; i++)
+        {
+            const FunctionProbeTotals& totals = _totals[i];
+            if (totals.calls == 0)
+            {
+                continue;
+            }
+            printCstr("    "); printCstr(functionProbeSites[i].name); printCstr(": "); printInt(totals.calls); printCstr(" calls, ");
+            printInt((size_t)((double)totals.totalTicks * nanosecondsPerTick / 1000.0)); printCstr(" us, longest ");
+            printInt((size_t)((double)totals.longestTicks * nanosecondsPerTick / 1000.0)); printCstr(" us\n");
+        }
+        if (lost != 0 || functionProbeTooDeep.load(std::memory_order_relaxed) != 0)
+        {
+            printCstr("    "); printInt(lost); printCstr(" calls weren't counted because the record ring was full, ");
+            printInt(functionProbeTooDeep.exchange(0, std::memory_order_relaxed)); printCstr(" because they were too deep\n");
+        }
+    }
+};
+
+static FunctionProbeReporter functionProbeReporter;
+
+// called for every timer event
+[[maybe_unused]] static void reportFunctionProbes(const uint32_t eventCode)
+{
+    functionProbeReporter.timerEvent(eventCode);
+}
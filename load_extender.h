@@ -1,21 +1,20 @@
 
 #include <cstdio>
-#include <climits>
-#include <mutex>
+#include <atomic>
+#include <cstdint>
 #include <thread>
-#include <vector>
-#include <memory>
+#include <chrono>
 #include <cstring>
-#include <charconv>
-#include <stdexcept>
 #include <string_view>
-#include <unordered_map>
 
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE
 #endif
 
 #include <dlfcn.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 
 static auto originalFopen = reinterpret_cast<FILE * (*)(const char* path, const char* mode)>(dlsym(RTLD_NEXT, "fopen"));
 static auto originalFreopen = reinterpret_cast<FILE * (*)(const char* path, const char* mode, FILE * stream)>(dlsym(RTLD_NEXT, "freopen"));
@@ -23,277 +22,298 @@ static auto originalFopen64 = reinterpret_cast<FILE * (*)(const char* path, cons
 static auto originalFreopen64 = reinterpret_cast<FILE * (*)(const char* path, const char* mode, FILE * stream)>(dlsym(RTLD_NEXT, "freopen64"));
 
 static bool delaysActive = false;
-static const char delaysFileName[] = "files_and_delays.txt";
+static const int delaysFileSettleMilliseconds = 50;
 
-struct MapValue
-{
-    // delays[0] == -1 says to reset all MapValue.position to 0
-    // delays ending with -1 says to reset at the end
-    // delays ending with -2 says to NOT reset at the end
-    std::unique_ptr<int[]> delays;
-    size_t position = 0;
-    size_t fullResetCheckNumber = 0;
-
-    explicit MapValue(std::vector<int>& delaysVector) : delays(std::make_unique<int[]>(delaysVector.size()))
-    {
-        memcpy(delays.get(), delaysVector.data(), delaysVector.size() * sizeof(int));
-    }
-};
+// points to the pause/split timer byte once amnesia_tool.cpp has set up the shared memory
+static unsigned char* timerBytePointer = nullptr;
 
-struct KeyCmp
+// A flat delay table, either in amnesia_config_cache.bin or made from files_and_delays.txt when it's reloaded.
+// the table isn't changed after it's made, except for the delay positions and the full reset generation.
+// when files_and_delays.txt is edited a new table replaces it, see DelayTableWatcher.
+class DelayTable
 {
-    using is_transparent = void;
+public:
+    DelayTable(const DelayTable&) = delete;
+    DelayTable& operator=(DelayTable other) = delete;
+    DelayTable(DelayTable&&) = delete;
+    DelayTable& operator=(DelayTable&&) = delete;
 
-    bool operator()(const std::unique_ptr<char[]>& cstr1, const std::unique_ptr<char[]>& cstr2) const
+    // parses files_and_delays.txt
+    DelayTable()
     {
-        return strcmp(cstr1.get(), cstr2.get()) == 0;
+        // copied instead of mapped, because the file can be saved again while it's being parsed
+        if (buildFlatDelayTable(_ownedTable, delaysFileName, true))
+        {
+            _table = _ownedTable.data;
+        }
     }
 
-    bool operator()(const std::unique_ptr<char[]>& cstr, const std::string_view sv) const
+    // uses a table which something else owns, like the config cache, without copying it
+    explicit DelayTable(unsigned char* flatTable) : _table(flatTable)
     {
-        return strcmp(cstr.get(), sv.data()) == 0;
     }
 
-    bool operator()(const std::string_view sv, const std::unique_ptr<char[]>& cstr) const
+    size_t fileCount() const
     {
-        return strcmp(sv.data(), cstr.get()) == 0;
+        return _table != nullptr ? ((const FlatDelayTableHeader*)_table)->fileCount : 0;
     }
-};
-
-struct KeyHash
-{
-    using is_transparent = void;
 
-    size_t operator()(const std::string_view sv) const
+    // delays[0] == -1 says to reset all delay positions to 0
+    // delays ending with -1 says to reset at the end
+    // delays ending with -2 says to NOT reset at the end
+    // returns nullptr if the file doesn't have delays
+    const int32_t* findDelays(const std::string_view filename) const
     {
-        return _hashObject(sv);
+        FlatDelaySlot* slot = _table != nullptr ? findFlatDelaySlot(_table, filename) : nullptr;
+        return slot != nullptr ? delaysOf(*slot) : nullptr;
     }
 
-    size_t operator()(const std::unique_ptr<char[]>& cstr) const
+    // returns how many milliseconds to delay, or -1 if the file doesn't have delays.
+    // the caller does the sleeping so the table isn't in use during the delay
+    int takeDelay(const std::string_view filename)
     {
-        // if they add an easy way to do it, change this so it doesn't need to find the c-string length
-        return _hashObject(std::string_view(cstr.get()));
+        FlatDelaySlot* slot = _table != nullptr ? findFlatDelaySlot(_table, filename) : nullptr;
+        if (slot == nullptr)
+        {
+            return -1;
+        }
+        
+        const int32_t* delays = delaysOf(*slot);
+        std::atomic_ref<uint32_t> fullResetGeneration(((FlatDelayTableHeader*)_table)->fullResetGeneration);
+        
+        if (delays[0] == -1)
+        {
+            // every other file's position is reset to 0 the next time it's delayed, because its generation won't match
+            fullResetGeneration.fetch_add(1);
+            return 0;
+        }
+        
+        // the position and generation are packed together so they can be changed with one compare and swap
+        std::atomic_ref<uint64_t> positionAndGeneration(slot->positionAndGeneration);
+        uint32_t generation = fullResetGeneration.load();
+        uint64_t oldPositionAndGeneration = positionAndGeneration.load();
+        
+        while (true)
+        {
+            uint32_t position = (uint32_t)oldPositionAndGeneration;
+            int delay = 0;
+            
+            if ((uint32_t)(oldPositionAndGeneration >> 32) != generation || delays[position] == -1)
+            {
+                position = 0;
+            }
+            
+            if (delays[position] >= 0)
+            {
+                delay = delays[position];
+                position++;
+            }
+            
+            uint64_t newPositionAndGeneration = ((uint64_t)generation << 32) | position;
+            if (positionAndGeneration.compare_exchange_weak(oldPositionAndGeneration, newPositionAndGeneration))
+            {
+                return delay;
+            }
+        }
     }
 
 private:
-    std::hash<std::string_view> _hashObject = std::hash<std::string_view>();
-};
+    GrowableBuffer _ownedTable;
+    unsigned char* _table = nullptr;
 
-using myMapType = std::unordered_map<std::unique_ptr<char[]>, MapValue, KeyHash, KeyCmp>;
+    const int32_t* delaysOf(const FlatDelaySlot& slot) const
+    {
+        return (const int32_t*)(_table + ((const FlatDelayTableHeader*)_table)->delaysOffset) + slot.delaysIndex;
+    }
+};
 
-class MapAndMutex
+// Keeps the current DelayTable and replaces it when files_and_delays.txt is edited.
+// The fopen hooks never take a lock to read the table. Instead, a reader adds itself to the reader count of the current epoch.
+// After a new table is published, the epoch is changed, and the old table is deleted once the old epoch's reader count reaches 0.
+// Readers which started before the epoch changed might be using the old table, and readers which start after can only see the new one.
+class DelayTableWatcher
 {
 public:
-    std::mutex mutexForMap;
-    myMapType fileMap;
-    
-    MapAndMutex()
+    DelayTableWatcher(const DelayTableWatcher&) = delete;
+    DelayTableWatcher& operator=(DelayTableWatcher other) = delete;
+    DelayTableWatcher(DelayTableWatcher&&) = delete;
+    DelayTableWatcher& operator=(DelayTableWatcher&&) = delete;
+
+    // the first table is the one in the config cache if there is one, so files_and_delays.txt usually isn't parsed
+    DelayTableWatcher() : _currentTable(configCache.delayTable() != nullptr ? new DelayTable(configCache.delayTable()) : new DelayTable())
     {
-        try
+        _inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        _stopFd = eventfd(0, EFD_CLOEXEC);
+        if (_inotifyFd == -1 || _stopFd == -1)
         {
-            bool utf16WarningWritten = false;
-
-            // intAsChars used in fillDelaysVector but made here so it doesn't need to be remade repeatedly
-            std::vector<char> intAsChars;
-            intAsChars.reserve(10);
-            intAsChars.push_back('0'); // empty vector causes std::errc::invalid_argument
-            std::vector<char> keyVector;
-            std::vector<int> delaysVector;
-
-            FileHelper fhelper(delaysFileName);
-            if (fhelper.fd == -1) // error message will have been printed in the constructor
-            {
-                return;
-            }
-
-            while (addMapPair(fileMap, keyVector, delaysVector, fhelper, intAsChars));
+            printCstr("WARNING: files_and_delays.txt won't be reloaded when it's edited, inotify_init1 or eventfd failure: "); printInt(errno); printCstr("\n");
+            return;
         }
-        catch (const std::runtime_error& e)
+        
+        // the directory is watched because editors often save by replacing the file, which would end a watch on the file itself
+        if (inotify_add_watch(_inotifyFd, ".", IN_CLOSE_WRITE | IN_MOVED_TO) == -1)
         {
-            char const* fixC4101Warning = e.what();
-            printf("%s\nfiles can't be load extended\n", fixC4101Warning);
-            fileMap.clear(); // clear map so failure is more obvious
+            printCstr("WARNING: files_and_delays.txt won't be reloaded when it's edited, inotify_add_watch failure: "); printInt(errno); printCstr("\n");
+            return;
         }
+        
+        _watcher = std::thread(&DelayTableWatcher::watchForEdits, this);
     }
 
-    bool addMapPair(myMapType& fileMap, std::vector<char>& keyVector, std::vector<int>& delaysVector, FileHelper& fhelper, std::vector<char>& intAsChars)
+    ~DelayTableWatcher()
     {
-        keyVector.clear();
-        delaysVector.clear();
-        char ch = '\0';
-        bool stripWhitespace = false;
-        bool textRemaining = fhelper.getCharacter(ch);
-
-        if (ch == '/')
-        {
-            stripWhitespace = true;
-            textRemaining = fhelper.getCharacter(ch);
-        }
-        else if (ch == ' ' || ch == '\f' || ch == '\r' || ch == '\t' || ch == '\v')
+        if (_watcher.joinable())
         {
-            // don't include starting whitespace
-            for (
-                textRemaining = fhelper.getCharacter(ch);
-                textRemaining && (ch == ' ' || ch == '\f' || ch == '\r' || ch == '\t' || ch == '\v');
-                textRemaining = fhelper.getCharacter(ch));
+            uint64_t stop = 1;
+            if (write(_stopFd, &stop, sizeof(stop)) == sizeof(stop))
+            {
+                _watcher.join();
+            }
+            else
+            {
+                _watcher.detach(); // this shouldn't ever happen, but join would never return
+            }
         }
-
-        while (ch != '\n' && ch != '/' && textRemaining)
+        if (_inotifyFd != -1)
         {
-            keyVector.push_back(ch);
-            textRemaining = fhelper.getCharacter(ch);
+            close(_inotifyFd);
         }
-
-        // don't include ending whitespace
-        if (!stripWhitespace)
+        if (_stopFd != -1)
         {
-            while (!keyVector.empty())
-            {
-                char endChar = keyVector.back();
-
-                if (endChar == ' ' || endChar == '\f' || endChar == '\r' || endChar == '\t' || endChar == '\v')
-                {
-                    keyVector.pop_back();
-                }
-                else
-                {
-                    break;
-                }
-            }
+            close(_stopFd);
         }
+        delete _currentTable.load();
+    }
 
-        if (textRemaining && ch == '/') // line didn't end abruptly
+    // returns how many milliseconds the file should be delayed, or -1 if it doesn't have delays
+    int takeDelay(const std::string_view filename)
+    {
+        size_t readerSlot = 0;
+        while (true)
         {
-            fillDelaysVector(textRemaining, delaysVector, fhelper, intAsChars);
+            uint32_t epoch = _epoch.load();
+            readerSlot = epoch & 1;
+            _readerCounts[readerSlot].fetch_add(1);
             
-            if (!keyVector.empty() && !delaysVector.empty())
+            if (_epoch.load() == epoch) // otherwise the writer might not be waiting for this slot any more
             {
-                if (delaysVector.back() != -1)
-                {
-                    delaysVector.push_back(-2);
-                }
-                
-                keyVector.push_back('\0');
-                std::unique_ptr<char[]> keyPtr = std::make_unique<char[]>(keyVector.size());
-                memcpy(keyPtr.get(), keyVector.data(), keyVector.size() * sizeof(char));
-                fileMap.emplace(std::move(keyPtr), MapValue(delaysVector));
+                break;
             }
+            
+            _readerCounts[readerSlot].fetch_sub(1);
         }
         
-        return textRemaining;
+        int delay = _currentTable.load()->takeDelay(filename);
+        
+        _readerCounts[readerSlot].fetch_sub(1);
+        
+        return delay;
     }
 
-    // the -2 at the end is added in addMapPair when there isn't already a -1
-    void fillDelaysVector(bool& textRemaining, std::vector<int>& delaysVector, FileHelper& fhelper, std::vector<char>& intAsChars)
+private:
+    std::atomic<DelayTable*> _currentTable;
+    std::atomic<uint32_t> _epoch = 0;
+    std::atomic<size_t> _readerCounts[2] = {0, 0};
+    std::thread _watcher;
+    int _inotifyFd = -1;
+    int _stopFd = -1;
+
+    void publish(DelayTable* newTable)
     {
-        char ch = '\0';
-        int delay = 0;
-
-        for (
-            textRemaining = fhelper.getCharacter(ch);
-            ch != '\n' && textRemaining;
-            textRemaining = fhelper.getCharacter(ch))
+        DelayTable* oldTable = _currentTable.exchange(newTable);
+        uint32_t oldEpoch = _epoch.fetch_add(1);
+        
+        while (_readerCounts[oldEpoch & 1].load() != 0)
         {
-            if (ch >= '0' && ch <= '9')
-            {
-                intAsChars.push_back((char)ch);
-            }
-            else if (ch == '-')
-            {
-                delaysVector.push_back(-1);
-
-                break;
-            }
-            else if (ch == '/')
-            {
-                auto [ptr, ec] = std::from_chars(intAsChars.data(), intAsChars.data() + intAsChars.size(), delay);
-
-                if (ec == std::errc::result_out_of_range)
-                {
-                    throw std::runtime_error("delays can't be larger than INT_MAX1");
-                }
-
-                delaysVector.push_back(delay);
-                intAsChars.clear();
-                intAsChars.push_back('0'); // empty vector causes std::errc::invalid_argument
-            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
+        
+        delete oldTable;
+    }
 
-        if (delaysVector.empty() || delaysVector.back() != -1)
+    // returns true if any of the events which were read were for files_and_delays.txt
+    bool readDelaysFileEvents(char* eventBuffer, const size_t eventBufferSize)
+    {
+        bool delaysFileChanged = false;
+        ssize_t bytesRead = 0;
+        
+        while ((bytesRead = read(_inotifyFd, eventBuffer, eventBufferSize)) > 0)
         {
-            if (intAsChars.size() > 1)
+            for (ssize_t eventOffset = 0; eventOffset < bytesRead;)
             {
-                auto [ptr, ec] = std::from_chars(intAsChars.data(), intAsChars.data() + intAsChars.size(), delay);
-
-                if (ec == std::errc::result_out_of_range)
+                const struct inotify_event* event = (const struct inotify_event*)&eventBuffer[eventOffset];
+                if (event->len != 0 && strcmp(event->name, delaysFileName) == 0)
                 {
-                    throw std::runtime_error("delays can't be larger than INT_MAX2");
+                    delaysFileChanged = true;
                 }
-
-                delaysVector.push_back(delay);
+                eventOffset += sizeof(struct inotify_event) + event->len;
             }
         }
-
-        intAsChars.clear();
-        intAsChars.push_back('0');
-
-        // make sure to go to end of line
-        for (; ch != '\n' && textRemaining; textRemaining = fhelper.getCharacter(ch));
+        
+        return delaysFileChanged;
     }
 
-    void delayFile(MapValue& fileMapValue)
+    void watchForEdits()
     {
-        static size_t fullResetCount = 0;
+        // big enough for several events, inotify events are aligned to the alignment of inotify_event
+        alignas(struct inotify_event) char eventBuffer[4096];
+        struct pollfd pollFds[2] = {{_inotifyFd, POLLIN, 0}, {_stopFd, POLLIN, 0}};
         
-        int delay = 0;
-
+        while (true)
         {
-            std::lock_guard<std::mutex> mutexForMapLock(mutexForMap);
-
-            if (fileMapValue.fullResetCheckNumber < fullResetCount)
-            {
-                fileMapValue.position = 0;
-                fileMapValue.fullResetCheckNumber = fullResetCount;
-            }
-
-            if (fileMapValue.delays[0] == -1)
+            if (poll(pollFds, 2, -1) == -1)
             {
-                if (fullResetCount == SIZE_MAX) // this probably won't ever happen
+                if (errno == EINTR)
                 {
-                    fullResetCount = 0;
-
-                    for (auto& [k, v] : fileMap)
-                    {
-                        v.fullResetCheckNumber = 0;
-                    }
+                    continue;
                 }
-
-                fullResetCount++;
+                printCstr("WARNING: stopped watching files_and_delays.txt, poll failure: "); printInt(errno); printCstr("\n");
+                return;
             }
-            else if (fileMapValue.delays[fileMapValue.position] == -1)
+            
+            if (pollFds[1].revents != 0)
             {
-                fileMapValue.position = 0;
+                return;
             }
-
-            if (fileMapValue.delays[fileMapValue.position] >= 0)
+            
+            if (!readDelaysFileEvents(eventBuffer, sizeof(eventBuffer)))
             {
-                delay = fileMapValue.delays[fileMapValue.position];
-                fileMapValue.position++;
+                continue;
             }
-        }
-        
-        if (delay > 0)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+            
+            // some editors save in more than one step, so wait until the file has stopped changing before reading it
+            while (poll(pollFds, 1, delaysFileSettleMilliseconds) == 1 && readDelaysFileEvents(eventBuffer, sizeof(eventBuffer)));
+            
+            DelayTable* newTable = new DelayTable();
+            size_t fileCount = newTable->fileCount();
+            publish(newTable);
+            
+            printCstr("reloaded "); printCstr(delaysFileName); printCstr(": ");
+            printInt(fileCount); printCstr(" files with delays\n");
         }
     }
 };
 
 
-static void sharedPathCheckingFunction(const char* path)
+static unsigned char readTimerByte()
+{
+    return timerBytePointer != nullptr ? std::atomic_ref<unsigned char>(*timerBytePointer).load() : 0;
+}
+
+static bool loadInProgress()
+{
+    unsigned char currentTimerByte = readTimerByte();
+    return currentTimerByte != 0 && currentTimerByte != 255;
+}
+
+static bool pathHooksActive()
+{
+    return delaysActive || prefetchActive || warmPageCacheActive || mmapStreamsActive || loadHistoryActive || fileOpenTraceActive;
+}
+
+// returns the filename part of the path
+static std::string_view sharedPathCheckingFunction(const char* path)
 {
-    static MapAndMutex mapAndMutexObject;
-    
     int filenameIndex = -1;
     int pathEndIndex = 0;
 
@@ -306,22 +326,94 @@ static void sharedPathCheckingFunction(const char* path)
     }
 
     filenameIndex++; // moving past '/' character or to 0 if no '/' was found
-    auto it = mapAndMutexObject.fileMap.find(
-        std::string_view(path + filenameIndex,
-            (size_t)pathEndIndex - filenameIndex)
-    );
+    std::string_view filename(path + filenameIndex, (size_t)pathEndIndex - filenameIndex);
+    
+    if (mmapStreamsActive)
+    {
+        static std::atomic<bool> previouslyLoading = false;
+        
+        bool loading = loadInProgress();
+        if (previouslyLoading.exchange(loading) && !loading)
+        {
+            reportMmapStreamStatistics();
+        }
+    }
+    
+    if (loadHistoryActive && filename.size() > 4 && filename.substr(filename.size() - 4) == ".hps")
+    {
+        loadHistory.mapFileOpened(filename, loadInProgress());
+    }
+    
+    // this is done before delaying so the files are read while the delay happens
+    if (prefetchActive)
+    {
+        static MapPrefetcher mapPrefetcherObject;
+        
+        mapPrefetcherObject.fileOpened(path, filename, loadInProgress());
+    }
+    
+    if (warmPageCacheActive)
+    {
+        static PageCacheWarmer pageCacheWarmerObject; // the first file the game opens starts the warming thread
+        
+        pageCacheWarmerObject.fileOpened(path);
+    }
     
-    if (it != mapAndMutexObject.fileMap.end())
+    if (delaysActive)
+    {
+        static DelayTableWatcher delayTableWatcherObject;
+        
+        int delay = fileOpenTraceActive
+            ? fileOpenTraceRecorder.record(path, readTimerByte(), true, [&]() { return delayTableWatcherObject.takeDelay(filename); })
+            : delayTableWatcherObject.takeDelay(filename);
+        
+        ToolCounters* counters = toolCounters; // read once, stopTimerEvents sets it to nullptr when the game exits, maybe during the sleep
+        if (delay >= 0 && counters != nullptr)
+        {
+            addToCounter(counters->delayedFiles, 1);
+        }
+        if (delay > 0)
+        {
+            auto sleepStart = std::chrono::steady_clock::now();
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+            
+            if (counters != nullptr) // the shared memory stays mapped after the game exits, so the counters can still be added to
+            {
+                // what the sleep really took, which is a little longer than the delay
+                uint64_t slept = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sleepStart).count();
+                addToCounter(counters->delayNanoseconds, slept);
+                raiseCounter(counters->longestDelayNanoseconds, slept);
+            }
+        }
+    }
+    else if (fileOpenTraceActive)
     {
-        mapAndMutexObject.delayFile(it->second);
+        fileOpenTraceRecorder.record(path, readTimerByte(), false, []() { return -1; });
     }
+    
+    return filename;
 }
 
 FILE* fopen(const char* path, const char* mode)
 {
-    if (delaysActive)
+    ToolCounters* counters = toolCounters; // read once, stopTimerEvents sets it to nullptr when the game exits
+    if (counters != nullptr)
     {
-        sharedPathCheckingFunction(path);
+        addToCounter(counters->fopenCalls, 1);
+    }
+    
+    if (pathHooksActive())
+    {
+        std::string_view filename = sharedPathCheckingFunction(path);
+        
+        if (mmapStreamsActive)
+        {
+            FILE* f = openMmapStream(path, mode, filename);
+            if (f != nullptr)
+            {
+                return f;
+            }
+        }
     }
 
     return originalFopen(path, mode);
@@ -329,7 +421,13 @@ FILE* fopen(const char* path, const char* mode)
 
 FILE* freopen(const char* path, const char* mode, FILE* stream)
 {
-    if (delaysActive)
+    ToolCounters* counters = toolCounters; // read once, stopTimerEvents sets it to nullptr when the game exits
+    if (counters != nullptr)
+    {
+        addToCounter(counters->freopenCalls, 1);
+    }
+    
+    if (pathHooksActive())
     {
         sharedPathCheckingFunction(path);
     }
@@ -339,9 +437,24 @@ FILE* freopen(const char* path, const char* mode, FILE* stream)
 
 FILE* fopen64(const char* path, const char* mode)
 {
-    if (delaysActive)
+    ToolCounters* counters = toolCounters; // read once, stopTimerEvents sets it to nullptr when the game exits
+    if (counters != nullptr)
     {
-        sharedPathCheckingFunction(path);
+        addToCounter(counters->fopen64Calls, 1);
+    }
+    
+    if (pathHooksActive())
+    {
+        std::string_view filename = sharedPathCheckingFunction(path);
+        
+        if (mmapStreamsActive)
+        {
+            FILE* f = openMmapStream(path, mode, filename);
+            if (f != nullptr)
+            {
+                return f;
+            }
+        }
     }
 
     return originalFopen64(path, mode);
@@ -349,11 +462,16 @@ FILE* fopen64(const char* path, const char* mode)
 
 FILE* freopen64(const char* path, const char* mode, FILE* stream)
 {
-    if (delaysActive)
+    ToolCounters* counters = toolCounters; // read once, stopTimerEvents sets it to nullptr when the game exits
+    if (counters != nullptr)
+    {
+        addToCounter(counters->freopen64Calls, 1);
+    }
+    
+    if (pathHooksActive())
     {
         sharedPathCheckingFunction(path);
     }
 
     return originalFreopen64(path, mode, stream);
-}
-
+}
\ No newline at end of file
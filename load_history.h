@@ -0,0 +1,284 @@
+
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <string_view>
+#include <condition_variable>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// fnv1a_hash.h and tool_counters.h have to be included before this
+
+[[maybe_unused]] static bool loadHistoryActive = false;
+static const char loadHistoryFolderName[] = "load_history";
+static const char loadHistoryMagic[4] = {'A', 'M', 'L', 'H'};
+static const uint32_t loadHistoryVersion = 1;
+static const size_t loadHistoryPendingCapacity = 64; // loads waiting for the writer thread, later ones are dropped
+
+// Every session's loads are appended to their own file in load_history, so load times can be compared across sessions and machines
+// with load_history_analyzer. A file is a LoadHistoryFileHeader followed by one LoadHistoryRecord per load, both 64 bytes, in native
+// byte order. The file is only made when the first load ends, so sessions without loads don't leave empty files.
+// Nothing is written on the game's main thread: the record is copied into memory set aside for it and a writer thread, started when
+// the first load pauses the timer, makes the file and writes it.
+struct LoadHistoryFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t recordSize; // sizeof(LoadHistoryRecord), so records can get longer
+    int32_t pid;
+    alignas(8) int64_t startRealtimeSeconds; // CLOCK_REALTIME when the file was made, right after the first load ended
+    alignas(8) int64_t startMonotonicNanoseconds; // CLOCK_MONOTONIC at the same time, to turn the records' times into real times
+    unsigned char unused[32];
+};
+
+// a load is from when the timer paused to when it resumed. the times are CLOCK_MONOTONIC
+struct LoadHistoryRecord
+{
+    alignas(8) uint64_t mapNameHash; // fnv1a64 of the last .hps file opened before the load ended, 0 if there wasn't one
+    alignas(8) int64_t pauseNanoseconds;
+    alignas(8) int64_t mapFileNanoseconds; // when the map's .hps file was opened during the load, 0 if it was opened before the load
+    alignas(8) int64_t resumeNanoseconds;
+    alignas(8) int64_t delayNanoseconds; // how long file delays slept during the load
+    uint32_t flashbackWaits; // how many 1 ms waits there were for flashback lines during the load
+    uint8_t pauseEventCode; // 1 for a menu load, 2 for a map change
+    uint8_t flags; // loadHistoryFlashbackWaited
+    uint16_t unused;
+    char mapName[16]; // the start of the .hps file name without .hps, for printing. only null terminated if it's shorter than 16 characters
+};
+
+static const uint8_t loadHistoryFlashbackWaited = 1 << 0;
+
+static_assert(sizeof(LoadHistoryFileHeader) == 64 && sizeof(LoadHistoryRecord) == 64, "load_history_analyzer depends on these sizes");
+
+// mapFileOpened is called from the fopen hooks on whichever thread opens the map, and timerEvent from recordTimerEvent on the game's main thread
+class LoadHistory
+{
+public:
+    LoadHistory(const LoadHistory&) = delete;
+    LoadHistory& operator=(LoadHistory other) = delete;
+    LoadHistory(LoadHistory&&) = delete;
+    LoadHistory& operator=(LoadHistory&&) = delete;
+
+    LoadHistory() = default;
+
+    ~LoadHistory()
+    {
+        if (_worker.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(_pendingMutex);
+                _stopWorker = true; // loads already handed off are still written
+            }
+            _workAvailable.notify_one();
+            _worker.join();
+        }
+        closeFile();
+    }
+
+    void mapFileOpened(const std::string_view filename, const bool loading)
+    {
+        std::string_view name = filename.substr(0, filename.size() - 4); // without .hps
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _mapNameHash = fnv1a64((const unsigned char*)filename.data(), filename.size());
+        memset(_mapName, 0, sizeof(_mapName));
+        memcpy(_mapName, name.data(), name.size() < sizeof(_mapName) ? name.size() : sizeof(_mapName));
+        // steady_clock is CLOCK_MONOTONIC on linux, like the timer events' times
+        _mapFileNanoseconds = loading ? std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() : 0;
+    }
+
+    void timerEvent(const uint32_t eventCode, const int64_t monotonicNanoseconds)
+    {
+        if (eventCode == 255)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_pendingMutex);
+                _stopWorker = true; // the writer finishes the loads it has and closes the file
+            }
+            _workAvailable.notify_one();
+            return;
+        }
+
+        if (eventCode != 0)
+        {
+            if (!_loading) // going from the menu straight into a map change is still one load
+            {
+                _loading = true;
+                _record = LoadHistoryRecord{};
+                _record.pauseNanoseconds = monotonicNanoseconds;
+                ToolCounters* counters = toolCounters; // read once, stopTimerEvents sets it to nullptr when the game exits
+                _delayNanosecondsBefore = counters != nullptr ? readCounter(counters->delayNanoseconds) : 0;
+                _flashbackWaitsBefore = counters != nullptr ? readCounter(counters->flashbackWaits) : 0;
+                if (!_worker.joinable()) // started while the timer is paused, so it isn't part of the time the run is timed
+                {
+                    _worker = std::thread(&LoadHistory::workerLoop, this);
+                }
+            }
+            _record.pauseEventCode = (uint8_t)eventCode;
+            return;
+        }
+
+        if (!_loading)
+        {
+            return;
+        }
+        _loading = false;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _record.mapNameHash = _mapNameHash;
+            memcpy(_record.mapName, _mapName, sizeof(_mapName));
+            _record.mapFileNanoseconds = _mapFileNanoseconds >= _record.pauseNanoseconds ? _mapFileNanoseconds : 0;
+        }
+        _record.resumeNanoseconds = monotonicNanoseconds;
+        ToolCounters* counters = toolCounters;
+        if (counters != nullptr)
+        {
+            _record.delayNanoseconds = (int64_t)(readCounter(counters->delayNanoseconds) - _delayNanosecondsBefore);
+            _record.flashbackWaits = (uint32_t)(readCounter(counters->flashbackWaits) - _flashbackWaitsBefore);
+        }
+        _record.flags = _record.flashbackWaits != 0 ? loadHistoryFlashbackWaited : 0;
+
+        {
+            std::lock_guard<std::mutex> lock(_pendingMutex);
+            if (_pendingCount == loadHistoryPendingCapacity)
+            {
+                _droppedLoads++;
+                return;
+            }
+            _pending[(_pendingStart + _pendingCount) % loadHistoryPendingCapacity] = _record;
+            _pendingCount++;
+        }
+        _workAvailable.notify_one();
+    }
+
+private:
+    std::mutex _mutex; // for the map file, which is written by the hooks
+    uint64_t _mapNameHash = 0;
+    char _mapName[16]{};
+    int64_t _mapFileNanoseconds = 0;
+
+    // only used by the game's main thread
+    bool _loading = false;
+    LoadHistoryRecord _record{};
+    uint64_t _delayNanosecondsBefore = 0;
+    uint64_t _flashbackWaitsBefore = 0;
+
+    std::mutex _pendingMutex; // for the loads handed to the writer thread
+    std::condition_variable _workAvailable;
+    std::thread _worker;
+    bool _stopWorker = false;
+    LoadHistoryRecord _pending[loadHistoryPendingCapacity]{};
+    size_t _pendingStart = 0;
+    size_t _pendingCount = 0;
+    size_t _droppedLoads = 0;
+
+    // only used by the writer thread
+    int _fd = -1;
+    bool _openFailed = false;
+
+    void workerLoop()
+    {
+        while (true)
+        {
+            LoadHistoryRecord record{};
+            size_t droppedLoads = 0;
+            {
+                std::unique_lock<std::mutex> lock(_pendingMutex);
+                _workAvailable.wait(lock, [this]() { return _stopWorker || _pendingCount != 0; });
+                if (_pendingCount == 0)
+                {
+                    break;
+                }
+                record = _pending[_pendingStart];
+                _pendingStart = (_pendingStart + 1) % loadHistoryPendingCapacity;
+                _pendingCount--;
+                droppedLoads = _droppedLoads;
+                _droppedLoads = 0;
+            }
+
+            if (droppedLoads != 0)
+            {
+                printCstr("WARNING: "); printInt(droppedLoads); printCstr(" loads weren't saved in the load history because it couldn't keep up\n");
+            }
+            writeRecord(record);
+        }
+        closeFile();
+    }
+
+    void writeRecord(const LoadHistoryRecord& record)
+    {
+        if (_fd == -1 && !_openFailed)
+        {
+            openFile();
+        }
+        // one write with O_APPEND, so a record is never split even if the game is killed
+        if (_fd != -1 && write(_fd, &record, sizeof(record)) != sizeof(record))
+        {
+            printCstr("WARNING: stopped writing the load history, write failure: "); printInt(errno); printCstr("\n");
+            closeFile();
+            _openFailed = true;
+        }
+    }
+
+    void openFile()
+    {
+        _openFailed = true;
+        if (mkdir(loadHistoryFolderName, 0755) == -1 && errno != EEXIST)
+        {
+            printCstr("WARNING: couldn't make the "); printCstr(loadHistoryFolderName); printCstr(" folder: "); printInt(errno); printCstr("\n");
+            return;
+        }
+
+        struct timespec realtime{};
+        struct timespec monotonic{};
+        clock_gettime(CLOCK_REALTIME, &realtime);
+        clock_gettime(CLOCK_MONOTONIC, &monotonic);
+        std::string path = std::string(loadHistoryFolderName) + "/session_" + std::to_string((long long)realtime.tv_sec) + "_"
+            + std::to_string((int)getpid()) + ".bin";
+        _fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644); // make sure this gets closed
+        if (_fd == -1)
+        {
+            printCstr("WARNING: couldn't open "); printCstr(path.c_str()); printCstr(": "); printInt(errno); printCstr("\n");
+            return;
+        }
+
+        LoadHistoryFileHeader header{};
+        memcpy(header.magic, loadHistoryMagic, sizeof(loadHistoryMagic));
+        header.version = loadHistoryVersion;
+        header.recordSize = sizeof(LoadHistoryRecord);
+        header.pid = (int32_t)getpid();
+        header.startRealtimeSeconds = realtime.tv_sec;
+        header.startMonotonicNanoseconds = ((int64_t)monotonic.tv_sec * 1000000000) + monotonic.tv_nsec;
+        if (write(_fd, &header, sizeof(header)) != sizeof(header))
+        {
+            printCstr("WARNING: couldn't write the load history header: "); printInt(errno); printCstr("\n");
+            closeFile();
+            return;
+        }
+        _openFailed = false;
+    }
+
+    void closeFile()
+    {
+        if (_fd != -1)
+        {
+            close(_fd); // file closed here
+            _fd = -1;
+        }
+    }
+};
+
+static LoadHistory loadHistory;
+
+// set as timerEventObserver by amnesia_tool.cpp when "load history" is on
+[[maybe_unused]] static void recordLoadHistoryEvent(const uint32_t eventCode, const int64_t monotonicNanoseconds)
+{
+    loadHistory.timerEvent(eventCode, monotonicNanoseconds);
+}
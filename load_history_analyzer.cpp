@@ -0,0 +1,278 @@
+
+// Reads the session files the tool writes to load_history when "load history" is on, and prints a table of load time percentiles
+// for every map. The files are mapped and read once from start to end, and each map's load times go into 1 ms histograms instead of
+// being kept, so it can read gigabytes of sessions from many machines without needing much memory.
+// usage: load_history_analyzer.exe [session files or folders of them, default load_history]
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <errno.h>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#include "non_std_functions.h"
+#include "fnv1a_hash.h"
+#include "tool_counters.h"
+#include "load_history.h"
+
+static const size_t histogramMilliseconds = 120000; // longer loads are counted as this long in the percentiles, but not in the max
+
+struct MapLoads
+{
+    std::string name;
+    uint64_t loads = 0;
+    int64_t longestNanoseconds = 0;
+    int64_t delayNanoseconds = 0;
+    uint64_t flashbackWaitedLoads = 0;
+    uint64_t mapFileLoads = 0; // loads where the map's .hps file was opened during the load
+    std::vector<uint32_t> loadHistogram = std::vector<uint32_t>(histogramMilliseconds + 1);
+    std::vector<uint32_t> mapFileHistogram = std::vector<uint32_t>(histogramMilliseconds + 1); // from the pause to the .hps file opening
+};
+
+struct AnalyzerTotals
+{
+    uint64_t files = 0;
+    uint64_t skippedFiles = 0;
+    uint64_t bytes = 0;
+    uint64_t records = 0;
+    uint64_t badRecords = 0;
+};
+
+static void addToHistogram(std::vector<uint32_t>& histogram, const int64_t nanoseconds)
+{
+    size_t milliseconds = (size_t)(nanoseconds / 1000000);
+    histogram[milliseconds < histogramMilliseconds ? milliseconds : histogramMilliseconds] += 1;
+}
+
+// the smallest whole millisecond that at least fraction of the values are in or below
+static size_t histogramPercentile(const std::vector<uint32_t>& histogram, const uint64_t count, const double fraction)
+{
+    uint64_t needed = (uint64_t)(fraction * (double)count + 0.999999);
+    needed = needed == 0 ? 1 : needed;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < histogram.size(); i++)
+    {
+        seen += histogram[i];
+        if (seen >= needed)
+        {
+            return i;
+        }
+    }
+    return histogram.size() - 1;
+}
+
+static void addRecord(std::unordered_map<uint64_t, MapLoads>& maps, const LoadHistoryRecord& record, AnalyzerTotals& totals)
+{
+    if (record.pauseNanoseconds <= 0 || record.resumeNanoseconds < record.pauseNanoseconds)
+    {
+        totals.badRecords += 1;
+        return;
+    }
+
+    MapLoads& map = maps[record.mapNameHash];
+    if (map.name.empty())
+    {
+        map.name = record.mapNameHash == 0 ? std::string("(no map file)") : std::string(record.mapName, strnlen(record.mapName, sizeof(record.mapName)));
+    }
+
+    int64_t duration = record.resumeNanoseconds - record.pauseNanoseconds;
+    map.loads += 1;
+    map.longestNanoseconds = std::max(map.longestNanoseconds, duration);
+    map.delayNanoseconds += record.delayNanoseconds;
+    map.flashbackWaitedLoads += (record.flags & loadHistoryFlashbackWaited) != 0;
+    addToHistogram(map.loadHistogram, duration);
+    if (record.mapFileNanoseconds >= record.pauseNanoseconds && record.mapFileNanoseconds <= record.resumeNanoseconds)
+    {
+        map.mapFileLoads += 1;
+        addToHistogram(map.mapFileHistogram, record.mapFileNanoseconds - record.pauseNanoseconds);
+    }
+    totals.records += 1;
+}
+
+static void readSessionFile(const std::string& path, std::unordered_map<uint64_t, MapLoads>& maps, AnalyzerTotals& totals)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC); // make sure this gets closed
+    if (fd == -1)
+    {
+        printf("couldn't open %s: %d\n", path.c_str(), errno);
+        totals.skippedFiles += 1;
+        return;
+    }
+
+    struct stat fileStatus{};
+    if (fstat(fd, &fileStatus) == -1 || (size_t)fileStatus.st_size < sizeof(LoadHistoryFileHeader))
+    {
+        close(fd);
+        totals.skippedFiles += 1;
+        return;
+    }
+    size_t fileSize = (size_t)fileStatus.st_size;
+
+    void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // file closed here, the mapping keeps it
+    if (mapping == MAP_FAILED)
+    {
+        printf("couldn't map %s: %d\n", path.c_str(), errno);
+        totals.skippedFiles += 1;
+        return;
+    }
+    madvise(mapping, fileSize, MADV_SEQUENTIAL); // so the kernel reads ahead further and drops pages behind
+
+    const unsigned char* bytes = (const unsigned char*)mapping;
+    LoadHistoryFileHeader header{};
+    memcpy(&header, bytes, sizeof(header));
+    if (memcmp(header.magic, loadHistoryMagic, sizeof(loadHistoryMagic)) != 0 || header.version != loadHistoryVersion
+        || header.recordSize < sizeof(LoadHistoryRecord))
+    {
+        printf("%s isn't a load history file from this version of the tool\n", path.c_str());
+        munmap(mapping, fileSize);
+        totals.skippedFiles += 1;
+        return;
+    }
+
+    // a record cut off by the game being killed while it was written is left out
+    for (size_t offset = sizeof(header); offset + header.recordSize <= fileSize; offset += header.recordSize)
+    {
+        LoadHistoryRecord record{};
+        memcpy(&record, bytes + offset, sizeof(record));
+        addRecord(maps, record, totals);
+    }
+
+    munmap(mapping, fileSize); // mapping removed here
+    totals.files += 1;
+    totals.bytes += fileSize;
+}
+
+static void readPath(const std::string& path, std::unordered_map<uint64_t, MapLoads>& maps, AnalyzerTotals& totals)
+{
+    struct stat pathStatus{};
+    if (stat(path.c_str(), &pathStatus) == -1)
+    {
+        printf("couldn't find %s: %d\n", path.c_str(), errno);
+        return;
+    }
+    if (!S_ISDIR(pathStatus.st_mode))
+    {
+        readSessionFile(path, maps, totals);
+        return;
+    }
+
+    DIR* directory = opendir(path.c_str()); // make sure this gets closed
+    if (directory == nullptr)
+    {
+        printf("couldn't open %s: %d\n", path.c_str(), errno);
+        return;
+    }
+    std::vector<std::string> entries;
+    while (struct dirent* entry = readdir(directory))
+    {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..")
+        {
+            entries.push_back(path + "/" + name);
+        }
+    }
+    closedir(directory); // directory closed here
+
+    std::sort(entries.begin(), entries.end());
+    for (const std::string& entry : entries)
+    {
+        if (entry.size() > 4 && entry.substr(entry.size() - 4) == ".bin")
+        {
+            readSessionFile(entry, maps, totals);
+        }
+        else if (stat(entry.c_str(), &pathStatus) == 0 && S_ISDIR(pathStatus.st_mode)) // like a folder for each runner machine
+        {
+            readPath(entry, maps, totals);
+        }
+    }
+}
+
+static void printMapRow(const MapLoads& map)
+{
+    printf("%-18s %8llu %8zu %8zu %8zu %8lld", map.name.c_str(), (unsigned long long)map.loads,
+        histogramPercentile(map.loadHistogram, map.loads, 0.5), histogramPercentile(map.loadHistogram, map.loads, 0.9),
+        histogramPercentile(map.loadHistogram, map.loads, 0.99), (long long)(map.longestNanoseconds / 1000000));
+    if (map.mapFileLoads != 0)
+    {
+        printf(" %10zu", histogramPercentile(map.mapFileHistogram, map.mapFileLoads, 0.5));
+    }
+    else
+    {
+        printf(" %10s", "-");
+    }
+    printf(" %10.1f %9.1f%%\n", (double)map.delayNanoseconds / 1000000.0 / (double)map.loads,
+        100.0 * (double)map.flashbackWaitedLoads / (double)map.loads);
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        paths.push_back(argv[i]);
+    }
+    if (paths.empty())
+    {
+        paths.push_back(loadHistoryFolderName);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::unordered_map<uint64_t, MapLoads> maps;
+    AnalyzerTotals totals;
+    for (const std::string& path : paths)
+    {
+        readPath(path, maps, totals);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    printf("%llu sessions, %llu loads, %.1f MB in %.2f s (%.0f MB/s)", (unsigned long long)totals.files, (unsigned long long)totals.records,
+        (double)totals.bytes / 1e6, elapsed.count(), elapsed.count() > 0 ? (double)totals.bytes / 1e6 / elapsed.count() : 0.0);
+    if (totals.skippedFiles != 0 || totals.badRecords != 0)
+    {
+        printf(", %llu files and %llu loads skipped", (unsigned long long)totals.skippedFiles, (unsigned long long)totals.badRecords);
+    }
+    printf("\n");
+    if (maps.empty())
+    {
+        return totals.files == 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    std::vector<const MapLoads*> sortedMaps;
+    MapLoads allMaps;
+    allMaps.name = "all maps";
+    for (const auto& map : maps)
+    {
+        sortedMaps.push_back(&map.second);
+        allMaps.loads += map.second.loads;
+        allMaps.longestNanoseconds = std::max(allMaps.longestNanoseconds, map.second.longestNanoseconds);
+        allMaps.delayNanoseconds += map.second.delayNanoseconds;
+        allMaps.flashbackWaitedLoads += map.second.flashbackWaitedLoads;
+        allMaps.mapFileLoads += map.second.mapFileLoads;
+        for (size_t i = 0; i <= histogramMilliseconds; i++)
+        {
+            allMaps.loadHistogram[i] += map.second.loadHistogram[i];
+            allMaps.mapFileHistogram[i] += map.second.mapFileHistogram[i];
+        }
+    }
+    std::sort(sortedMaps.begin(), sortedMaps.end(), [](const MapLoads* a, const MapLoads* b) { return a->name < b->name; });
+
+    printf("\nload times in ms, from the timer pausing to it resuming. map file is when the map's .hps file was opened\n");
+    printf("%-18s %8s %8s %8s %8s %8s %10s %10s %10s\n", "map", "loads", "p50", "p90", "p99", "max", "map file", "delay avg", "fb waited");
+    for (const MapLoads* map : sortedMaps)
+    {
+        printMapRow(*map);
+    }
+    printMapRow(allMaps);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,443 @@
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <condition_variable>
+#include <cxxabi.h> // abi::__cxa_demangle
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/prctl.h>
+#include <sys/uio.h> // process_vm_readv
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <dlfcn.h> // dladdr
+
+// non_std_functions.h has to be included before this
+
+[[maybe_unused]] static bool loadSamplerActive = false;
+static const char loadSamplerFolderName[] = "load_samples";
+static const long loadSampleIntervalNanoseconds = 1000000; // of CPU time used by the whole game
+static const size_t loadSampleCapacity = 16384; // samples per load, later ones are dropped
+static const size_t loadSampleMaxFrames = 64;
+static const uintptr_t loadSampleMaxStackBytes = 8 * 1024 * 1024; // how far above the stack pointer frames are looked for, the default stack size
+
+// depth is 0 until the signal handler has written the frames, and is set back to 0 once they've been written to a file
+struct LoadSample
+{
+    uint32_t depth;
+    char threadName[16]; // from prctl, since the thread may be gone by the time the samples are written
+    void* frames[loadSampleMaxFrames];
+};
+
+// used by the signal handler, so they aren't in the class
+static LoadSample* loadSamples = nullptr;
+static std::atomic<uint32_t> loadSampleNext = loadSampleCapacity; // at the capacity when no load is being sampled
+
+// reads the saved frame pointer and return address of a frame. process_vm_readv fails with EFAULT instead of crashing if the frame
+// pointer was really something else, and it's a plain syscall, so it's safe in a signal handler
+static bool readLoadSampleFrame(const uintptr_t framePointer, uintptr_t (&frame)[2])
+{
+    struct iovec local{frame, sizeof(frame)};
+    struct iovec remote{(void*)framePointer, sizeof(frame)};
+    return process_vm_readv(getpid(), &local, 1, &remote, 1, 0) == (ssize_t)sizeof(frame);
+}
+
+// follows the frame pointers up the interrupted thread's stack, from the instruction it was running. every frame has to be higher
+// than the last one and within loadSampleMaxStackBytes of the stack pointer, so a function which uses the frame pointer register
+// for something else ends the stack instead of sending the walk somewhere random
+static uint32_t walkLoadSampleStack(const ucontext_t* context, void** frames)
+{
+#if __x86_64__
+    uintptr_t instructionPointer = (uintptr_t)context->uc_mcontext.gregs[REG_RIP];
+    uintptr_t framePointer = (uintptr_t)context->uc_mcontext.gregs[REG_RBP];
+    uintptr_t stackPointer = (uintptr_t)context->uc_mcontext.gregs[REG_RSP];
+#else
+    uintptr_t instructionPointer = (uintptr_t)context->uc_mcontext.gregs[REG_EIP];
+    uintptr_t framePointer = (uintptr_t)context->uc_mcontext.gregs[REG_EBP];
+    uintptr_t stackPointer = (uintptr_t)context->uc_mcontext.gregs[REG_ESP];
+#endif
+    uintptr_t stackEnd = stackPointer + loadSampleMaxStackBytes < stackPointer ? UINTPTR_MAX : stackPointer + loadSampleMaxStackBytes;
+
+    uint32_t depth = 0;
+    frames[depth++] = (void*)instructionPointer;
+    uintptr_t lowest = stackPointer;
+    while (depth < loadSampleMaxFrames && framePointer >= lowest && framePointer < stackEnd - (2 * sizeof(uintptr_t))
+        && framePointer % sizeof(uintptr_t) == 0)
+    {
+        uintptr_t frame[2]; // the caller's frame pointer, then the return address
+        if (!readLoadSampleFrame(framePointer, frame) || frame[1] == 0)
+        {
+            break;
+        }
+        frames[depth++] = (void*)frame[1];
+        lowest = framePointer + (2 * sizeof(uintptr_t));
+        framePointer = frame[0];
+    }
+    return depth;
+}
+
+static void loadSamplerSignalHandler(int, siginfo_t*, void* context)
+{
+    int savedErrno = errno;
+    uint32_t index = loadSampleNext.fetch_add(1, std::memory_order_relaxed);
+    if (index < loadSampleCapacity)
+    {
+        LoadSample& sample = loadSamples[index];
+        uint32_t depth = walkLoadSampleStack((const ucontext_t*)context, sample.frames);
+        if (prctl(PR_GET_NAME, sample.threadName) == -1)
+        {
+            sample.threadName[0] = '\0';
+        }
+        std::atomic_ref<uint32_t>(sample.depth).store(depth, std::memory_order_release);
+    }
+    errno = savedErrno;
+}
+
+// Samples what every thread of the game is doing while a load is in progress, and writes each load's samples to its own file in
+// load_samples in the folded stacks format flame graph tools read: thread name;outermost function;...;innermost function count
+// A timer made with timer_create counts the CPU time of the whole game and sends SIGPROF every 1 ms of it, only from the timer
+// pausing to the timer resuming. The kernel only checks it on its scheduler tick though, so with a 250 Hz kernel it's at most
+// every 4 ms on each busy core. The signal handler walks the thread's frame pointers into memory mapped before the load, so it
+// doesn't allocate or take locks. backtrace isn't used because it can take the loader's lock, which the interrupted thread might
+// be holding. Code built without frame pointers only shows the function that was running, and the stack above it stops at the
+// first frame which doesn't look like one. The functions are named on the sampler's own thread after the load, with dladdr, so
+// the game's main thread isn't slowed after the load ends.
+// SIGPROF goes to the whole game, so while a load is being sampled, nanosleep, poll and select calls in any of the game's threads
+// can return early with EINTR. SA_RESTART doesn't restart those.
+// The game's executable only has names for its exported functions, so the others are written as file+offset.
+// Since linux 6.3 the signal goes to the thread that was running, before that most of the samples land on the main thread.
+// timerEvent is called from recordTimerEvent on the game's main thread.
+class LoadSampler
+{
+public:
+    LoadSampler(const LoadSampler&) = delete;
+    LoadSampler& operator=(LoadSampler other) = delete;
+    LoadSampler(LoadSampler&&) = delete;
+    LoadSampler& operator=(LoadSampler&&) = delete;
+
+    LoadSampler() = default;
+
+    ~LoadSampler()
+    {
+        stop();
+        if (_worker.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopWorker = true; // a load which hasn't been written yet is thrown away
+            }
+            _workAvailable.notify_one();
+            _worker.join();
+        }
+    }
+
+    void timerEvent(const uint32_t eventCode)
+    {
+        if (eventCode == 255)
+        {
+            stop();
+            return;
+        }
+        if (_failed)
+        {
+            return;
+        }
+
+        if (eventCode != 0)
+        {
+            if (!_loading) // going from the menu straight into a map change is still one load
+            {
+                _loading = true;
+                startSampling();
+            }
+            return;
+        }
+
+        if (!_loading)
+        {
+            return;
+        }
+        _loading = false;
+        if (_sampling)
+        {
+            stopSampling();
+        }
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _workAvailable;
+    std::thread _worker;
+    bool _stopWorker = false;
+    bool _writing = false; // the worker has the samples of a load which hasn't been written yet
+    uint32_t _sampleCount = 0;
+    uint32_t _droppedSamples = 0;
+
+    bool _started = false;
+    bool _failed = false;
+    bool _loading = false;
+    bool _sampling = false;
+    timer_t _timer{};
+    size_t _loadNumber = 0;
+    int64_t _sessionSeconds = 0;
+
+    bool start()
+    {
+        _failed = true;
+
+        void* samples = mmap(nullptr, loadSampleCapacity * sizeof(LoadSample), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (samples == MAP_FAILED)
+        {
+            printCstr("WARNING: couldn't map memory for the load samples: "); printInt(errno); printCstr("\n");
+            return false;
+        }
+        loadSamples = (LoadSample*)samples; // kept until the game exits, in case a signal that was already sent is handled late
+
+        struct sigaction action{};
+        action.sa_sigaction = &loadSamplerSignalHandler;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(SIGPROF, &action, nullptr) == -1)
+        {
+            printCstr("WARNING: couldn't set the SIGPROF handler for the load sampler: "); printInt(errno); printCstr("\n");
+            return false;
+        }
+
+        struct sigevent event{};
+        event.sigev_notify = SIGEV_SIGNAL;
+        event.sigev_signo = SIGPROF;
+        if (timer_create(CLOCK_PROCESS_CPUTIME_ID, &event, &_timer) == -1)
+        {
+            printCstr("WARNING: couldn't make the load sampler's timer: "); printInt(errno); printCstr("\n");
+            return false;
+        }
+
+        struct timespec realtime{};
+        clock_gettime(CLOCK_REALTIME, &realtime);
+        _sessionSeconds = realtime.tv_sec;
+        _worker = std::thread(&LoadSampler::workerLoop, this);
+        _started = true;
+        _failed = false;
+        return true;
+    }
+
+    void stop()
+    {
+        if (_started)
+        {
+            timer_delete(_timer); // no more signals come from it after this
+            _started = false;
+            _failed = true;
+            _sampling = false;
+            loadSampleNext.store(loadSampleCapacity, std::memory_order_relaxed);
+        }
+    }
+
+    bool setTimer(const long intervalNanoseconds)
+    {
+        struct itimerspec interval{};
+        interval.it_value.tv_nsec = intervalNanoseconds;
+        interval.it_interval.tv_nsec = intervalNanoseconds;
+        if (timer_settime(_timer, 0, &interval, nullptr) == -1)
+        {
+            printCstr("WARNING: couldn't set the load sampler's timer: "); printInt(errno); printCstr("\n");
+            return false;
+        }
+        return true;
+    }
+
+    void startSampling()
+    {
+        if (!_started && !start())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_writing)
+            {
+                printCstr("the last load's samples are still being written, this load won't be sampled\n");
+                return;
+            }
+        }
+
+        loadSampleNext.store(0, std::memory_order_relaxed);
+        _sampling = setTimer(loadSampleIntervalNanoseconds);
+    }
+
+    void stopSampling()
+    {
+        _sampling = false;
+        setTimer(0);
+        // samples started after this are dropped. ones already started on other threads may not be finished when they're written,
+        // in which case they're left out
+        uint32_t taken = loadSampleNext.exchange(loadSampleCapacity, std::memory_order_relaxed);
+        if (taken == 0) // the load was shorter than the interval
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _sampleCount = taken < loadSampleCapacity ? taken : (uint32_t)loadSampleCapacity;
+            _droppedSamples = taken - _sampleCount;
+            _writing = true;
+        }
+        _workAvailable.notify_one();
+    }
+
+    void workerLoop()
+    {
+        std::unordered_map<uintptr_t, std::string> frameNames; // kept between loads, the game's code doesn't move
+        while (true)
+        {
+            uint32_t sampleCount = 0;
+            uint32_t droppedSamples = 0;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _workAvailable.wait(lock, [this]() { return _stopWorker || _writing; });
+                if (_stopWorker)
+                {
+                    return;
+                }
+                sampleCount = _sampleCount;
+                droppedSamples = _droppedSamples;
+            }
+
+            _loadNumber++;
+            writeSamples(sampleCount, droppedSamples, frameNames);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            _writing = false;
+        }
+    }
+
+    static const std::string& frameName(std::unordered_map<uintptr_t, std::string>& frameNames, const uintptr_t address)
+    {
+        auto it = frameNames.find(address);
+        if (it != frameNames.end())
+        {
+            return it->second;
+        }
+
+        std::string name;
+        Dl_info info{};
+        if (dladdr((void*)address, &info) != 0 && info.dli_sname != nullptr)
+        {
+            int status = -1;
+            char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status); // make sure this gets freed
+            name = status == 0 && demangled != nullptr ? demangled : info.dli_sname;
+            free(demangled); // freed here
+        }
+        else if (info.dli_fname != nullptr && info.dli_fname[0] != '\0')
+        {
+            const char* slash = strrchr(info.dli_fname, '/');
+            char offset[32];
+            snprintf(offset, sizeof(offset), "+0x%zx", (size_t)(address - (uintptr_t)info.dli_fbase));
+            name = std::string(slash != nullptr ? slash + 1 : info.dli_fname) + offset;
+        }
+        else
+        {
+            char unknown[32];
+            snprintf(unknown, sizeof(unknown), "0x%zx", (size_t)address);
+            name = unknown;
+        }
+        std::replace(name.begin(), name.end(), ';', ':'); // ; separates the frames
+        return frameNames.emplace(address, std::move(name)).first->second;
+    }
+
+    static std::string threadName(const LoadSample& sample)
+    {
+        std::string name(sample.threadName, strnlen(sample.threadName, sizeof(sample.threadName)));
+        if (name.empty())
+        {
+            return "unnamed thread";
+        }
+        std::replace(name.begin(), name.end(), ';', ':');
+        return name;
+    }
+
+    void writeSamples(const uint32_t sampleCount, const uint32_t droppedSamples, std::unordered_map<uintptr_t, std::string>& frameNames)
+    {
+        std::unordered_map<std::string, uint32_t> stacks;
+        std::string stack;
+        uint32_t unfinishedSamples = 0;
+        for (uint32_t i = 0; i < sampleCount; i++)
+        {
+            LoadSample& sample = loadSamples[i];
+            uint32_t depth = std::atomic_ref<uint32_t>(sample.depth).load(std::memory_order_acquire);
+            if (depth == 0)
+            {
+                unfinishedSamples++;
+                continue;
+            }
+
+            stack = threadName(sample);
+            for (uint32_t frame = depth; frame > 0; frame--)
+            {
+                uintptr_t address = (uintptr_t)sample.frames[frame - 1];
+                // the other frames are return addresses, which can be the start of the next function, so they're named by the call
+                stack += ';';
+                stack += frameName(frameNames, frame == 1 ? address : address - 1);
+            }
+            stacks[stack]++;
+            std::atomic_ref<uint32_t>(sample.depth).store(0, std::memory_order_relaxed);
+        }
+
+        if (stacks.empty())
+        {
+            return;
+        }
+        if (mkdir(loadSamplerFolderName, 0755) == -1 && errno != EEXIST)
+        {
+            printCstr("WARNING: couldn't make the "); printCstr(loadSamplerFolderName); printCstr(" folder: "); printInt(errno); printCstr("\n");
+            return;
+        }
+
+        std::string text;
+        for (const auto& counted : stacks)
+        {
+            text += counted.first + " " + std::to_string(counted.second) + "\n";
+        }
+        char loadNumber[16];
+        snprintf(loadNumber, sizeof(loadNumber), "%04zu", _loadNumber);
+        std::string path = std::string(loadSamplerFolderName) + "/session_" + std::to_string((long long)_sessionSeconds) + "_"
+            + std::to_string((int)getpid()) + "_load_" + loadNumber + ".folded";
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644); // make sure this gets closed
+        if (fd == -1)
+        {
+            printCstr("WARNING: couldn't open "); printCstr(path.c_str()); printCstr(": "); printInt(errno); printCstr("\n");
+            return;
+        }
+        if (write(fd, text.data(), text.size()) != (ssize_t)text.size())
+        {
+            printCstr("WARNING: couldn't write "); printCstr(path.c_str()); printCstr(": "); printInt(errno); printCstr("\n");
+        }
+        close(fd); // file closed here
+
+        printCstr("wrote "); printInt(sampleCount - unfinishedSamples); printCstr(" samples of the load to "); printCstr(path.c_str());
+        if (droppedSamples != 0)
+        {
+            printCstr(", "); printInt(droppedSamples); printCstr(" more didn't fit");
+        }
+        printCstr("\n");
+    }
+};
+
+static LoadSampler loadSampler;
@@ -0,0 +1,384 @@
+
+#include <sys/stat.h>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <string_view>
+#include <unordered_set>
+#include <unordered_map>
+#include <condition_variable>
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <fcntl.h> // readahead
+
+static bool prefetchActive = false;
+static const char prefetchIndexFileName[] = "map_prefetch_index.bin";
+static const char prefetchIndexTempFileName[] = "map_prefetch_index.bin.tmp";
+static const char prefetchIndexMagic[4] = {'A', 'M', 'P', 'F'};
+static const uint32_t prefetchIndexVersion = 1;
+static const size_t prefetchMaxFilesPerMap = 4096;
+static const size_t prefetchMaxPathLength = UINT16_MAX;
+
+// Remembers which files each map opens while it's loading and reads them into the page cache the next time the map loads.
+// The index is saved as:
+//     "AMPF" | uint32 version | uint32 map count
+//     per map: uint16 name length | name | uint32 path count | per path: uint16 path length | path
+// Nothing here uses fopen because it would be intercepted by the hooks in load_extender.h.
+class MapPrefetcher
+{
+public:
+    MapPrefetcher(const MapPrefetcher&) = delete;
+    MapPrefetcher& operator=(MapPrefetcher other) = delete;
+    MapPrefetcher(MapPrefetcher&&) = delete;
+    MapPrefetcher& operator=(MapPrefetcher&&) = delete;
+
+    MapPrefetcher()
+    {
+        readIndex();
+        _worker = std::thread(&MapPrefetcher::workerLoop, this);
+    }
+
+    ~MapPrefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopWorker = true; // a recording which hasn't reached the end of its load is thrown away
+        }
+        _workAvailable.notify_one();
+        _worker.join();
+    }
+
+    // loading is true while the timer byte says a load is happening
+    void fileOpened(const char* path, const std::string_view filename, const bool loading)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (!_recordingMap.empty())
+        {
+            if (loading)
+            {
+                _recordingSawLoad = true;
+            }
+            else if (_recordingSawLoad) // the load this recording was for has finished
+            {
+                finishRecording();
+            }
+        }
+
+        if (filename.size() > 4 && filename.substr(filename.size() - 4) == ".hps")
+        {
+            if (!_recordingMap.empty()) // another map started loading before the last load ended
+            {
+                finishRecording();
+            }
+
+            _recordingMap = filename;
+            _recordingSawLoad = loading;
+
+            auto it = _index.find(_recordingMap);
+            if (it != _index.end() && !it->second.empty())
+            {
+                _prefetchQueue.push_back(it->second);
+                _workAvailable.notify_one();
+            }
+
+            return;
+        }
+
+        if (!_recordingMap.empty() && _recordedPaths.size() < prefetchMaxFilesPerMap)
+        {
+            std::string_view pathView(path);
+            if (pathView.size() <= prefetchMaxPathLength && _recordedPathSet.emplace(pathView).second)
+            {
+                _recordedPaths.emplace_back(pathView);
+            }
+        }
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _workAvailable;
+    std::thread _worker;
+    std::atomic<bool> _stopWorker = false;
+    bool _indexDirty = false;
+
+    std::unordered_map<std::string, std::vector<std::string>> _index;
+    std::deque<std::vector<std::string>> _prefetchQueue;
+
+    std::string _recordingMap;
+    bool _recordingSawLoad = false;
+    std::vector<std::string> _recordedPaths; // kept in the order the game opened them
+    std::unordered_set<std::string> _recordedPathSet;
+
+    // called with _mutex locked
+    // new paths are added after the ones already known so files seen on earlier loads keep being prefetched
+    void finishRecording()
+    {
+        if (!_recordedPaths.empty())
+        {
+            std::vector<std::string>& paths = _index[_recordingMap];
+            size_t originalSize = paths.size();
+            paths.reserve(std::min(prefetchMaxFilesPerMap, originalSize + _recordedPaths.size())); // so knownPaths doesn't dangle
+            std::unordered_set<std::string_view> knownPaths(paths.begin(), paths.end());
+
+            for (std::string& recordedPath : _recordedPaths)
+            {
+                if (paths.size() == prefetchMaxFilesPerMap)
+                {
+                    break;
+                }
+                if (knownPaths.find(recordedPath) == knownPaths.end())
+                {
+                    paths.push_back(std::move(recordedPath));
+                }
+            }
+
+            if (paths.size() != originalSize)
+            {
+                _indexDirty = true;
+                _workAvailable.notify_one();
+            }
+        }
+
+        _recordingMap.clear();
+        _recordingSawLoad = false;
+        _recordedPaths.clear();
+        _recordedPathSet.clear();
+    }
+
+    void workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        while (true)
+        {
+            _workAvailable.wait(lock, [this] { return _stopWorker || _indexDirty || !_prefetchQueue.empty(); });
+
+            if (!_prefetchQueue.empty() && !_stopWorker)
+            {
+                std::vector<std::string> paths = std::move(_prefetchQueue.front());
+                _prefetchQueue.pop_front();
+
+                lock.unlock();
+                prefetchFiles(paths);
+                lock.lock();
+            }
+            else if (_indexDirty)
+            {
+                std::vector<char> serializedIndex = serializeIndex();
+                _indexDirty = false;
+
+                lock.unlock();
+                writeIndex(serializedIndex);
+                lock.lock();
+            }
+            else if (_stopWorker)
+            {
+                return;
+            }
+        }
+    }
+
+    void prefetchFiles(const std::vector<std::string>& paths)
+    {
+        for (const std::string& path : paths)
+        {
+            if (_stopWorker.load(std::memory_order_relaxed)) // checked between files so exiting the game doesn't wait for a whole map
+            {
+                return;
+            }
+
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd == -1)
+            {
+                continue;
+            }
+
+            struct stat fileStatus{};
+            if (fstat(fd, &fileStatus) == 0 && S_ISREG(fileStatus.st_mode))
+            {
+                if (readahead(fd, 0, (size_t)fileStatus.st_size) == -1)
+                {
+                    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+                }
+            }
+
+            close(fd);
+        }
+    }
+
+    static void appendBytes(std::vector<char>& buffer, const void* bytes, const size_t size)
+    {
+        buffer.insert(buffer.end(), (const char*)bytes, (const char*)bytes + size);
+    }
+
+    static bool readBytes(const std::vector<char>& buffer, size_t& position, void* bytes, const size_t size)
+    {
+        if (buffer.size() - position < size)
+        {
+            return false;
+        }
+
+        memcpy(bytes, &buffer[position], size);
+        position += size;
+
+        return true;
+    }
+
+    static bool readString(const std::vector<char>& buffer, size_t& position, std::string& s)
+    {
+        uint16_t length = 0;
+        if (!readBytes(buffer, position, &length, sizeof(length)) || buffer.size() - position < length)
+        {
+            return false;
+        }
+
+        s.assign(&buffer[position], length);
+        position += length;
+
+        return true;
+    }
+
+    std::vector<char> serializeIndex() const
+    {
+        std::vector<char> buffer;
+        uint32_t mapCount = (uint32_t)_index.size();
+
+        appendBytes(buffer, prefetchIndexMagic, sizeof(prefetchIndexMagic));
+        appendBytes(buffer, &prefetchIndexVersion, sizeof(prefetchIndexVersion));
+        appendBytes(buffer, &mapCount, sizeof(mapCount));
+
+        for (const auto& [mapName, paths] : _index)
+        {
+            uint16_t nameLength = (uint16_t)mapName.size();
+            uint32_t pathCount = (uint32_t)paths.size();
+
+            appendBytes(buffer, &nameLength, sizeof(nameLength));
+            appendBytes(buffer, mapName.data(), nameLength);
+            appendBytes(buffer, &pathCount, sizeof(pathCount));
+
+            for (const std::string& path : paths)
+            {
+                uint16_t pathLength = (uint16_t)path.size();
+                appendBytes(buffer, &pathLength, sizeof(pathLength));
+                appendBytes(buffer, path.data(), pathLength);
+            }
+        }
+
+        return buffer;
+    }
+
+    void readIndex()
+    {
+        int fd = open(prefetchIndexFileName, O_RDONLY | O_CLOEXEC); // make sure this gets closed
+        if (fd == -1) // there won't be an index until a map has been loaded with prefetching turned on
+        {
+            return;
+        }
+
+        std::vector<char> buffer;
+        struct stat fileStatus{};
+        if (fstat(fd, &fileStatus) == 0)
+        {
+            buffer.resize((size_t)fileStatus.st_size);
+
+            size_t totalRead = 0;
+            while (totalRead < buffer.size())
+            {
+                ssize_t bytesRead = read(fd, &buffer[totalRead], buffer.size() - totalRead);
+                if (bytesRead <= 0)
+                {
+                    break;
+                }
+                totalRead += (size_t)bytesRead;
+            }
+            buffer.resize(totalRead);
+        }
+        close(fd); // file closed here
+
+        size_t position = 0;
+        char magic[sizeof(prefetchIndexMagic)]{};
+        uint32_t version = 0;
+        uint32_t mapCount = 0;
+
+        if (
+            !readBytes(buffer, position, magic, sizeof(magic))
+            || memcmp(magic, prefetchIndexMagic, sizeof(magic)) != 0
+            || !readBytes(buffer, position, &version, sizeof(version))
+            || version != prefetchIndexVersion
+            || !readBytes(buffer, position, &mapCount, sizeof(mapCount)))
+        {
+            printCstr("WARNING: "); printCstr(prefetchIndexFileName); printCstr(" isn't a valid prefetch index, it will be rebuilt\n");
+            return;
+        }
+
+        for (uint32_t mapIdx = 0; mapIdx < mapCount; mapIdx++)
+        {
+            std::string mapName;
+            uint32_t pathCount = 0;
+
+            if (!readString(buffer, position, mapName) || !readBytes(buffer, position, &pathCount, sizeof(pathCount)))
+            {
+                printCstr("WARNING: "); printCstr(prefetchIndexFileName); printCstr(" is truncated\n");
+                return;
+            }
+
+            std::vector<std::string>& paths = _index[mapName];
+            for (uint32_t pathIdx = 0; pathIdx < pathCount; pathIdx++)
+            {
+                std::string path;
+                if (!readString(buffer, position, path))
+                {
+                    printCstr("WARNING: "); printCstr(prefetchIndexFileName); printCstr(" is truncated\n");
+                    return;
+                }
+                if (paths.size() < prefetchMaxFilesPerMap)
+                {
+                    paths.push_back(std::move(path));
+                }
+            }
+        }
+    }
+
+    // the index is written to a temporary file first so a crash can't leave a half written index behind
+    static void writeIndex(const std::vector<char>& serializedIndex)
+    {
+        int fd = open(prefetchIndexTempFileName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644); // make sure this gets closed
+        if (fd == -1)
+        {
+            printCstr("ERROR: couldn't open "); printCstr(prefetchIndexTempFileName);
+            printCstr(": "); printInt(errno); printCstr("\n");
+            return;
+        }
+
+        size_t totalWritten = 0;
+        while (totalWritten < serializedIndex.size())
+        {
+            ssize_t bytesWritten = write(fd, &serializedIndex[totalWritten], serializedIndex.size() - totalWritten);
+            if (bytesWritten == -1)
+            {
+                printCstr("ERROR: couldn't write "); printCstr(prefetchIndexTempFileName);
+                printCstr(": "); printInt(errno); printCstr("\n");
+                close(fd);
+                return;
+            }
+            totalWritten += (size_t)bytesWritten;
+        }
+        close(fd); // file closed here
+
+        if (rename(prefetchIndexTempFileName, prefetchIndexFileName) == -1)
+        {
+            printCstr("ERROR: couldn't replace "); printCstr(prefetchIndexFileName);
+            printCstr(": "); printInt(errno); printCstr("\n");
+        }
+    }
+};
@@ -0,0 +1,212 @@
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <atomic>
+#include <string_view>
+
+static bool mmapStreamsActive = false;
+static const size_t mmapStreamMinimumSize = 64 * 1024; // smaller files aren't worth a mapping
+static const size_t stdioReadSize = 4096; // what a normal stdio stream reads per read syscall, used to estimate the savings
+
+// large game assets, other files are opened normally
+static const char* mmapStreamExtensions[] = {
+    ".dds",
+    ".dae",
+    ".ogg",
+    ".map_cache",
+    ".anim",
+    ".msh",
+    ".png",
+    ".jpg",
+    ".tga"
+};
+
+// added to when a stream is closed and printed when a load ends
+// bytesServed is how much was copied from mappings in userspace instead of being copied out of the page cache by read syscalls
+struct MmapStreamStatistics
+{
+    std::atomic<size_t> streamsClosed = 0;
+    std::atomic<size_t> bytesServed = 0;
+    std::atomic<size_t> readCalls = 0;
+    std::atomic<size_t> readSyscallsAvoided = 0;
+};
+
+static MmapStreamStatistics mmapStreamStatistics;
+
+struct MmapStreamCookie
+{
+    const char* data = nullptr;
+    size_t size = 0;
+    size_t position = 0;
+    size_t bytesServed = 0;
+    size_t readCalls = 0;
+};
+
+static ssize_t mmapStreamRead(void* cookie, char* buffer, size_t size)
+{
+    MmapStreamCookie* stream = (MmapStreamCookie*)cookie;
+    stream->readCalls += 1;
+
+    if (stream->position >= stream->size)
+    {
+        return 0;
+    }
+
+    size_t bytesToCopy = stream->size - stream->position < size ? stream->size - stream->position : size;
+    memcpy(buffer, stream->data + stream->position, bytesToCopy);
+    stream->position += bytesToCopy;
+    stream->bytesServed += bytesToCopy;
+
+    return (ssize_t)bytesToCopy;
+}
+
+static int mmapStreamSeek(void* cookie, off64_t* offset, int whence)
+{
+    MmapStreamCookie* stream = (MmapStreamCookie*)cookie;
+    off64_t newPosition = *offset;
+
+    if (whence == SEEK_CUR)
+    {
+        newPosition += (off64_t)stream->position;
+    }
+    else if (whence == SEEK_END)
+    {
+        newPosition += (off64_t)stream->size;
+    }
+    else if (whence != SEEK_SET)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (newPosition < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    stream->position = (size_t)newPosition; // seeking past the end is allowed, reads there return 0 bytes like normal files
+    *offset = newPosition;
+
+    return 0;
+}
+
+static int mmapStreamClose(void* cookie)
+{
+    MmapStreamCookie* stream = (MmapStreamCookie*)cookie;
+
+    // a normal stream would have used a read syscall per stdioReadSize bytes plus one to find the end of the file,
+    // the mapping uses mmap and munmap instead
+    size_t estimatedReadSyscalls = ((stream->bytesServed + stdioReadSize - 1) / stdioReadSize) + 1;
+    mmapStreamStatistics.streamsClosed.fetch_add(1, std::memory_order_relaxed);
+    mmapStreamStatistics.bytesServed.fetch_add(stream->bytesServed, std::memory_order_relaxed);
+    mmapStreamStatistics.readCalls.fetch_add(stream->readCalls, std::memory_order_relaxed);
+    mmapStreamStatistics.readSyscallsAvoided.fetch_add(estimatedReadSyscalls > 2 ? estimatedReadSyscalls - 2 : 0, std::memory_order_relaxed);
+
+    munmap((void*)stream->data, stream->size);
+    delete stream;
+
+    return 0;
+}
+
+static bool isMmapStreamCandidate(const char* mode, const std::string_view filename)
+{
+    // only plain read-only opens, anything that can write needs a real file
+    if (!(mode[0] == 'r' && (mode[1] == '\0' || (mode[1] == 'b' && mode[2] == '\0'))))
+    {
+        return false;
+    }
+
+    for (const char* extension : mmapStreamExtensions)
+    {
+        std::string_view extensionView(extension);
+        if (filename.size() > extensionView.size() && filename.substr(filename.size() - extensionView.size()) == extensionView)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// returns nullptr if the file should be opened normally instead. the stream has no file descriptor, so fileno gives -1
+static FILE* openMmapStream(const char* path, const char* mode, const std::string_view filename)
+{
+    if (!isMmapStreamCandidate(mode, filename))
+    {
+        return nullptr;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC); // make sure this gets closed
+    if (fd == -1)
+    {
+        return nullptr; // fopen will set errno the same way
+    }
+
+    struct stat fileStatus{};
+    if (fstat(fd, &fileStatus) == -1 || !S_ISREG(fileStatus.st_mode) || (size_t)fileStatus.st_size < mmapStreamMinimumSize)
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    size_t size = (size_t)fileStatus.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // file closed here, the mapping keeps the file open
+    if (data == MAP_FAILED)
+    {
+        return nullptr;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    MmapStreamCookie* stream = new (std::nothrow) MmapStreamCookie; // exceptions can't go back into the game
+    if (stream == nullptr)
+    {
+        munmap(data, size);
+        return nullptr;
+    }
+    stream->data = (const char*)data;
+    stream->size = size;
+
+    cookie_io_functions_t functions{};
+    functions.read = mmapStreamRead;
+    functions.seek = mmapStreamSeek;
+    functions.close = mmapStreamClose;
+
+    FILE* f = fopencookie(stream, "rb", functions);
+    if (f == nullptr)
+    {
+        munmap(data, size);
+        delete stream;
+        return nullptr;
+    }
+
+    // unbuffered, so each fread is one memcpy from the mapping into the game's buffer instead of going through a stdio buffer too.
+    // glibc gives large freads straight to mmapStreamRead, and small reads are a short memcpy each, which is still no syscall
+    setvbuf(f, nullptr, _IONBF, 0);
+
+    return f;
+}
+
+// prints what the mapped streams closed since the last report saved, then starts counting again
+static void reportMmapStreamStatistics()
+{
+    size_t streamsClosed = mmapStreamStatistics.streamsClosed.exchange(0, std::memory_order_relaxed);
+    size_t bytesServed = mmapStreamStatistics.bytesServed.exchange(0, std::memory_order_relaxed);
+    size_t readCalls = mmapStreamStatistics.readCalls.exchange(0, std::memory_order_relaxed);
+    size_t readSyscallsAvoided = mmapStreamStatistics.readSyscallsAvoided.exchange(0, std::memory_order_relaxed);
+
+    if (streamsClosed == 0)
+    {
+        return;
+    }
+
+    printCstr("mmap streams this load: "); printInt(streamsClosed); printCstr(" files, ");
+    printInt(bytesServed); printCstr(" bytes copied from mappings instead of by read syscalls, ");
+    printInt(readCalls); printCstr(" reads, about ");
+    printInt(readSyscallsAvoided); printCstr(" read syscalls avoided\n");
+}
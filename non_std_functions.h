@@ -1,6 +1,9 @@
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring> // memchr
 
 static const size_t fhelperBufferSize = 4096;
 
@@ -11,13 +14,13 @@ static size_t myStrlen(const char* cstr)
     return currentIdx;
 }
 
-static size_t myStrFind(const char* cstr, const char ch, size_t currentIdx)
+[[maybe_unused]] static size_t myStrFind(const char* cstr, const char ch, size_t currentIdx)
 {
     for (; cstr[currentIdx] != '\0' && cstr[currentIdx] != ch; currentIdx++);
     return currentIdx;
 }
 
-static int myStrncmp(const char* cstr1, const char* cstr2, const size_t stopIdx)
+[[maybe_unused]] static int myStrncmp(const char* cstr1, const char* cstr2, const size_t stopIdx)
 {
     static bool checked = false;
     if (!checked)
@@ -141,3 +144,123 @@ private:
     int _charactersRead = 0;
 };
 
+// Gives the lines of a whole file without copying them, so parsers don't need a getCharacter call per character.
+// Lines are found with memchr, and the '\n' isn't included in them.
+// By default the file is mapped. With copyFile, it's read into anonymous memory with as few read calls as possible instead,
+// for files which can be truncated while they're being parsed, because touching a truncated part of a mapping raises SIGBUS.
+class MappedFileLines
+{
+public:
+    bool opened = false;
+    
+    MappedFileLines(const MappedFileLines&) = delete;
+    MappedFileLines& operator=(MappedFileLines other) = delete;
+    MappedFileLines(MappedFileLines&&) = delete;
+    MappedFileLines& operator=(MappedFileLines&&) = delete;
+
+    explicit MappedFileLines(const char* filename, const bool copyFile = false)
+    {
+        int fd = open(filename, O_RDONLY | O_CLOEXEC); // make sure this gets closed
+        if (fd == -1)
+        {
+            printCstr("ERROR: MappedFileLines couldn't open "); printCstr(filename);
+            printCstr(": "); printInt(errno); printCstr("\n");
+            return;
+        }
+        
+        struct stat fileStatus{};
+        if (fstat(fd, &fileStatus) == -1)
+        {
+            printCstr("ERROR: MappedFileLines fstat failure for "); printCstr(filename);
+            printCstr(": "); printInt(errno); printCstr("\n");
+            close(fd);
+            return;
+        }
+        
+        opened = true;
+        _mappingSize = (size_t)fileStatus.st_size;
+        
+        if (_mappingSize != 0) // mmap doesn't allow empty mappings, an empty file just has no lines
+        {
+            void* mapping = copyFile
+                ? mmap(nullptr, _mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+                : mmap(nullptr, _mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            
+            if (mapping == MAP_FAILED)
+            {
+                printCstr("ERROR: MappedFileLines mmap failure for "); printCstr(filename);
+                printCstr(": "); printInt(errno); printCstr("\n");
+                opened = false;
+                _mappingSize = 0;
+            }
+            else
+            {
+                _data = (const char*)mapping;
+                _size = _mappingSize;
+                
+                if (copyFile)
+                {
+                    _size = 0;
+                    while (_size < _mappingSize) // the file might have shrunk since fstat, lines past what was read don't exist
+                    {
+                        ssize_t bytesRead = read(fd, (char*)mapping + _size, _mappingSize - _size);
+                        if (bytesRead <= 0)
+                        {
+                            break;
+                        }
+                        _size += (size_t)bytesRead;
+                    }
+                }
+                else
+                {
+                    madvise(mapping, _mappingSize, MADV_SEQUENTIAL);
+                }
+            }
+        }
+        
+        close(fd); // file closed here, a mapping keeps the file open
+    }
+
+    ~MappedFileLines()
+    {
+        if (_data != nullptr)
+        {
+            munmap((void*)_data, _mappingSize);
+            _data = nullptr;
+        }
+    }
+
+    // a '\n' at the end of the file doesn't start another line
+    bool nextLine(const char*& line, size_t& lineSize)
+    {
+        if (_position >= _size)
+        {
+            return false;
+        }
+        
+        line = _data + _position;
+        const char* newline = (const char*)memchr(line, '\n', _size - _position);
+        lineSize = newline != nullptr ? (size_t)(newline - line) : _size - _position;
+        _position += lineSize + 1;
+        
+        return true;
+    }
+
+    void resetFile()
+    {
+        _position = 0;
+    }
+
+    // false if the last line runs to the end of the file
+    bool endsWithNewline() const
+    {
+        return _size == 0 || _data[_size - 1] == '\n';
+    }
+
+private:
+    const char* _data = nullptr;
+    size_t _size = 0;
+    size_t _mappingSize = 0;
+    size_t _position = 0;
+};
+
@@ -0,0 +1,186 @@
+
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <string_view>
+#include <unordered_set>
+
+static bool warmPageCacheActive = false;
+static size_t warmPageCacheBudget = 0; // bytes, set from "page cache budget mb" in amnesia_settings.txt
+static const char assetManifestFileName[] = "asset_manifest.txt";
+static const size_t warmReadBufferSize = 128 * 1024;
+
+// these aren't in the glibc headers, they're from linux/ioprio.h
+static const int ioprioClassShift = 13;
+static const int ioprioClassIdle = 3;
+static const int ioprioWhoProcess = 1;
+
+// Reads the files listed in asset_manifest.txt into the page cache, in the order they're listed, on a thread with idle I/O priority.
+// It stops when warmPageCacheBudget bytes have been read.
+// Files the game opens which aren't in the manifest yet are added to the end of it when the game exits,
+// so the manifest lists files in the order previous runs first needed them.
+// Nothing here uses fopen because it would be intercepted by the hooks in load_extender.h.
+class PageCacheWarmer
+{
+public:
+    PageCacheWarmer(const PageCacheWarmer&) = delete;
+    PageCacheWarmer& operator=(PageCacheWarmer other) = delete;
+    PageCacheWarmer(PageCacheWarmer&&) = delete;
+    PageCacheWarmer& operator=(PageCacheWarmer&&) = delete;
+
+    PageCacheWarmer()
+    {
+        readManifest();
+        _worker = std::thread(&PageCacheWarmer::warmFiles, this);
+    }
+
+    ~PageCacheWarmer()
+    {
+        _stopWorker.store(true, std::memory_order_relaxed);
+        _worker.join();
+
+        appendNewPathsToManifest();
+    }
+
+    void fileOpened(const char* path)
+    {
+        std::string_view pathView(path);
+        if (pathView.empty() || pathView.find('\n') != std::string_view::npos)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_knownPaths.emplace(pathView).second)
+        {
+            _newPaths.emplace_back(pathView);
+        }
+    }
+
+private:
+    std::mutex _mutex; // protects _knownPaths and _newPaths, _manifestPaths isn't changed after the constructor
+    std::thread _worker;
+    std::atomic<bool> _stopWorker = false;
+
+    std::vector<std::string> _manifestPaths;
+    std::unordered_set<std::string> _knownPaths;
+    std::vector<std::string> _newPaths;
+    bool _manifestNeedsNewline = false; // if someone edited the manifest and left out the last newline
+
+    void readManifest()
+    {
+        if (access(assetManifestFileName, F_OK) == -1) // the manifest gets made when the game exits
+        {
+            return;
+        }
+
+        MappedFileLines lines(assetManifestFileName);
+        if (!lines.opened) // error message will have been printed in the constructor
+        {
+            return;
+        }
+
+        const char* line = nullptr;
+        size_t lineSize = 0;
+
+        while (lines.nextLine(line, lineSize))
+        {
+            std::string_view path(line, lineSize);
+            if (!path.empty() && path.back() == '\r') // windows puts this at the end of lines
+            {
+                path.remove_suffix(1);
+            }
+            if (!path.empty() && _knownPaths.emplace(path).second)
+            {
+                _manifestPaths.emplace_back(path);
+            }
+        }
+
+        _manifestNeedsNewline = !lines.endsWithNewline();
+    }
+
+    void warmFiles()
+    {
+        // the game's own reads always go first, this thread's reads only get disk time nothing else wants
+        if (syscall(SYS_ioprio_set, ioprioWhoProcess, 0, ioprioClassIdle << ioprioClassShift) == -1) // 0 means the calling thread
+        {
+            printCstr("WARNING: ioprio_set failure, page cache warming will use normal I/O priority: "); printInt(errno); printCstr("\n");
+        }
+
+        std::unique_ptr<char[]> readBuffer = std::make_unique<char[]>(warmReadBufferSize);
+        size_t budgetRemaining = warmPageCacheBudget;
+
+        for (const std::string& path : _manifestPaths)
+        {
+            if (budgetRemaining == 0 || _stopWorker.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC); // make sure this gets closed
+            if (fd == -1)
+            {
+                continue;
+            }
+
+            while (budgetRemaining != 0 && !_stopWorker.load(std::memory_order_relaxed))
+            {
+                ssize_t bytesRead = read(fd, readBuffer.get(), std::min(warmReadBufferSize, budgetRemaining));
+                if (bytesRead <= 0)
+                {
+                    break;
+                }
+                budgetRemaining -= (size_t)bytesRead;
+            }
+
+            close(fd); // file closed here
+        }
+    }
+
+    void appendNewPathsToManifest()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_newPaths.empty())
+        {
+            return;
+        }
+
+        std::string text(_manifestNeedsNewline ? "\n" : "");
+        for (const std::string& path : _newPaths)
+        {
+            text += path;
+            text += '\n';
+        }
+
+        int fd = open(assetManifestFileName, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644); // make sure this gets closed
+        if (fd == -1)
+        {
+            printCstr("ERROR: couldn't open "); printCstr(assetManifestFileName);
+            printCstr(": "); printInt(errno); printCstr("\n");
+            return;
+        }
+
+        size_t totalWritten = 0;
+        while (totalWritten < text.size())
+        {
+            ssize_t bytesWritten = write(fd, &text[totalWritten], text.size() - totalWritten);
+            if (bytesWritten == -1)
+            {
+                printCstr("ERROR: couldn't write "); printCstr(assetManifestFileName);
+                printCstr(": "); printInt(errno); printCstr("\n");
+                break;
+            }
+            totalWritten += (size_t)bytesWritten;
+        }
+
+        close(fd); // file closed here
+    }
+};
@@ -0,0 +1,93 @@
+
+#include <cstdint>
+#include <cstdlib> // getenv
+
+// timer_events.h and non_std_functions.h have to be included before this
+
+// Times each part of readSettingsAndGetResources, to find out where the delay before the game window appears goes.
+// It's off unless AMNESIA_TOOL_PROFILE_STARTUP is set to 1, and then the constructor prints one line like
+//     startup (us): config cache 35, settings 0, memfd name 12, maps 96, ... total 1480
+// start reads the variable with getenv, which only reads environ, so it's safe in the constructor like the rendezvous file's getenv.
+// After that only clock_gettime and write are used.
+enum class StartupPhase
+{
+    ConfigCache, // reading the text files' stamps and loading the config cache
+    Settings, // reading amnesia_settings.txt when the cache couldn't be used
+    MemfdName,
+    Maps, // finding the game's executable memory in /proc/self/maps
+    FlashbackNames, // creating the shared memory and copying the flashback names into it
+    Memfd, // creating or sealing the shared memory
+    PatternScan, // findInstructions
+    Mprotect, // both mprotects
+    Injection,
+    FunctionProbes, // installFunctionProbes when "profile functions" is on
+    Rendezvous,
+    CacheRebuild,
+    Count
+};
+
+static const char* startupPhaseNames[(size_t)StartupPhase::Count] = {
+    "config cache",
+    "settings",
+    "memfd name",
+    "maps",
+    "flashback names",
+    "memfd",
+    "pattern scan",
+    "mprotect",
+    "injection",
+    "function probes",
+    "rendezvous",
+    "cache rebuild"
+};
+
+class StartupProfiler
+{
+public:
+    void start()
+    {
+        const char* setting = getenv("AMNESIA_TOOL_PROFILE_STARTUP");
+        active = setting != nullptr && setting[0] == '1';
+        if (active)
+        {
+            startNanoseconds = getMonotonicNanoseconds();
+            lastNanoseconds = startNanoseconds;
+        }
+    }
+
+    // everything since the last phase ended is counted for this one, so a phase can end more than once
+    void endPhase(const StartupPhase phase)
+    {
+        if (!active)
+        {
+            return;
+        }
+
+        int64_t now = getMonotonicNanoseconds();
+        phaseNanoseconds[(size_t)phase] += now - lastNanoseconds;
+        lastNanoseconds = now;
+    }
+
+    void print(const bool succeeded)
+    {
+        if (!active)
+        {
+            return;
+        }
+
+        printCstr(succeeded ? "startup (us): " : "startup before failing (us): ");
+        for (size_t i = 0; i < (size_t)StartupPhase::Count; i++)
+        {
+            printCstr(startupPhaseNames[i]); printCstr(" "); printInt((size_t)(phaseNanoseconds[i] / 1000)); printCstr(", ");
+        }
+        printCstr("total "); printInt((size_t)((lastNanoseconds - startNanoseconds) / 1000)); printCstr("\n");
+    }
+
+private:
+    bool active = false;
+    int64_t startNanoseconds = 0;
+    int64_t lastNanoseconds = 0;
+    int64_t phaseNanoseconds[(size_t)StartupPhase::Count]{};
+};
+
+static StartupProfiler startupProfiler;
@@ -0,0 +1,173 @@
+
+#include <cstdint>
+#include <atomic>
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <dlfcn.h>
+
+// tool_counters.h, frame_times.h and timer_events.h have to be included before this
+
+// The game's buffer swaps go through these hooks, like its stdio opens go through the ones in load_extender.h, and the time between
+// two swaps is a frame. SDL 2 games call SDL_GL_SwapWindow, SDL 1.2 games call SDL_GL_SwapBuffers, and both call glXSwapBuffers
+// from inside, so a swap is only recorded by the outermost hook. SDL usually gets glXSwapBuffers from libGL with dlsym, which
+// doesn't go through the tool's glXSwapBuffers, so that one only sees games which call glXSwapBuffers themselves.
+// The frame is recorded after the swap returns, so time waiting for vsync is part of the frame it ends.
+static thread_local int swapHookDepth = 0;
+
+// only used by the thread which swaps buffers
+static int64_t lastSwapNanoseconds = 0;
+static uint64_t hookedOpensAtLastSwap = 0;
+static uint64_t delayNanosecondsAtLastSwap = 0;
+
+static uint64_t countHookedOpens(ToolCounters* counters)
+{
+    return readCounter(counters->fopenCalls) + readCounter(counters->freopenCalls)
+        + readCounter(counters->fopen64Calls) + readCounter(counters->freopen64Calls);
+}
+
+static FrameLoadState getFrameLoadState(TimerSharedHeader* header, ToolCounters* counters, const int64_t now)
+{
+    if (std::atomic_ref<uint32_t>(header->paused).load(std::memory_order_relaxed) != 0)
+    {
+        return FrameLoadState::Loading;
+    }
+    int64_t lastEventNanoseconds = std::atomic_ref<int64_t>(header->lastEventNanoseconds).load(std::memory_order_relaxed);
+    bool resumedBefore = readCounter(counters->eventCounts[0]) != 0; // otherwise the last event time is when the tool started
+    return resumedBefore && now - lastEventNanoseconds < frameTimeAfterLoadNanoseconds ? FrameLoadState::AfterLoad : FrameLoadState::Playing;
+}
+
+static void recordFrameTime()
+{
+    // read once, since stopTimerEvents sets them to nullptr when the game exits, which a render thread could still be swapping during.
+    // the shared memory itself stays mapped until the process is gone
+    FrameTimes* times = frameTimes;
+    TimerSharedHeader* header = timerEventHeader;
+    ToolCounters* counters = toolCounters;
+    if (times == nullptr || header == nullptr || counters == nullptr)
+    {
+        return;
+    }
+
+    int64_t now = getMonotonicNanoseconds();
+    uint64_t hookedOpens = countHookedOpens(counters);
+    uint64_t delayNanoseconds = readCounter(counters->delayNanoseconds);
+    int64_t frameNanoseconds = now - lastSwapNanoseconds;
+    uint64_t frameOpens = hookedOpens - hookedOpensAtLastSwap;
+    uint64_t frameDelayNanoseconds = delayNanoseconds - delayNanosecondsAtLastSwap;
+    bool firstSwap = lastSwapNanoseconds == 0;
+    lastSwapNanoseconds = now;
+    hookedOpensAtLastSwap = hookedOpens;
+    delayNanosecondsAtLastSwap = delayNanoseconds;
+    if (firstSwap) // the first frame's start isn't known
+    {
+        return;
+    }
+
+    FrameLoadState loadState = getFrameLoadState(header, counters, now);
+    FrameTimeHistogram& histogram = times->histograms[(size_t)loadState];
+    addToCounter(histogram.frames, 1);
+    addToCounter(histogram.totalNanoseconds, (uint64_t)frameNanoseconds);
+    raiseCounter(histogram.longestNanoseconds, (uint64_t)frameNanoseconds);
+    addToCounter(histogram.hookedOpens, frameOpens);
+    addToCounter(histogram.delayNanoseconds, frameDelayNanoseconds);
+    uint64_t bucket = (uint64_t)frameNanoseconds / frameTimeBucketNanoseconds;
+    std::atomic_ref<uint32_t>(histogram.buckets[bucket < frameTimeBucketCount ? bucket : frameTimeBucketCount - 1]).fetch_add(1, std::memory_order_relaxed);
+
+    std::atomic_ref<uint32_t> frameSequence(times->frameSequence);
+    uint32_t sequence = frameSequence.load(std::memory_order_relaxed) + 1;
+    FrameTimeRecord& record = times->ring[(sequence - 1) & (frameTimeRingCapacity - 1)];
+
+    std::atomic_ref<uint32_t> recordSequence(record.sequence);
+    recordSequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::atomic_ref<uint8_t>(record.loadState).store((uint8_t)loadState, std::memory_order_relaxed);
+    std::atomic_ref<uint16_t>(record.hookedOpens).store(frameOpens < UINT16_MAX ? (uint16_t)frameOpens : UINT16_MAX, std::memory_order_relaxed);
+    std::atomic_ref<int64_t>(record.swapNanoseconds).store(now, std::memory_order_relaxed);
+    std::atomic_ref<int64_t>(record.frameNanoseconds).store(frameNanoseconds, std::memory_order_relaxed);
+    std::atomic_ref<int64_t>(record.delayNanoseconds).store((int64_t)frameDelayNanoseconds, std::memory_order_relaxed);
+    recordSequence.store(sequence, std::memory_order_release);
+
+    frameSequence.store(sequence, std::memory_order_release);
+}
+
+// libGL and libSDL are usually loaded before the tool's hooks are first called, but if the game loaded them with dlopen
+// they aren't after the tool in the search order, so RTLD_NEXT can't find them. until the function is found, it's looked for again
+// on every call, in case the game loads the library later
+static void* findOriginalSwapFunction(std::atomic<void*>& found, const char* name, const char* libraryName)
+{
+    void* function = found.load(std::memory_order_acquire);
+    if (function != nullptr)
+    {
+        return function;
+    }
+
+    function = dlsym(RTLD_NEXT, name);
+    if (function == nullptr)
+    {
+        void* library = dlopen(libraryName, RTLD_LAZY | RTLD_NOLOAD); // make sure this gets closed
+        if (library != nullptr)
+        {
+            function = dlsym(library, name);
+            dlclose(library); // closed here, the game still has it open
+        }
+    }
+    if (function != nullptr)
+    {
+        found.store(function, std::memory_order_release);
+    }
+    return function;
+}
+
+extern "C" void glXSwapBuffers(void* display, unsigned long drawable)
+{
+    static std::atomic<void*> originalGlxSwapBuffersFound = nullptr;
+    auto originalGlxSwapBuffers = reinterpret_cast<void (*)(void* display, unsigned long drawable)>(
+        findOriginalSwapFunction(originalGlxSwapBuffersFound, "glXSwapBuffers", "libGL.so.1"));
+
+    swapHookDepth++;
+    if (originalGlxSwapBuffers != nullptr)
+    {
+        originalGlxSwapBuffers(display, drawable);
+    }
+    if (--swapHookDepth == 0)
+    {
+        recordFrameTime();
+    }
+}
+
+extern "C" void SDL_GL_SwapWindow(void* window)
+{
+    static std::atomic<void*> originalSdlGlSwapWindowFound = nullptr;
+    auto originalSdlGlSwapWindow = reinterpret_cast<void (*)(void* window)>(
+        findOriginalSwapFunction(originalSdlGlSwapWindowFound, "SDL_GL_SwapWindow", "libSDL2-2.0.so.0"));
+
+    swapHookDepth++;
+    if (originalSdlGlSwapWindow != nullptr)
+    {
+        originalSdlGlSwapWindow(window);
+    }
+    if (--swapHookDepth == 0)
+    {
+        recordFrameTime();
+    }
+}
+
+extern "C" void SDL_GL_SwapBuffers()
+{
+    static std::atomic<void*> originalSdlGlSwapBuffersFound = nullptr;
+    auto originalSdlGlSwapBuffers = reinterpret_cast<void (*)()>(
+        findOriginalSwapFunction(originalSdlGlSwapBuffersFound, "SDL_GL_SwapBuffers", "libSDL-1.2.so.0"));
+
+    swapHookDepth++;
+    if (originalSdlGlSwapBuffers != nullptr)
+    {
+        originalSdlGlSwapBuffers();
+    }
+    if (--swapHookDepth == 0)
+    {
+        recordFrameTime();
+    }
+}
@@ -1,330 +1,387 @@
 
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <unistd.h>
-#include <dirent.h>
-#include <cstring>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
 #include <errno.h>
-#include <string>
-#include <atomic>
-#include <stdexcept>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
 
-bool findPid(pid_t& pid, std::string& pidString, const char** gameNames, size_t howManyGameNames)
+#include "amnesia_timer.h"
+#include "timer_event_server.h"
+
+static void printEvent(const AmnesiaTimer* timer, const AmnesiaTimerEvent& event)
 {
-    char pathBuffer[64]{};
-    char fileTextBuffer[256]{};
-    FILE* f = nullptr;
-    
-    struct dirent *directoryEntry;
-    DIR* procDirectory = opendir("/proc"); // make sure this gets closed
-    if (procDirectory == nullptr)
+    printf("%lld.%06lld ms: ", (long long)(event.monotonicNanoseconds / 1000000), (long long)(event.monotonicNanoseconds % 1000000));
+    if (event.eventCode == amnesiaTimerResume)
     {
-        printf("error opening proc directory: %d", errno);
-        return false;
+        printf("resume timer");
     }
-    
-    bool foundPID = false;
-    while ((directoryEntry = readdir(procDirectory)) && !foundPID)
+    else if (event.eventCode == amnesiaTimerPause)
     {
-        size_t truncationCheck = snprintf(pathBuffer, sizeof(pathBuffer), "/proc/%s/cmdline", directoryEntry->d_name);
-        if (truncationCheck >= sizeof(pathBuffer))
-        {
-            continue;
-        }
-        
-        f = fopen(pathBuffer, "r"); // make sure this also gets closed
-        if (!f)
+        printf("pause timer without splitting");
+    }
+    else if (event.eventCode == amnesiaTimerPauseAndSplit)
+    {
+        printf("pause timer and split");
+    }
+    else if (event.eventCode == amnesiaTimerGameClosed)
+    {
+        printf("finished");
+    }
+    else
+    {
+        printf("unknown event %u", event.eventCode);
+    }
+
+    // the tool keeps these itself, so they don't depend on how quickly this program woke up
+    AmnesiaTimerTotals totals{};
+    amnesiaTimerTotals(timer, &totals);
+    printf(" (load removed time %lld.%03lld s)\n", (long long)(totals.loadRemovedNanoseconds / 1000000000), (long long)(totals.loadRemovedNanoseconds / 1000000 % 1000));
+}
+
+static int64_t monotonicMilliseconds()
+{
+    struct timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+// epoll data is the pid (or the server's file descriptor) shifted left by 2, with what it's for in the low 2 bits
+static const uint64_t notifyFdTag = 0;
+static const uint64_t exitFdTag = 1;
+
+// returns false when the game is finished. server is nullptr unless it's serving events
+static bool printInstanceEvents(const int pid, AmnesiaTimer* timer, TimerEventServer* server)
+{
+    AmnesiaTimerEvent event{};
+    while (true)
+    {
+        int result = amnesiaTimerPoll(timer, &event);
+        if (result != amnesiaTimerGotEvent)
         {
-            errno = 0;
-            continue;
+            return result == amnesiaTimerNoEvent;
         }
-        
-        size_t bytesRead = fread(fileTextBuffer, sizeof(char), sizeof(fileTextBuffer), f);
-        size_t filenameIndex = 0;
-        size_t lastSlashIndex = 0;
-        for (; fileTextBuffer[filenameIndex] != '\0' && filenameIndex < bytesRead; filenameIndex++)
+
+        if (event.missedEvents != 0)
         {
-            if (fileTextBuffer[filenameIndex] == '/')
-            {
-                lastSlashIndex = filenameIndex;
-            }
+            printf("[%d] missed %u events\n", pid, event.missedEvents);
         }
-        if (filenameIndex != bytesRead && lastSlashIndex != 0)
+        printf("[%d] ", pid);
+        printEvent(timer, event);
+        if (server != nullptr)
         {
-            for (int i = 0; i < howManyGameNames; i++)
-            {
-                if (strcmp(gameNames[i], fileTextBuffer + lastSlashIndex) == 0)
-                {
-                    pidString = directoryEntry->d_name;
-                    pid = stol(pidString);
-                    foundPID = true;
-                    break;
-                }
-            }
+            server->gameEvent(pid, timer, event);
         }
-        
-        fclose(f); // file closed here
-    }
-    
-    closedir(procDirectory); // directory closed here
-    
-    if (!foundPID)
-    {
-        printf("Couldn't find game PID\n");
-        return false;
     }
-    
-    return true;
 }
 
-static bool getMemfdName(char* memfdName, const size_t memfdNameBufferSize, size_t& linkFirstPartSize)
+static void detachInstance(const int epollFd, std::map<int, AmnesiaTimer*>& instances, const int pid)
 {
-    const int memfdNameMaxSize = 249; // "The limit is 249 bytes, excluding the terminating null byte."
-    const char fileWithMemfdName[] = "shared_memory_name.txt";
-    
-    FILE* f = fopen(fileWithMemfdName, "rb"); // make sure this gets closed
-    if (!f)
-    {
-        printf("fopen error when opening %s: %d\n", fileWithMemfdName, errno);
-        return false;
-    }
-    
-    int charactersRead = fread(&memfdName[0], 1, memfdNameBufferSize, f);
-    fclose(f); // file closed here
-    f = nullptr;
-    if (charactersRead == memfdNameBufferSize)
-    {
-        printf("%s should be shorter than %zu bytes\n", fileWithMemfdName, memfdNameBufferSize);
-        return false;
-    }
-    
-    // removing non-alphanumeric characters and characters which aren't dashes or underscores
-    int write_idx = 0;
-    for (int i = 0; memfdName[i] != '\0'; i++)
+    AmnesiaTimer* timer = instances[pid];
+    if (amnesiaTimerNotifyFd(timer) != -1)
     {
-        memfdName[write_idx] = memfdName[i];
-        write_idx += (
-            (memfdName[i] >= '0' && memfdName[i] <= '9')
-            || (memfdName[i] >= 'a' && memfdName[i] <= 'z')
-            || (memfdName[i] >= 'A' && memfdName[i] <= 'Z')
-            || memfdName[i] == '-'
-            || memfdName[i] == '_'
-        );
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, amnesiaTimerNotifyFd(timer), nullptr);
     }
-    memfdName[write_idx] = '\0';
-    linkFirstPartSize = write_idx + 7; // + 7 for "/memfd:" start text
-    if (write_idx == 0)
+    if (amnesiaTimerExitFd(timer) != -1)
     {
-        printf("empty shared memory name\n");
-        return false;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, amnesiaTimerExitFd(timer), nullptr);
     }
-    else if (write_idx > memfdNameMaxSize)
-    {
-        printf("shared memory name needs to be %d characters or less\n", memfdNameMaxSize);
-        return false;
-    }
-    
-    return true;
+    amnesiaTimerDetach(timer); // detached here
+    instances.erase(pid);
 }
 
-bool findMemFile(std::string& pathString)
+// closedPids are games which already finished but haven't exited yet, so they aren't attached to again
+static void attachNewInstances(const int epollFd, std::map<int, AmnesiaTimer*>& instances, std::set<int>& failedPids, std::set<int>& closedPids,
+    TimerEventServer* server)
 {
-    size_t linkFirstPartSize = 0;
-    char linkFirstPart[327] = "/memfd:"; // 320, plus 7 for "/memfd:" start text
-    if (!getMemfdName(&linkFirstPart[7], sizeof(linkFirstPart) - 7, linkFirstPartSize)) // starting at index 7, ahead of "/memfd:" start text
-    {
-        return false;
-    }
-    char linkSecondPart[] = " (deleted)";
-    
-    std::string pathStringCopy = pathString;
-    char symlinkBuffer[7 + 249 + 10 + 1]{}; // "/memfd:" + maximum allowed memfd name size + " (deleted)" + null terminator
-    size_t pathStringOriginalSize = pathString.size();
-    
-    struct dirent *directoryEntry;
-    DIR* fhDirectory = opendir(pathString.c_str()); // make sure this gets closed
-    if (fhDirectory == nullptr)
+    int pids[64]{};
+    int howManyPids = amnesiaTimerFindGames(pids, sizeof(pids) / sizeof(int));
+    if (howManyPids == -1)
     {
-        printf("error opening proc directory: %d", errno);
-        return false;
+        return;
     }
-    
-    bool foundfhCount = 0;
-    while ((directoryEntry = readdir(fhDirectory)))
+
+    std::set<int> stillFailedPids;
+    std::set<int> stillClosedPids;
+    for (int i = 0; i < howManyPids; i++)
     {
-        pathStringCopy += directoryEntry->d_name;
-        ssize_t readlinkBytesRead = readlink(pathStringCopy.c_str(), symlinkBuffer, sizeof(symlinkBuffer));
-        if (readlinkBytesRead == sizeof(symlinkBuffer))
+        if (closedPids.count(pids[i]) != 0)
         {
-            pathStringCopy.resize(pathStringOriginalSize);
+            stillClosedPids.insert(pids[i]);
             continue;
         }
-        else if (readlinkBytesRead == -1)
+        if (instances.count(pids[i]) != 0)
         {
-            errno = 0;
-            pathStringCopy.resize(pathStringOriginalSize);
             continue;
         }
-        symlinkBuffer[readlinkBytesRead] = '\0';
-        
-        if (
-            (strncmp(linkFirstPart, symlinkBuffer, linkFirstPartSize) == 0)
-            && (
-                symlinkBuffer[linkFirstPartSize] == '\0'
-                || strcmp(linkSecondPart, &symlinkBuffer[linkFirstPartSize]) == 0
-            )
-        )
+
+        AmnesiaTimer* timer = amnesiaTimerAttachPid(pids[i], nullptr); // remember to detach
+        if (timer == nullptr)
         {
-            pathString = pathStringCopy;
-            foundfhCount += 1;
+            // the tool might not be ready yet, so it's tried again on the next search without printing the same error again
+            if (failedPids.count(pids[i]) == 0)
+            {
+                printf("[%d] %s\n", pids[i], amnesiaTimerLastError());
+            }
+            stillFailedPids.insert(pids[i]);
+            continue;
+        }
+        instances[pids[i]] = timer;
+
+        struct epoll_event notifyEvent{};
+        notifyEvent.events = EPOLLIN | EPOLLET; // edge triggered because other programs share the eventfd, so it's never read
+        notifyEvent.data.u64 = ((uint64_t)pids[i] << 2) | notifyFdTag;
+        struct epoll_event exitEvent{};
+        exitEvent.events = EPOLLIN;
+        exitEvent.data.u64 = ((uint64_t)pids[i] << 2) | exitFdTag;
+        if (amnesiaTimerNotifyFd(timer) != -1)
+        {
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, amnesiaTimerNotifyFd(timer), &notifyEvent);
+        }
+        if (amnesiaTimerExitFd(timer) != -1)
+        {
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, amnesiaTimerExitFd(timer), &exitEvent);
+        }
+
+        printf("[%d] load detection ready%s.\n", pids[i], amnesiaTimerNotifyFd(timer) == -1 ? " (without eventfd, polling)" : "");
+        if (server != nullptr)
+        {
+            server->gameAttached(pids[i], timer);
         }
-        
-        pathStringCopy.resize(pathStringOriginalSize);
     }
-    
-    closedir(fhDirectory); // directory closed here
-    
-    if (foundfhCount == 0)
+    failedPids.swap(stillFailedPids);
+    closedPids.swap(stillClosedPids);
+}
+
+// watches every running game from one thread. games which start later are found by searching /proc every second,
+// and games whose eventfd couldn't be copied are polled every 15 ms instead.
+// if serve is true, the events are also pushed to programs connected to the sockets in amnesia_timer.h
+static int watchAllGames(const bool serve)
+{
+    const int searchIntervalMilliseconds = 1000;
+    const int pollIntervalMilliseconds = 15;
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC); // make sure this gets closed
+    if (epollFd == -1)
     {
-        printf("Couldn't find memfd_create file handle\n");
-        return false;
+        printf("epoll_create1 error: %d\n", errno);
+        return EXIT_FAILURE;
     }
-    else if (foundfhCount > 1)
+
+    TimerEventServer eventServer;
+    TimerEventServer* server = nullptr;
+    if (serve)
     {
-        printf("memfd_create file name already being used by the process. Choose a different name and retry\n");
-        return false;
+        if (!eventServer.start(epollFd))
+        {
+            close(epollFd);
+            return EXIT_FAILURE;
+        }
+        server = &eventServer;
+        printf("serving events on @%s and @%s\n", AMNESIA_TIMER_SOCKET_NAME, AMNESIA_TIMER_TEXT_SOCKET_NAME);
     }
-    
-    return true;
-}
 
-bool getResources(int& fd, void*& mmapAddress, bool& mlockSucceeded)
-{
-    try
+    std::map<int, AmnesiaTimer*> instances;
+    std::set<int> failedPids;
+    std::set<int> closedPids;
+    attachNewInstances(epollFd, instances, failedPids, closedPids, server);
+    int64_t lastSearch = monotonicMilliseconds();
+
+    struct epoll_event readyEvents[32]{};
+    while (true)
     {
-        const char* gameNames[4] = {
-            "/Amnesia_NOSTEAM.bin.x86_64",
-            "/Amnesia.bin.x86_64",
-            "/Amnesia_NOSTEAM.bin.x86",
-            "/Amnesia.bin.x86"
-        };
-        
-        pid_t pid = 0;
-        std::string pidString;
-        if (!findPid(pid, pidString, gameNames, sizeof(gameNames) / sizeof(char*)))
+        bool anyPolled = false;
+        for (const auto& instance : instances)
         {
-            return false;
+            anyPolled |= amnesiaTimerNotifyFd(instance.second) == -1 || amnesiaTimerExitFd(instance.second) == -1;
         }
-        
-        std::string pathString = "/proc/";
-        pathString += pidString;
-        pathString += "/fd/";
-        
-        if (!findMemFile(pathString))
+
+        int64_t untilSearch = searchIntervalMilliseconds - (monotonicMilliseconds() - lastSearch);
+        int timeout = untilSearch < 0 ? 0 : (int)untilSearch;
+        if (anyPolled && timeout > pollIntervalMilliseconds)
         {
-            return false;
+            timeout = pollIntervalMilliseconds;
         }
-        
-        fd = open(pathString.c_str(), O_RDONLY);
-        if (fd == -1)
+
+        int howManyReady = epoll_wait(epollFd, readyEvents, sizeof(readyEvents) / sizeof(struct epoll_event), timeout);
+        if (howManyReady == -1 && errno != EINTR)
         {
-            printf("open failure: %d\n", errno);
-            return false;
+            printf("epoll_wait error: %d\n", errno);
+            break;
         }
-        
-        mmapAddress = mmap(nullptr, 1, PROT_READ, MAP_SHARED, fd, 0);
-        if (mmapAddress == MAP_FAILED)
+
+        std::set<int> finishedPids;
+        for (int i = 0; i < howManyReady; i++)
         {
-            printf("mmap failure: %d\n", errno);
-            return false;
+            uint64_t tag = readyEvents[i].data.u64 & 3;
+            if (tag == TimerEventServer::serverEpollTag)
+            {
+                eventServer.handleEpollEvent(readyEvents[i]);
+                continue;
+            }
+
+            int pid = (int)(readyEvents[i].data.u64 >> 2);
+            if (instances.count(pid) == 0)
+            {
+                continue;
+            }
+
+            // events are always checked, so the game's last events are printed before it's detached
+            if (!printInstanceEvents(pid, instances[pid], server) || tag == exitFdTag)
+            {
+                finishedPids.insert(pid);
+            }
+        }
+        for (const auto& instance : instances)
+        {
+            if (anyPolled && (amnesiaTimerNotifyFd(instance.second) == -1 || amnesiaTimerExitFd(instance.second) == -1)
+                && !printInstanceEvents(instance.first, instance.second, server))
+            {
+                finishedPids.insert(instance.first);
+            }
+        }
+        for (int pid : finishedPids)
+        {
+            printf("[%d] game closed\n", pid);
+            if (server != nullptr)
+            {
+                server->gameClosed(pid, instances[pid]);
+            }
+            detachInstance(epollFd, instances, pid);
+            closedPids.insert(pid);
         }
-            
-        if (mlock(mmapAddress, 1) == -1)
+
+        if (monotonicMilliseconds() - lastSearch >= searchIntervalMilliseconds)
         {
-            printf("mlock failure: %d\n", errno);
-            return false;
+            attachNewInstances(epollFd, instances, failedPids, closedPids, server);
+            lastSearch = monotonicMilliseconds();
         }
-        mlockSucceeded = true;
+        fflush(stdout);
     }
-    catch (const std::runtime_error& e)
+
+    eventServer.stop();
+    while (!instances.empty())
     {
-        char const* fixC4101Warning = e.what();
-        printf("unexpected error: %s\n", fixC4101Warning);
-        
-        return false;
+        detachInstance(epollFd, instances, instances.begin()->first);
     }
-    
-    return true;
+    close(epollFd); // epoll closed here
+
+    return EXIT_FAILURE;
 }
 
-void freeResources(int& fd, void*& mmapAddress, bool& mlockSucceeded)
+// prints the first game's counters once a second, and whenever there's an event, until the game closes
+static int printCountersLive()
 {
-    if (fd != -1)
+    AmnesiaTimer* timer = amnesiaTimerAttach(nullptr); // remember to detach
+    if (timer == nullptr)
     {
-        close(fd);
-        fd = -1;
+        printf("%s\n", amnesiaTimerLastError());
+        return EXIT_FAILURE;
     }
-    if (mlockSucceeded)
+
+    AmnesiaTimerCounters counters{};
+    if (amnesiaTimerCounters(timer, &counters) != 0)
     {
-        munlock(mmapAddress, 1);
-        mlockSucceeded = false;
+        printf("the tool doesn't have counters, it might be an older version\n");
+        amnesiaTimerDetach(timer);
+        return EXIT_FAILURE;
     }
-    if (mmapAddress != MAP_FAILED)
+
+    AmnesiaTimerEvent event{};
+    bool finished = false;
+    while (!finished)
     {
-        munmap(mmapAddress, 1);
-        mmapAddress = MAP_FAILED;
+        amnesiaTimerCounters(timer, &counters);
+        printf("fopen %llu, freopen %llu, fopen64 %llu, freopen64 %llu | delayed files %llu, delays %lld ms, longest %lld ms"
+            " | flashback skips %llu, flashback waits %llu ms | resume %llu, pause %llu, split %llu, closed %llu\n",
+            (unsigned long long)counters.fopenCalls, (unsigned long long)counters.freopenCalls,
+            (unsigned long long)counters.fopen64Calls, (unsigned long long)counters.freopen64Calls,
+            (unsigned long long)counters.delayedFiles, (long long)(counters.delayNanoseconds / 1000000),
+            (long long)(counters.longestDelayNanoseconds / 1000000), (unsigned long long)counters.flashbackSkips,
+            (unsigned long long)counters.flashbackWaits, (unsigned long long)counters.eventCounts[0], (unsigned long long)counters.eventCounts[1],
+            (unsigned long long)counters.eventCounts[2], (unsigned long long)counters.eventCounts[3]);
+        const char* stateNames[] = {"playing", "loading", "after loads"};
+        for (int state = amnesiaTimerFramePlaying; state <= amnesiaTimerFrameAfterLoad; state++)
+        {
+            AmnesiaTimerFrameTimes frameTimes{};
+            if (amnesiaTimerFrameTimes(timer, state, &frameTimes) == 0 && frameTimes.frames != 0)
+            {
+                printf("    frames %s: %llu, p50 %.2f ms, p99 %.2f ms, longest %.2f ms, %llu hooked opens, delays %lld ms\n", stateNames[state],
+                    (unsigned long long)frameTimes.frames, (double)frameTimes.p50Nanoseconds / 1e6, (double)frameTimes.p99Nanoseconds / 1e6,
+                    (double)frameTimes.longestNanoseconds / 1e6, (unsigned long long)frameTimes.hookedOpens,
+                    (long long)(frameTimes.delayNanoseconds / 1000000));
+            }
+        }
+        fflush(stdout);
+
+        int result = amnesiaTimerWait(timer, &event, 1000000000);
+        finished = result == amnesiaTimerFinished || result == amnesiaTimerError
+            || (result == amnesiaTimerGotEvent && event.eventCode == amnesiaTimerGameClosed);
     }
+
+    amnesiaTimerCounters(timer, &counters);
+    printf("game closed after %llu stdio opens\n",
+        (unsigned long long)(counters.fopenCalls + counters.freopenCalls + counters.fopen64Calls + counters.freopen64Calls));
+    amnesiaTimerDetach(timer); // detached here
+
+    return EXIT_SUCCESS;
 }
 
-int main()
+// pass --all to watch every running game instead of the first one, or --serve to also push their events to other programs.
+// pass --counters to print what the tool has done in the first game, like how many files it delayed, while the game runs
+int main(int argc, char** argv)
 {
-    int fd = -1;
-    void* mmapAddress = MAP_FAILED;
-    bool mlockSucceeded = false;
-    bool getResourcesSucceeded = getResources(fd, mmapAddress, mlockSucceeded); // remember to release resources from this function
-    if (getResourcesSucceeded)
+    if (argc > 1 && (strcmp(argv[1], "--all") == 0 || strcmp(argv[1], "--serve") == 0))
     {
-        std::atomic_ref<unsigned char> timerByteAtomicRef(*((unsigned char*)mmapAddress));
-        unsigned char timerByteCurrentValue = 0;
-        unsigned char timerBytePreviousValue = 0;
-        
-        struct timespec sleepTime = {0, 1000000}; // one millisecond
-        
-        printf("load detection ready.\n");
-        
-        while (true)
+        return watchAllGames(strcmp(argv[1], "--serve") == 0);
+    }
+    if (argc > 1 && strcmp(argv[1], "--counters") == 0)
+    {
+        return printCountersLive();
+    }
+
+    AmnesiaTimer* timer = amnesiaTimerAttach(nullptr); // remember to detach
+    if (timer == nullptr)
+    {
+        printf("%s\n", amnesiaTimerLastError());
+        return EXIT_FAILURE;
+    }
+
+    printf("load detection ready.\n");
+
+    AmnesiaTimerEvent event{};
+    bool succeeded = true;
+    while (true)
+    {
+        // sleeps without using the CPU until the tool writes another event
+        int result = amnesiaTimerWait(timer, &event, -1);
+        if (result == amnesiaTimerFinished)
         {
-            nanosleep(&sleepTime, nullptr);
-            timerByteCurrentValue = timerByteAtomicRef.load();
-            
-            if (timerByteCurrentValue != timerBytePreviousValue)
-            {
-                timerBytePreviousValue = timerByteCurrentValue;
-                
-                if (timerByteCurrentValue == 0)
-                {
-                    printf("resume timer\n");
-                }
-                else if (timerByteCurrentValue == 1)
-                {
-                    printf("pause timer without splitting\n");
-                }
-                else if (timerByteCurrentValue == 2)
-                {
-                    printf("pause timer and split\n");
-                }
-                else if (timerByteCurrentValue == 255)
-                {
-                    printf("finished\n");
-                    break;
-                }
-            }
+            break;
+        }
+        else if (result != amnesiaTimerGotEvent)
+        {
+            printf("error while waiting for the next event\n");
+            succeeded = false;
+            break;
+        }
+
+        if (event.missedEvents != 0)
+        {
+            printf("missed %u events\n", event.missedEvents);
+        }
+
+        printEvent(timer, event);
+        if (event.eventCode == amnesiaTimerGameClosed)
+        {
+            break;
         }
     }
-    
-    freeResources(fd, mmapAddress, mlockSucceeded); // resources from getResources released here
-    
-    return getResourcesSucceeded ? EXIT_SUCCESS : EXIT_FAILURE;
-}
 
+    amnesiaTimerDetach(timer); // detached here
+
+    return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,316 @@
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cstddef> // offsetof
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <map>
+#include <string>
+
+// amnesia_timer.h has to be included before this
+
+// Serves the watcher's events to any number of local programs over the two abstract unix sockets in amnesia_timer.h.
+// Everything runs on the watcher's epoll: the listening sockets and clients are added to it with serverEpollTag in the low 2 bits of
+// the epoll data and the file descriptor above them, and the watcher passes those to handleEpollEvent.
+// Updates are pushed to every client as soon as the watcher sees them. A client that stops reading gets its updates queued,
+// and it's disconnected if more than clientQueueLimit bytes are waiting, so it can't make the watcher late for the others.
+class TimerEventServer
+{
+public:
+    static const uint64_t serverEpollTag = 2;
+
+    ~TimerEventServer()
+    {
+        stop();
+    }
+
+    bool start(const int watcherEpollFd)
+    {
+        epollFd = watcherEpollFd;
+        binaryListenFd = listenOnAbstractSocket(AMNESIA_TIMER_SOCKET_NAME);
+        textListenFd = listenOnAbstractSocket(AMNESIA_TIMER_TEXT_SOCKET_NAME);
+
+        return binaryListenFd != -1 && textListenFd != -1;
+    }
+
+    void stop()
+    {
+        while (!clients.empty())
+        {
+            disconnect(clients.begin()->first);
+        }
+        for (int* listenFd : {&binaryListenFd, &textListenFd})
+        {
+            if (*listenFd != -1)
+            {
+                close(*listenFd); // closing it also removes it from the epoll
+                *listenFd = -1;
+            }
+        }
+        games.clear();
+    }
+
+    void handleEpollEvent(const struct epoll_event& readyEvent)
+    {
+        int fd = (int)(readyEvent.data.u64 >> 2);
+        if (fd == binaryListenFd || fd == textListenFd)
+        {
+            acceptClients(fd, fd == textListenFd);
+            return;
+        }
+
+        auto client = clients.find(fd);
+        if (client == clients.end())
+        {
+            return;
+        }
+        if ((readyEvent.events & EPOLLOUT) != 0 && !flushClient(client->first, client->second))
+        {
+            return;
+        }
+        if ((readyEvent.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0)
+        {
+            // clients don't send anything, so this is only to notice when they disconnect
+            char discarded[256];
+            ssize_t bytesRead = recv(fd, discarded, sizeof(discarded), MSG_DONTWAIT);
+            if (bytesRead == 0 || (bytesRead == -1 && errno != EAGAIN && errno != EINTR))
+            {
+                disconnect(fd);
+            }
+        }
+    }
+
+    void gameAttached(const int pid, const AmnesiaTimer* timer)
+    {
+        games[pid] = timer;
+        AmnesiaTimerFrame frame = makeFrame(amnesiaTimerFrameAttached, pid, timer, nullptr);
+        broadcast(frame);
+    }
+
+    void gameEvent(const int pid, const AmnesiaTimer* timer, const AmnesiaTimerEvent& event)
+    {
+        AmnesiaTimerFrame frame = makeFrame(amnesiaTimerFrameEvent, pid, timer, &event);
+        broadcast(frame);
+    }
+
+    // the timer is still attached when this is called, so the final totals can be sent
+    void gameClosed(const int pid, const AmnesiaTimer* timer)
+    {
+        games.erase(pid);
+        AmnesiaTimerFrame frame = makeFrame(amnesiaTimerFrameClosed, pid, timer, nullptr);
+        broadcast(frame);
+    }
+
+private:
+    struct Client
+    {
+        bool text = false;
+        std::string queued;
+    };
+
+    static const size_t clientQueueLimit = 65536;
+
+    int epollFd = -1;
+    int binaryListenFd = -1;
+    int textListenFd = -1;
+    std::map<int, Client> clients;
+    std::map<int, const AmnesiaTimer*> games; // so new clients get told about the games already being watched
+
+    int listenOnAbstractSocket(const char* name)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0); // make sure this gets closed
+        if (fd == -1)
+        {
+            printf("socket error: %d\n", errno);
+            return -1;
+        }
+
+        // abstract sockets start with a null byte instead of being a path, so there's no file to clean up
+        struct sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        size_t nameSize = strlen(name);
+        memcpy(&address.sun_path[1], name, nameSize);
+        socklen_t addressSize = offsetof(struct sockaddr_un, sun_path) + 1 + nameSize;
+
+        struct epoll_event listenEvent{};
+        listenEvent.events = EPOLLIN;
+        listenEvent.data.u64 = ((uint64_t)fd << 2) | serverEpollTag;
+        if (bind(fd, (struct sockaddr*)&address, addressSize) == -1 || listen(fd, 16) == -1 || epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &listenEvent) == -1)
+        {
+            printf("couldn't listen on @%s: %d\n", name, errno);
+            close(fd);
+            return -1;
+        }
+
+        return fd;
+    }
+
+    void acceptClients(const int listenFd, const bool text)
+    {
+        while (true)
+        {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC); // make sure this gets closed
+            if (fd == -1)
+            {
+                return;
+            }
+
+            struct epoll_event clientEvent{};
+            clientEvent.events = EPOLLIN | EPOLLRDHUP;
+            clientEvent.data.u64 = ((uint64_t)fd << 2) | serverEpollTag;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &clientEvent) == -1)
+            {
+                close(fd);
+                continue;
+            }
+            clients[fd].text = text;
+
+            for (const auto& game : games)
+            {
+                AmnesiaTimerFrame frame = makeFrame(amnesiaTimerFrameAttached, game.first, game.second, nullptr);
+                if (!sendToClient(fd, clients[fd], frame, formatTextLine(frame)))
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    void disconnect(const int fd)
+    {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd); // client closed here
+        clients.erase(fd);
+    }
+
+    static AmnesiaTimerFrame makeFrame(const uint8_t frameType, const int pid, const AmnesiaTimer* timer, const AmnesiaTimerEvent* event)
+    {
+        AmnesiaTimerTotals totals{};
+        amnesiaTimerTotals(timer, &totals);
+
+        AmnesiaTimerFrame frame{};
+        frame.frameSize = sizeof(AmnesiaTimerFrame);
+        frame.version = 1;
+        frame.frameType = frameType;
+        frame.pid = pid;
+        frame.eventCode = amnesiaTimerState(timer);
+        frame.monotonicNanoseconds = totals.monotonicNanoseconds;
+        frame.elapsedNanoseconds = totals.elapsedNanoseconds;
+        frame.loadRemovedNanoseconds = totals.loadRemovedNanoseconds;
+        if (event != nullptr)
+        {
+            frame.sequence = event->sequence;
+            frame.eventCode = event->eventCode;
+            frame.missedEvents = event->missedEvents;
+            frame.monotonicNanoseconds = event->monotonicNanoseconds;
+        }
+
+        return frame;
+    }
+
+    static std::string formatTextLine(const AmnesiaTimerFrame& frame)
+    {
+        const char* frameTypeNames[] = {"attached", "event", "closed"};
+        const char* eventCodeName = "finished";
+        if (frame.eventCode == amnesiaTimerResume)
+        {
+            eventCodeName = "resume";
+        }
+        else if (frame.eventCode == amnesiaTimerPause)
+        {
+            eventCodeName = "pause";
+        }
+        else if (frame.eventCode == amnesiaTimerPauseAndSplit)
+        {
+            eventCodeName = "split";
+        }
+
+        char line[256]{};
+        snprintf(line, sizeof(line), "%s %d %u %s %lld %lld %lld %u\n", frameTypeNames[frame.frameType], frame.pid, frame.sequence, eventCodeName,
+            (long long)frame.monotonicNanoseconds, (long long)frame.elapsedNanoseconds, (long long)frame.loadRemovedNanoseconds, frame.missedEvents);
+
+        return line;
+    }
+
+    // the text line is only made once for every client
+    void broadcast(const AmnesiaTimerFrame& frame)
+    {
+        std::string textLine = formatTextLine(frame);
+        for (auto client = clients.begin(); client != clients.end();)
+        {
+            int fd = client->first;
+            Client& clientState = client->second;
+            client++; // sendToClient can disconnect it
+            sendToClient(fd, clientState, frame, textLine);
+        }
+    }
+
+    // returns false if the client was disconnected
+    bool sendToClient(const int fd, Client& client, const AmnesiaTimerFrame& frame, const std::string& textLine)
+    {
+        const char* data = client.text ? textLine.data() : (const char*)&frame;
+        size_t dataSize = client.text ? textLine.size() : sizeof(frame);
+        if (!client.queued.empty())
+        {
+            if (client.queued.size() + dataSize > clientQueueLimit)
+            {
+                disconnect(fd);
+                return false;
+            }
+            client.queued.append(data, dataSize);
+            return true;
+        }
+
+        ssize_t bytesSent = send(fd, data, dataSize, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (bytesSent == -1 && errno != EAGAIN && errno != EINTR)
+        {
+            disconnect(fd);
+            return false;
+        }
+        if (bytesSent == -1)
+        {
+            bytesSent = 0;
+        }
+        if ((size_t)bytesSent < dataSize)
+        {
+            // the rest is sent when the socket has room, from handleEpollEvent
+            client.queued.append(data + bytesSent, dataSize - bytesSent);
+            struct epoll_event clientEvent{};
+            clientEvent.events = EPOLLIN | EPOLLRDHUP | EPOLLOUT;
+            clientEvent.data.u64 = ((uint64_t)fd << 2) | serverEpollTag;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &clientEvent);
+        }
+
+        return true;
+    }
+
+    // returns false if the client was disconnected
+    bool flushClient(const int fd, Client& client)
+    {
+        while (!client.queued.empty())
+        {
+            ssize_t bytesSent = send(fd, client.queued.data(), client.queued.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (bytesSent == -1)
+            {
+                if (errno == EAGAIN || errno == EINTR)
+                {
+                    return true;
+                }
+                disconnect(fd);
+                return false;
+            }
+            client.queued.erase(0, bytesSent);
+        }
+
+        struct epoll_event clientEvent{};
+        clientEvent.events = EPOLLIN | EPOLLRDHUP;
+        clientEvent.data.u64 = ((uint64_t)fd << 2) | serverEpollTag;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &clientEvent);
+
+        return true;
+    }
+};
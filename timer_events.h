@@ -0,0 +1,240 @@
+
+#include <cstdint>
+#include <cstddef> // offsetof
+#include <climits>
+#include <atomic>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+
+// tool_counters.h and frame_times.h have to be included before this
+
+// The start of the shared memory, which timer programs map to watch loads.
+// eventSequence is how many timer events were written. It's also the futex word which is woken after every event.
+// Every event is also written to a ring of TimerEventRecords at eventRingOffset, so timer programs which don't check often
+// still see every pause and resume in order, with the time it happened.
+// eventfdNumber is an eventfd in the game which is written to after every event, so a program watching several games can
+// copy it with pidfd_getfd and wait for all of them with one epoll. It's shared by every program that copies it, so it should be
+// added with EPOLLET and never read, otherwise one program would take the others' notifications.
+// The totals are how much time passed and how much of it was paused between the tool starting and the last event, so a timer
+// program can get the exact load removed time whenever it wants, even if it wasn't watching when the loads happened.
+// They're updated together under timeSequence, which is odd while they're being written.
+// Events are only written by the game's main thread, and by the __attribute__((destructor)) function after the game stops.
+// countersOffset is where the ToolCounters from tool_counters.h are, or 0 if the tool is older than them.
+struct TimerSharedHeader
+{
+    unsigned char timerByte;
+    unsigned char padding[3];
+    uint32_t eventSequence;
+    uint32_t eventRingOffset;
+    uint32_t eventRingCapacity; // power of 2
+    int32_t toolPid; // so timer programs which got the shared memory from the rendezvous file can check it's the right one
+    int32_t memfdNumber;
+    int32_t eventfdNumber; // -1 if eventfd failed
+    uint32_t timeSequence;
+    alignas(8) int64_t elapsedNanoseconds; // alignas so the 32-bit version has the same layout and atomic_ref works
+    alignas(8) int64_t pausedNanoseconds;
+    alignas(8) int64_t lastEventNanoseconds; // CLOCK_MONOTONIC
+    uint32_t paused; // whether the timer byte was anything but 0 after the last event
+    uint32_t countersOffset; // the load detection instructions start after this
+};
+
+// sequence is 0 while the record is being written, so a reader can tell if it copied half of an old event and half of a new one
+struct alignas(16) TimerEventRecord
+{
+    uint32_t sequence;
+    uint32_t eventCode; // the new timer byte value
+    int64_t monotonicNanoseconds; // CLOCK_MONOTONIC
+};
+
+// the totals from the header, continued up to when they were read
+struct TimerTotals
+{
+    int64_t elapsedNanoseconds;
+    int64_t pausedNanoseconds;
+    int64_t readNanoseconds; // CLOCK_MONOTONIC
+    bool paused;
+};
+
+static_assert(sizeof(TimerSharedHeader) == 64 && sizeof(TimerEventRecord) == 16, "timer programs depend on these sizes");
+static_assert(offsetof(TimerSharedHeader, elapsedNanoseconds) == 32 && offsetof(TimerSharedHeader, paused) == 56
+    && offsetof(TimerSharedHeader, countersOffset) == 60, "timer programs depend on this layout");
+
+static const uint32_t timerEventRingCapacity = 256;
+static const size_t timerEventRingSize = timerEventRingCapacity * sizeof(TimerEventRecord);
+
+enum class TimerEventReadResult
+{
+    Ready,
+    NotWrittenYet,
+    Overwritten // the writer went all the way around the ring since this event
+};
+
+static int64_t getMonotonicNanoseconds()
+{
+    struct timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+static TimerSharedHeader* timerEventHeader = nullptr;
+static int timerEventNotifyFd = -1;
+
+// called at the end of every event if it's set, so the tool can do more with events without slowing down timer programs
+static void (*timerEventObserver)(uint32_t eventCode, int64_t monotonicNanoseconds) = nullptr;
+
+// used by the tool. the header has to have been copied into the shared memory already. frameTimesOffset is 0 if there's no room for frame times
+[[maybe_unused]] static void initTimerEvents(unsigned char* sharedMemory, const uint32_t ringOffset, const uint32_t countersOffset,
+    const uint32_t frameTimesOffset, const int memfd)
+{
+    timerEventHeader = (TimerSharedHeader*)sharedMemory;
+    timerEventHeader->eventRingOffset = ringOffset;
+    timerEventHeader->countersOffset = countersOffset;
+    toolCounters = (ToolCounters*)(sharedMemory + countersOffset); // the counters' pages are new too, so they start out as 0
+    if (frameTimesOffset != 0)
+    {
+        frameTimes = (FrameTimes*)(sharedMemory + frameTimesOffset); // so are the frame times'
+        frameTimes->ringCapacity = frameTimeRingCapacity;
+        frameTimes->bucketNanoseconds = frameTimeBucketNanoseconds;
+        frameTimes->bucketCount = frameTimeBucketCount;
+        frameTimes->afterLoadNanoseconds = frameTimeAfterLoadNanoseconds;
+        toolCounters->frameTimesOffset = frameTimesOffset;
+    }
+    timerEventHeader->eventRingCapacity = timerEventRingCapacity; // the ring's pages are new, so the records already start out as 0
+    timerEventHeader->toolPid = getpid();
+    timerEventHeader->memfdNumber = memfd;
+    timerEventNotifyFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK); // make sure this gets closed. nonblocking so the game can't wait on it.
+    timerEventHeader->eventfdNumber = timerEventNotifyFd;
+    timerEventHeader->lastEventNanoseconds = getMonotonicNanoseconds(); // the totals start when the tool does
+    timerEventHeader->paused = timerEventHeader->timerByte != 0;
+}
+
+// used by the tool after the last event
+[[maybe_unused]] static void stopTimerEvents()
+{
+    timerEventHeader = nullptr;
+    toolCounters = nullptr; // threads opening files or swapping buffers could still be running, so the tool doesn't unmap the shared memory at exit
+    frameTimes = nullptr;
+    if (timerEventNotifyFd != -1)
+    {
+        close(timerEventNotifyFd); // eventfd closed here
+        timerEventNotifyFd = -1;
+    }
+}
+
+static TimerEventRecord* getTimerEventRing(TimerSharedHeader* header)
+{
+    return (TimerEventRecord*)((unsigned char*)header + header->eventRingOffset);
+}
+
+// called by the load detection instructions after they change the timer byte, which save every register before calling this
+[[maybe_unused]] static void recordTimerEvent(const uint32_t eventCode)
+{
+    if (timerEventHeader == nullptr)
+    {
+        return;
+    }
+
+    int64_t now = getMonotonicNanoseconds();
+    addToCounter(toolCounters->eventCounts[eventCode < 3 ? eventCode : 3], 1);
+
+    // there's only one writer, so the totals can be read without atomics here
+    std::atomic_ref<uint32_t> timeSequence(timerEventHeader->timeSequence);
+    uint32_t timeSequenceBefore = timeSequence.load(std::memory_order_relaxed);
+    timeSequence.store(timeSequenceBefore + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    int64_t sinceLastEvent = now - timerEventHeader->lastEventNanoseconds;
+    std::atomic_ref<int64_t>(timerEventHeader->elapsedNanoseconds).store(timerEventHeader->elapsedNanoseconds + sinceLastEvent, std::memory_order_relaxed);
+    if (timerEventHeader->paused != 0)
+    {
+        std::atomic_ref<int64_t>(timerEventHeader->pausedNanoseconds).store(timerEventHeader->pausedNanoseconds + sinceLastEvent, std::memory_order_relaxed);
+    }
+    std::atomic_ref<int64_t>(timerEventHeader->lastEventNanoseconds).store(now, std::memory_order_relaxed);
+    std::atomic_ref<uint32_t>(timerEventHeader->paused).store(eventCode != 0, std::memory_order_relaxed);
+    timeSequence.store(timeSequenceBefore + 2, std::memory_order_release);
+
+    std::atomic_ref<uint32_t> eventSequence(timerEventHeader->eventSequence);
+    uint32_t sequence = eventSequence.load(std::memory_order_relaxed) + 1;
+    TimerEventRecord& record = getTimerEventRing(timerEventHeader)[(sequence - 1) & (timerEventRingCapacity - 1)];
+
+    std::atomic_ref<uint32_t> recordSequence(record.sequence);
+    recordSequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::atomic_ref<uint32_t>(record.eventCode).store(eventCode, std::memory_order_relaxed);
+    std::atomic_ref<int64_t>(record.monotonicNanoseconds).store(now, std::memory_order_relaxed);
+    recordSequence.store(sequence, std::memory_order_release);
+
+    eventSequence.store(sequence, std::memory_order_release);
+    syscall(SYS_futex, &timerEventHeader->eventSequence, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0); // not private because the waiters are other processes
+    if (timerEventNotifyFd != -1)
+    {
+        uint64_t one = 1;
+        ssize_t ignored = write(timerEventNotifyFd, &one, sizeof(one)); // only fails if nobody's read it for 2^64 - 2 events
+        (void)ignored;
+    }
+    
+    if (timerEventObserver != nullptr)
+    {
+        timerEventObserver(eventCode, now);
+    }
+}
+
+// used by timer programs instead of the tool. sequence starts at 1 for the first event.
+[[maybe_unused]] static TimerEventReadResult readTimerEvent(TimerSharedHeader* header, const uint32_t sequence, TimerEventRecord& event)
+{
+    TimerEventRecord& record = getTimerEventRing(header)[(sequence - 1) & (header->eventRingCapacity - 1)];
+    std::atomic_ref<uint32_t> recordSequence(record.sequence);
+
+    uint32_t sequenceBefore = recordSequence.load(std::memory_order_acquire);
+    event.eventCode = std::atomic_ref<uint32_t>(record.eventCode).load(std::memory_order_relaxed);
+    event.monotonicNanoseconds = std::atomic_ref<int64_t>(record.monotonicNanoseconds).load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t sequenceAfter = recordSequence.load(std::memory_order_relaxed);
+    event.sequence = sequenceAfter;
+
+    if (sequenceBefore == sequence && sequenceAfter == sequence)
+    {
+        return TimerEventReadResult::Ready;
+    }
+
+    // every event up to the published sequence was finished before it was published,
+    // so if this one is included, the record was reused for a newer event (or is being reused right now, if it's 0)
+    uint32_t publishedSequence = std::atomic_ref<uint32_t>(header->eventSequence).load(std::memory_order_acquire);
+    return (int32_t)(publishedSequence - sequence) < 0 ? TimerEventReadResult::NotWrittenYet : TimerEventReadResult::Overwritten;
+}
+
+// used by timer programs. the time since the last event is added on, so the totals are up to date when this returns
+[[maybe_unused]] static void readTimerTotals(TimerSharedHeader* header, TimerTotals& totals)
+{
+    std::atomic_ref<uint32_t> timeSequence(header->timeSequence);
+    int64_t lastEventNanoseconds = 0;
+    while (true)
+    {
+        uint32_t sequenceBefore = timeSequence.load(std::memory_order_acquire);
+        if ((sequenceBefore & 1) != 0)
+        {
+            sched_yield(); // the game's main thread is in the middle of an update, which only takes a few instructions
+            continue;
+        }
+        totals.elapsedNanoseconds = std::atomic_ref<int64_t>(header->elapsedNanoseconds).load(std::memory_order_relaxed);
+        totals.pausedNanoseconds = std::atomic_ref<int64_t>(header->pausedNanoseconds).load(std::memory_order_relaxed);
+        lastEventNanoseconds = std::atomic_ref<int64_t>(header->lastEventNanoseconds).load(std::memory_order_relaxed);
+        totals.paused = std::atomic_ref<uint32_t>(header->paused).load(std::memory_order_relaxed) != 0;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (timeSequence.load(std::memory_order_relaxed) == sequenceBefore)
+        {
+            break;
+        }
+    }
+
+    totals.readNanoseconds = getMonotonicNanoseconds();
+    int64_t sinceLastEvent = totals.readNanoseconds - lastEventNanoseconds;
+    totals.elapsedNanoseconds += sinceLastEvent;
+    if (totals.paused)
+    {
+        totals.pausedNanoseconds += sinceLastEvent;
+    }
+}
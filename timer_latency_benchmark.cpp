@@ -0,0 +1,381 @@
+
+// Measures how long timer programs take to notice a timer event, for each way they can wait for one.
+// A producer process writes the timer byte and records timer events in a memfd on a fixed schedule, the same way the
+// load detection instructions do, and a consumer process watches it with one of the wakeup mechanisms:
+//     1 ms polling: what timer_byte_test did before the futex, checking the byte after every nanosleep
+//     busy polling: checking the byte in a loop without sleeping, the lowest latency possible but a whole CPU core
+//     futex: FUTEX_WAIT on the event sequence, what amnesiaTimerWait does
+//     epoll eventfd: epoll_wait on the game's eventfd, what timer_byte_test --all does
+// Latency is from just before the producer changes the timer byte to just after the consumer wakes up and sees it.
+// usage: timer_latency_benchmark.exe [events, default 2000] [microseconds between events, default 2000]
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <cstring>
+#include <errno.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+#include "tool_counters.h"
+#include "frame_times.h"
+#include "timer_events.h"
+
+// after the event ring. the producer stores when each event happened before changing the byte, then how many stamps there are
+struct BenchmarkMemory
+{
+    unsigned char* sharedMemory = nullptr;
+    size_t sharedMemorySize = 0;
+    TimerSharedHeader* header = nullptr;
+    uint32_t* stampCount = nullptr;
+    int64_t* stamps = nullptr;
+};
+
+struct ConsumerResult
+{
+    std::vector<int64_t> latencies;
+    uint32_t missedEvents = 0; // only the polling consumers can miss events, when the byte changes twice between checks
+};
+
+enum class WakeupMechanism
+{
+    SleepPolling,
+    BusyPolling,
+    Futex,
+    EpollEventfd
+};
+
+static const char* wakeupMechanismNames[] = {"1 ms polling", "busy polling", "futex", "epoll eventfd"};
+
+static uint32_t loadStampCount(const BenchmarkMemory& memory)
+{
+    return std::atomic_ref<uint32_t>(*memory.stampCount).load(std::memory_order_acquire);
+}
+
+static void addLatencies(const BenchmarkMemory& memory, ConsumerResult& result, uint32_t& seenStamps, const uint32_t newStampCount)
+{
+    int64_t now = getMonotonicNanoseconds();
+    for (; seenStamps < newStampCount; seenStamps++)
+    {
+        result.latencies.push_back(now - std::atomic_ref<int64_t>(memory.stamps[seenStamps]).load(std::memory_order_relaxed));
+    }
+}
+
+static bool isFinished(const BenchmarkMemory& memory)
+{
+    return std::atomic_ref<unsigned char>(memory.header->timerByte).load(std::memory_order_acquire) == 255;
+}
+
+// like the old timer_byte_test, it only knows the byte changed, so every stamp since the last change is counted as missed except the newest
+static void consumeByPolling(const BenchmarkMemory& memory, ConsumerResult& result, const bool sleepBetweenChecks)
+{
+    std::atomic_ref<unsigned char> timerByte(memory.header->timerByte);
+    unsigned char previousValue = timerByte.load();
+    uint32_t seenStamps = 0;
+    struct timespec sleepTime = {0, 1000000}; // one millisecond
+
+    while (true)
+    {
+        if (sleepBetweenChecks)
+        {
+            nanosleep(&sleepTime, nullptr);
+        }
+
+        unsigned char currentValue = timerByte.load(std::memory_order_acquire);
+        if (currentValue == previousValue)
+        {
+            continue;
+        }
+        previousValue = currentValue;
+        if (currentValue == 255)
+        {
+            result.missedEvents += loadStampCount(memory) - seenStamps; // changes right before the 255
+            break;
+        }
+
+        // the stamp is stored before the byte, so the newest stamp is for this change
+        uint32_t newStampCount = loadStampCount(memory);
+        result.missedEvents += newStampCount - seenStamps - 1;
+        seenStamps = newStampCount - 1;
+        addLatencies(memory, result, seenStamps, newStampCount);
+    }
+}
+
+static void consumeByFutex(const BenchmarkMemory& memory, ConsumerResult& result)
+{
+    std::atomic_ref<uint32_t> eventSequence(memory.header->eventSequence);
+    uint32_t seenStamps = 0;
+
+    while (true)
+    {
+        // checked first, so the events from before the 255 are counted before stopping
+        bool finished = isFinished(memory);
+        uint32_t sequence = eventSequence.load(std::memory_order_acquire);
+        uint32_t newStampCount = std::min(sequence, loadStampCount(memory)); // the last event is the 255 without a stamp
+        if (newStampCount != seenStamps)
+        {
+            addLatencies(memory, result, seenStamps, newStampCount);
+            continue;
+        }
+        if (finished)
+        {
+            break;
+        }
+        syscall(SYS_futex, &memory.header->eventSequence, FUTEX_WAIT, sequence, nullptr, nullptr, 0);
+    }
+}
+
+static void consumeByEpoll(const BenchmarkMemory& memory, ConsumerResult& result)
+{
+    int epollFd = epoll_create1(EPOLL_CLOEXEC); // make sure this gets closed
+    if (epollFd == -1)
+    {
+        return;
+    }
+    struct epoll_event notifyEvent{};
+    notifyEvent.events = EPOLLIN | EPOLLET; // never read, the same as when the eventfd is shared with other programs
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, timerEventNotifyFd, &notifyEvent);
+
+    std::atomic_ref<uint32_t> eventSequence(memory.header->eventSequence);
+    uint32_t seenStamps = 0;
+    while (true)
+    {
+        bool finished = isFinished(memory);
+        uint32_t newStampCount = std::min(eventSequence.load(std::memory_order_acquire), loadStampCount(memory));
+        if (newStampCount != seenStamps)
+        {
+            addLatencies(memory, result, seenStamps, newStampCount);
+            continue;
+        }
+        if (finished)
+        {
+            break;
+        }
+        struct epoll_event readyEvent{};
+        epoll_wait(epollFd, &readyEvent, 1, -1);
+    }
+
+    close(epollFd); // epoll closed here
+}
+
+static int64_t getPercentile(const std::vector<int64_t>& sortedLatencies, const size_t percent)
+{
+    if (sortedLatencies.empty())
+    {
+        return 0;
+    }
+    return sortedLatencies[std::min(sortedLatencies.size() - 1, sortedLatencies.size() * percent / 100)];
+}
+
+static void printResult(const WakeupMechanism mechanism, ConsumerResult& result, const struct rusage& usage, const int64_t wallNanoseconds)
+{
+    std::sort(result.latencies.begin(), result.latencies.end());
+    int64_t cpuMicroseconds = ((int64_t)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+
+    printf("%s: p50 %.1f us, p99 %.1f us, max %.1f us, %zu events, %u missed, consumer cpu %.1f ms (%.1f%%)\n",
+        wakeupMechanismNames[(int)mechanism],
+        getPercentile(result.latencies, 50) / 1000.0,
+        getPercentile(result.latencies, 99) / 1000.0,
+        result.latencies.empty() ? 0.0 : result.latencies.back() / 1000.0,
+        result.latencies.size(),
+        result.missedEvents,
+        cpuMicroseconds / 1000.0,
+        wallNanoseconds > 0 ? cpuMicroseconds * 100000.0 / wallNanoseconds : 0.0);
+
+    // power of 2 microsecond buckets, only the ones with events in them
+    size_t buckets[32]{};
+    for (int64_t latency : result.latencies)
+    {
+        size_t bucket = 0;
+        for (int64_t microseconds = latency / 1000; microseconds > 0 && bucket < 31; microseconds >>= 1)
+        {
+            bucket++;
+        }
+        buckets[bucket]++;
+    }
+    printf("    histogram:");
+    for (size_t i = 0; i < 32; i++)
+    {
+        if (buckets[i] != 0)
+        {
+            printf(" <%llu us: %zu", 1ULL << i, buckets[i]);
+        }
+    }
+    printf("\n");
+}
+
+static bool createBenchmarkMemory(BenchmarkMemory& memory, const uint32_t eventCount)
+{
+    uint32_t ringOffset = sizeof(TimerSharedHeader);
+    uint32_t countersOffset = ringOffset + timerEventRingSize; // like the tool, so recordTimerEvent counts the events
+    size_t stampsOffset = countersOffset + sizeof(ToolCounters);
+    memory.sharedMemorySize = stampsOffset + sizeof(int64_t) + ((size_t)eventCount * sizeof(int64_t));
+
+    int fd = memfd_create("timer_latency_benchmark", MFD_CLOEXEC); // make sure this gets closed
+    if (fd == -1)
+    {
+        printf("memfd_create error: %d\n", errno);
+        return false;
+    }
+    if (ftruncate(fd, memory.sharedMemorySize) == -1)
+    {
+        printf("ftruncate error: %d\n", errno);
+        close(fd);
+        return false;
+    }
+    void* mmapAddress = mmap(nullptr, memory.sharedMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mmapAddress == MAP_FAILED)
+    {
+        printf("mmap error: %d\n", errno);
+        close(fd);
+        return false;
+    }
+
+    memory.sharedMemory = (unsigned char*)mmapAddress;
+    memory.header = (TimerSharedHeader*)memory.sharedMemory;
+    memory.stampCount = (uint32_t*)(memory.sharedMemory + stampsOffset);
+    memory.stamps = (int64_t*)(memory.sharedMemory + stampsOffset + sizeof(int64_t));
+    initTimerEvents(memory.sharedMemory, ringOffset, countersOffset, 0, fd);
+    close(fd); // memfd closed here, the mapping keeps it
+
+    return true;
+}
+
+static void freeBenchmarkMemory(BenchmarkMemory& memory)
+{
+    stopTimerEvents();
+    munmap(memory.sharedMemory, memory.sharedMemorySize);
+    memory = BenchmarkMemory{};
+}
+
+static bool runBenchmark(const WakeupMechanism mechanism, const uint32_t eventCount, const int64_t intervalNanoseconds)
+{
+    BenchmarkMemory memory{};
+    if (!createBenchmarkMemory(memory, eventCount)) // remember to free
+    {
+        return false;
+    }
+
+    int readyPipe[2] = {-1, -1};
+    if (pipe2(readyPipe, O_CLOEXEC) == -1)
+    {
+        printf("pipe2 error: %d\n", errno);
+        freeBenchmarkMemory(memory);
+        return false;
+    }
+
+    pid_t consumerPid = fork();
+    if (consumerPid == -1)
+    {
+        printf("fork error: %d\n", errno);
+        close(readyPipe[0]);
+        close(readyPipe[1]);
+        freeBenchmarkMemory(memory);
+        return false;
+    }
+    else if (consumerPid == 0)
+    {
+        ConsumerResult result{};
+        result.latencies.reserve(eventCount);
+        close(readyPipe[0]);
+        struct rusage usageBefore{};
+        getrusage(RUSAGE_SELF, &usageBefore);
+        int64_t start = getMonotonicNanoseconds();
+        char ready = 1;
+        ssize_t ignored = write(readyPipe[1], &ready, 1);
+        (void)ignored;
+        close(readyPipe[1]);
+
+        if (mechanism == WakeupMechanism::SleepPolling || mechanism == WakeupMechanism::BusyPolling)
+        {
+            consumeByPolling(memory, result, mechanism == WakeupMechanism::SleepPolling);
+        }
+        else if (mechanism == WakeupMechanism::Futex)
+        {
+            consumeByFutex(memory, result);
+        }
+        else
+        {
+            consumeByEpoll(memory, result);
+        }
+
+        struct rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        usage.ru_utime.tv_sec -= usageBefore.ru_utime.tv_sec;
+        usage.ru_utime.tv_usec -= usageBefore.ru_utime.tv_usec;
+        usage.ru_stime.tv_sec -= usageBefore.ru_stime.tv_sec;
+        usage.ru_stime.tv_usec -= usageBefore.ru_stime.tv_usec;
+        printResult(mechanism, result, usage, getMonotonicNanoseconds() - start);
+        fflush(stdout);
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(readyPipe[1]);
+    char ready = 0;
+    bool consumerReady = read(readyPipe[0], &ready, 1) == 1;
+    close(readyPipe[0]);
+
+    if (consumerReady)
+    {
+        // the byte goes 1, 0, 2, 0, ... so every event changes it, like a pause, resume, split and resume
+        std::atomic_ref<unsigned char> timerByte(memory.header->timerByte);
+        int64_t next = getMonotonicNanoseconds() + intervalNanoseconds;
+        for (uint32_t i = 0; i < eventCount; i++, next += intervalNanoseconds)
+        {
+            struct timespec nextTime = {(time_t)(next / 1000000000), (long)(next % 1000000000)};
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &nextTime, nullptr) == EINTR);
+
+            unsigned char eventCode = (i & 1) ? 0 : ((i & 2) ? 2 : 1);
+            std::atomic_ref<int64_t>(memory.stamps[i]).store(getMonotonicNanoseconds(), std::memory_order_relaxed);
+            std::atomic_ref<uint32_t>(*memory.stampCount).store(i + 1, std::memory_order_release);
+            timerByte.exchange(eventCode); // xchg, like the load detection instructions
+            recordTimerEvent(eventCode);
+        }
+    }
+    std::atomic_ref<unsigned char>(memory.header->timerByte).store(255);
+    recordTimerEvent(255);
+
+    int status = 0;
+    waitpid(consumerPid, &status, 0);
+    freeBenchmarkMemory(memory);
+
+    return consumerReady && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t eventCount = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000;
+    int64_t intervalMicroseconds = argc > 2 ? strtoll(argv[2], nullptr, 10) : 2000;
+    if (eventCount == 0 || intervalMicroseconds <= 0)
+    {
+        printf("usage: %s [events] [microseconds between events]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%u events, %lld us apart\n", eventCount, (long long)intervalMicroseconds);
+    fflush(stdout); // so the consumers don't print it again
+    for (WakeupMechanism mechanism : {WakeupMechanism::SleepPolling, WakeupMechanism::BusyPolling, WakeupMechanism::Futex, WakeupMechanism::EpollEventfd})
+    {
+        // with one CPU, the busy consumer and the producer would just take turns on it
+        if (mechanism == WakeupMechanism::BusyPolling && sysconf(_SC_NPROCESSORS_ONLN) < 2)
+        {
+            printf("%s: skipped, it needs a second CPU\n", wakeupMechanismNames[(int)mechanism]);
+            fflush(stdout);
+            continue;
+        }
+
+        if (!runBenchmark(mechanism, eventCount, intervalMicroseconds * 1000))
+        {
+            printf("%s: benchmark failed\n", wakeupMechanismNames[(int)mechanism]);
+            return EXIT_FAILURE;
+        }
+        fflush(stdout);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,223 @@
+
+#include <cstdint>
+#include <cstdlib> // getenv
+#include <cstdio> // rename
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434 // the same number for 32-bit and 64-bit
+#endif
+#ifndef SYS_pidfd_getfd
+#define SYS_pidfd_getfd 438
+#endif
+
+// timer_events.h has to be included before this
+
+// When the tool starts, it saves its pid and which file descriptor its shared memory is in to
+//     $XDG_RUNTIME_DIR/amnesia_tool_<shared memory name>.rendezvous
+// so timer programs can copy that file descriptor right away with pidfd_getfd instead of searching every process and file descriptor.
+// The device and inode numbers, and the pid and number in the shared memory's header, are checked after it's copied,
+// so a different process reusing the pid isn't mistaken for the game.
+// If XDG_RUNTIME_DIR isn't set, the file isn't written and timer programs search /proc like before.
+struct TimerRendezvousRecord
+{
+    char magic[4];
+    uint32_t version;
+    int32_t pid;
+    int32_t memfdNumber;
+    uint64_t memfdDevice;
+    uint64_t memfdInode;
+};
+
+static_assert(sizeof(TimerRendezvousRecord) == 32, "the 32-bit and 64-bit versions of the tool and timer programs need the same layout");
+
+static const char timerRendezvousMagic[4] = {'A', 'M', 'T', 'R'};
+static const uint32_t timerRendezvousVersion = 1;
+static const char timerRendezvousPrefix[] = "/amnesia_tool_";
+static const char timerRendezvousSuffix[] = ".rendezvous";
+static const char timerRendezvousTempSuffix[] = ".rendezvous.tmp";
+
+static char timerRendezvousPublishedPath[4096 + 320]{}; // empty unless this process published the file
+
+static bool getTimerRendezvousPath(char* path, const size_t pathBufferSize, const char* memfdName, const char* suffix)
+{
+    const char* runtimeDirectory = getenv("XDG_RUNTIME_DIR");
+    if (runtimeDirectory == nullptr || runtimeDirectory[0] != '/')
+    {
+        return false;
+    }
+
+    size_t directorySize = strlen(runtimeDirectory);
+    size_t memfdNameSize = strlen(memfdName);
+    size_t suffixSize = strlen(suffix);
+    if (directorySize + (sizeof(timerRendezvousPrefix) - 1) + memfdNameSize + suffixSize + 1 > pathBufferSize)
+    {
+        return false;
+    }
+
+    char* end = path;
+    memcpy(end, runtimeDirectory, directorySize);
+    end += directorySize;
+    memcpy(end, timerRendezvousPrefix, sizeof(timerRendezvousPrefix) - 1);
+    end += sizeof(timerRendezvousPrefix) - 1;
+    memcpy(end, memfdName, memfdNameSize);
+    end += memfdNameSize;
+    memcpy(end, suffix, suffixSize + 1); // + 1 for null terminator
+
+    return true;
+}
+
+// stat64 so the 32-bit versions don't fail with EOVERFLOW on large inode numbers
+static bool getTimerRendezvousIdentity(const int fd, uint64_t& device, uint64_t& inode)
+{
+    struct stat64 fileStatus{};
+    if (fstat64(fd, &fileStatus) == -1)
+    {
+        return false;
+    }
+    device = fileStatus.st_dev;
+    inode = fileStatus.st_ino;
+
+    return true;
+}
+
+enum class TimerRendezvousResult
+{
+    Published,
+    NoRuntimeDirectory, // XDG_RUNTIME_DIR isn't set, which is normal on some systems
+    Failed
+};
+
+// used by the tool. written to a temporary file and renamed, so timer programs never read half of it
+[[maybe_unused]] static TimerRendezvousResult publishTimerRendezvous(const char* memfdName, const int memfd)
+{
+    const char* runtimeDirectory = getenv("XDG_RUNTIME_DIR");
+    if (runtimeDirectory == nullptr || runtimeDirectory[0] == '\0')
+    {
+        return TimerRendezvousResult::NoRuntimeDirectory;
+    }
+
+    char tempPath[sizeof(timerRendezvousPublishedPath)]{};
+    char path[sizeof(timerRendezvousPublishedPath)]{};
+    if (!getTimerRendezvousPath(tempPath, sizeof(tempPath), memfdName, timerRendezvousTempSuffix)
+        || !getTimerRendezvousPath(path, sizeof(path), memfdName, timerRendezvousSuffix))
+    {
+        return TimerRendezvousResult::Failed;
+    }
+
+    TimerRendezvousRecord record{};
+    memcpy(record.magic, timerRendezvousMagic, sizeof(record.magic));
+    record.version = timerRendezvousVersion;
+    record.pid = getpid();
+    record.memfdNumber = memfd;
+    if (!getTimerRendezvousIdentity(memfd, record.memfdDevice, record.memfdInode))
+    {
+        return TimerRendezvousResult::Failed;
+    }
+
+    int fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600); // make sure this gets closed
+    if (fd == -1)
+    {
+        return TimerRendezvousResult::Failed;
+    }
+    bool written = write(fd, &record, sizeof(record)) == sizeof(record);
+    close(fd); // file closed here
+
+    if (!written || rename(tempPath, path) == -1)
+    {
+        unlink(tempPath);
+        return TimerRendezvousResult::Failed;
+    }
+    memcpy(timerRendezvousPublishedPath, path, sizeof(path));
+
+    return TimerRendezvousResult::Published;
+}
+
+// used by timer programs
+[[maybe_unused]] static bool readTimerRendezvous(const char* memfdName, TimerRendezvousRecord& record)
+{
+    char path[sizeof(timerRendezvousPublishedPath)]{};
+    if (!getTimerRendezvousPath(path, sizeof(path), memfdName, timerRendezvousSuffix))
+    {
+        return false;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC); // make sure this gets closed
+    if (fd == -1)
+    {
+        return false;
+    }
+    bool readSucceeded = read(fd, &record, sizeof(record)) == sizeof(record);
+    close(fd); // file closed here
+
+    return readSucceeded
+        && memcmp(record.magic, timerRendezvousMagic, sizeof(record.magic)) == 0
+        && record.version == timerRendezvousVersion;
+}
+
+// used by the tool when it closes. the file is left alone if another game started with the same shared memory name and replaced it.
+[[maybe_unused]] static void removeTimerRendezvous()
+{
+    if (timerRendezvousPublishedPath[0] == '\0')
+    {
+        return;
+    }
+
+    TimerRendezvousRecord record{};
+    int fd = open(timerRendezvousPublishedPath, O_RDONLY | O_CLOEXEC); // make sure this gets closed
+    if (fd != -1)
+    {
+        if (read(fd, &record, sizeof(record)) == sizeof(record) && record.pid == getpid())
+        {
+            unlink(timerRendezvousPublishedPath);
+        }
+        close(fd); // file closed here
+    }
+    timerRendezvousPublishedPath[0] = '\0';
+}
+
+// used by timer programs. returns -1 if the game closed or the record is for a different file.
+// pidfd_getfd needs the same permission as ptrace, so if that isn't allowed, /proc/<pid>/fd/<number> is opened instead,
+// which needs the same permission as the /proc search.
+[[maybe_unused]] static int openTimerRendezvousMemfd(const TimerRendezvousRecord& record)
+{
+    int memfd = -1;
+    int pidfd = syscall(SYS_pidfd_open, record.pid, 0); // make sure this gets closed
+    if (pidfd != -1)
+    {
+        memfd = syscall(SYS_pidfd_getfd, pidfd, record.memfdNumber, 0);
+        close(pidfd); // pidfd closed here
+    }
+
+    if (memfd == -1)
+    {
+        char procPath[64]{};
+        snprintf(procPath, sizeof(procPath), "/proc/%d/fd/%d", record.pid, record.memfdNumber);
+        memfd = open(procPath, O_RDONLY | O_CLOEXEC);
+        if (memfd == -1)
+        {
+            return -1;
+        }
+    }
+
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    TimerSharedHeader header{};
+    if (
+        !getTimerRendezvousIdentity(memfd, device, inode)
+        || device != record.memfdDevice
+        || inode != record.memfdInode
+        || pread(memfd, &header, sizeof(header), 0) != sizeof(header)
+        || header.toolPid != record.pid
+        || header.memfdNumber != record.memfdNumber)
+    {
+        close(memfd);
+        return -1;
+    }
+
+    return memfd;
+}
@@ -0,0 +1,50 @@
+
+#include <cstdint>
+#include <atomic>
+
+// Counts what the tool has done since the game started, so it can be seen while the game is running. It's in the shared memory
+// after the timer event ring, at the header's countersOffset, and timer programs can read it with amnesiaTimerCounters.
+// The counters are relaxed atomics because none of them depend on each other. Each cache line is only written by one kind of thread,
+// so the threads opening files and the game's main thread don't slow each other down by writing to the same line.
+// The flashback counters are incremented by the injected flashback instructions. The 32-bit instructions only increment the low half,
+// which would take 49 days of flashback waiting to overflow.
+struct ToolCounters
+{
+    // written by every thread which opens files
+    alignas(64) uint64_t fopenCalls;
+    alignas(8) uint64_t freopenCalls;
+    alignas(8) uint64_t fopen64Calls;
+    alignas(8) uint64_t freopen64Calls;
+    alignas(8) uint64_t delayedFiles; // opens of files in the delay table, including ones with a 0 ms delay
+    alignas(8) uint64_t delayNanoseconds; // how long the hooks slept
+    alignas(8) uint64_t longestDelayNanoseconds;
+
+    // written by the game's main thread
+    alignas(64) uint64_t flashbackSkips; // how many times the flashback lines were stopped before a map changed
+    alignas(8) uint64_t flashbackWaits; // how many 1 ms waits there were for flashback lines to finish before a map finished loading
+    alignas(8) uint64_t eventCounts[4]; // resume, pause, pause and split, and the game closing
+
+    uint32_t frameTimesOffset; // where the FrameTimes from frame_times.h are, or 0 if the tool is older than them. written once at startup
+};
+
+static_assert(sizeof(ToolCounters) == 128, "timer programs depend on this size");
+
+static ToolCounters* toolCounters = nullptr;
+
+[[maybe_unused]] static void addToCounter(uint64_t& counter, const uint64_t amount)
+{
+    std::atomic_ref<uint64_t>(counter).fetch_add(amount, std::memory_order_relaxed);
+}
+
+[[maybe_unused]] static void raiseCounter(uint64_t& counter, const uint64_t value)
+{
+    std::atomic_ref<uint64_t> counterRef(counter);
+    uint64_t current = counterRef.load(std::memory_order_relaxed);
+    while (current < value && !counterRef.compare_exchange_weak(current, value, std::memory_order_relaxed));
+}
+
+// used by timer programs
+[[maybe_unused]] static uint64_t readCounter(const uint64_t& counter)
+{
+    return std::atomic_ref<uint64_t>(const_cast<uint64_t&>(counter)).load(std::memory_order_relaxed);
+}